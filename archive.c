@@ -0,0 +1,425 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include "archive.h"
+#include "procfs.h"
+
+/* a procfs file read outside of the batch while rendering, e.g. the stat files of the ancestors */
+struct archived_file {
+    char path[PROCFS_PATH_SIZE];
+    enum procfs_file_type type;
+    int error;
+    char *data;
+    size_t length;
+    size_t capacity;
+};
+
+/* archive writer, used by the render thread */
+static FILE *archive_file = NULL;
+static uint64_t *archive_index = NULL;
+static uint64_t archive_cycle_count = 0;
+static size_t archive_index_capacity = 0;
+
+static struct archived_file *recorded_files = NULL;
+static size_t recorded_count = 0;
+static size_t recorded_capacity = 0;
+static int recorded_incomplete = 0;
+
+/* archive reader of the replay mode */
+static FILE *replay_file = NULL;
+static uint64_t *replay_index = NULL;
+static uint64_t replay_cycle_count = 0;
+static uint64_t replay_next_cycle = 0;
+static char *replay_data = NULL;
+static size_t replay_data_capacity = 0;
+
+int open_archive(char *path) {
+    struct archive_header header;
+
+    archive_file = fopen(path, "w");
+    if (archive_file == NULL) {
+        fprintf(stderr, "ERROR: failed to open the archive file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+    header.version = ARCHIVE_VERSION;
+
+    if (fwrite(&header, sizeof(header), 1, archive_file) != 1 || fflush(archive_file) != 0) {
+        fprintf(stderr, "ERROR: failed to write the archive file %s: %s\n", path, strerror(errno));
+        fclose(archive_file);
+        archive_file = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int is_archive_open() {
+    return archive_file != NULL;
+}
+
+static void record_archive_file(struct procfs_file *file) {
+    struct archived_file *new_recorded_files;
+    struct archived_file *recorded;
+    char *new_data;
+    size_t i;
+
+    /* the tree walk may read a file more than once */
+    for (i = 0; i < recorded_count; ++i) {
+        if (strcmp(recorded_files[i].path, file->path) == 0) {
+            return;
+        }
+    }
+
+    if (recorded_count == recorded_capacity) {
+        new_recorded_files = (struct archived_file *)realloc(recorded_files, (recorded_capacity + 16) * sizeof(struct archived_file));
+        if (new_recorded_files == NULL) {
+            fprintf(stderr, "WARNING: failed to allocate memory to archive %s, the cycle is archived as incomplete\n", file->path);
+            recorded_incomplete = 1;
+            return;
+        }
+
+        memset(new_recorded_files + recorded_capacity, 0, 16 * sizeof(struct archived_file));
+        recorded_files = new_recorded_files;
+        recorded_capacity += 16;
+    }
+
+    recorded = &recorded_files[recorded_count];
+
+    if (file->length > recorded->capacity) {
+        new_data = (char *)realloc(recorded->data, file->length);
+        if (new_data == NULL) {
+            fprintf(stderr, "WARNING: failed to allocate memory to archive %s, the cycle is archived as incomplete\n", file->path);
+            recorded_incomplete = 1;
+            return;
+        }
+
+        recorded->data = new_data;
+        recorded->capacity = file->length;
+    }
+
+    strcpy(recorded->path, file->path);
+    recorded->type = file->type;
+    recorded->error = file->error;
+    recorded->length = file->error == 0 ? file->length : 0;
+    if (recorded->length > 0) {
+        memcpy(recorded->data, file->buffer, recorded->length);
+    }
+
+    ++recorded_count;
+}
+
+void archive_begin_cycle() {
+    recorded_count = 0;
+    recorded_incomplete = 0;
+
+    if (archive_file != NULL) {
+        procfs_set_recorder(record_archive_file);
+    }
+}
+
+static int write_archive_file(char *path, enum procfs_file_type type, int error, char *data, size_t length) {
+    struct archive_file_header file_header;
+
+    memset(&file_header, 0, sizeof(file_header));
+    file_header.type = type;
+    file_header.error = error;
+    file_header.path_length = strlen(path);
+    file_header.length = error == 0 ? length : 0;
+
+    if (fwrite(&file_header, sizeof(file_header), 1, archive_file) != 1) {
+        return -1;
+    }
+
+    if (fwrite(path, 1, file_header.path_length, archive_file) != file_header.path_length) {
+        return -1;
+    }
+
+    if (file_header.length > 0 && fwrite(data, 1, file_header.length, archive_file) != file_header.length) {
+        return -1;
+    }
+
+    return 0;
+}
+
+void archive_end_cycle(struct report *report) {
+    struct archive_cycle_header cycle_header;
+    struct procfs_file *file;
+    uint64_t *new_archive_index;
+    off_t record_offset;
+    size_t i;
+    int ret_write = 0;
+
+    procfs_set_recorder(NULL);
+
+    if (archive_file == NULL) {
+        return;
+    }
+
+    memset(&cycle_header, 0, sizeof(cycle_header));
+    cycle_header.magic = ARCHIVE_CYCLE_MAGIC;
+    cycle_header.record_size = sizeof(cycle_header);
+    cycle_header.report_time = report->report_time;
+    cycle_header.capture_window = report->capture_window;
+    cycle_header.sched_latency = report->sched_latency;
+    cycle_header.capture_time = report->capture_time;
+    cycle_header.pid = report->pid;
+    cycle_header.status = report->status;
+    if (recorded_incomplete) {
+        cycle_header.status |= ARCHIVE_CYCLE_INCOMPLETE;
+    }
+    cycle_header.total_memory = report->memory_data.total_memory;
+    cycle_header.statm_rss = report->statm_rss;
+    strcpy(cycle_header.exename, report->exename);
+
+    for (i = 0; i < report->batch->count; ++i) {
+        file = &report->batch->files[i];
+        cycle_header.record_size += sizeof(struct archive_file_header) + strlen(file->path) + (file->error == 0 ? file->length : 0);
+    }
+
+    for (i = 0; i < recorded_count; ++i) {
+        cycle_header.record_size += sizeof(struct archive_file_header) + strlen(recorded_files[i].path) + recorded_files[i].length;
+    }
+
+    cycle_header.file_count = report->batch->count + recorded_count;
+
+    if (archive_cycle_count == archive_index_capacity) {
+        new_archive_index = (uint64_t *)realloc(archive_index, (archive_index_capacity + 64) * sizeof(uint64_t));
+        if (new_archive_index == NULL) {
+            fprintf(stderr, "WARNING: failed to allocate memory for the archive index\n");
+            return;
+        }
+
+        archive_index = new_archive_index;
+        archive_index_capacity += 64;
+    }
+
+    record_offset = ftello(archive_file);
+
+    if (fwrite(&cycle_header, sizeof(cycle_header), 1, archive_file) != 1) {
+        ret_write = -1;
+    }
+
+    for (i = 0; ret_write == 0 && i < report->batch->count; ++i) {
+        file = &report->batch->files[i];
+        ret_write = write_archive_file(file->path, file->type, file->error, file->buffer, file->length);
+    }
+
+    for (i = 0; ret_write == 0 && i < recorded_count; ++i) {
+        ret_write = write_archive_file(recorded_files[i].path, recorded_files[i].type, recorded_files[i].error, recorded_files[i].data, recorded_files[i].length);
+    }
+
+    /* each cycle is flushed, so the archive is usable even if memdoor is killed */
+    if (ret_write < 0 || record_offset < 0 || fflush(archive_file) != 0) {
+        fprintf(stderr, "WARNING: failed to write the archive file, archiving is stopped: %s\n", strerror(errno));
+        fclose(archive_file);
+        archive_file = NULL;
+        return;
+    }
+
+    archive_index[archive_cycle_count++] = record_offset;
+}
+
+void close_archive() {
+    struct archive_trailer trailer;
+    off_t index_offset;
+    size_t i;
+
+    if (archive_file != NULL) {
+        index_offset = ftello(archive_file);
+
+        memset(&trailer, 0, sizeof(trailer));
+        memcpy(trailer.magic, ARCHIVE_TRAILER_MAGIC, sizeof(trailer.magic));
+        trailer.index_offset = index_offset;
+        trailer.cycle_count = archive_cycle_count;
+
+        if (index_offset < 0 || (archive_cycle_count > 0 && fwrite(archive_index, sizeof(uint64_t), archive_cycle_count, archive_file) != archive_cycle_count) || fwrite(&trailer, sizeof(trailer), 1, archive_file) != 1) {
+            fprintf(stderr, "WARNING: failed to write the archive index: %s\n", strerror(errno));
+        }
+
+        fclose(archive_file);
+        archive_file = NULL;
+    }
+
+    for (i = 0; i < recorded_capacity; ++i) {
+        free(recorded_files[i].data);
+    }
+
+    free(recorded_files);
+    recorded_files = NULL;
+    recorded_count = 0;
+    recorded_capacity = 0;
+
+    free(archive_index);
+    archive_index = NULL;
+    archive_cycle_count = 0;
+    archive_index_capacity = 0;
+}
+
+/* rebuild the index of an archive without trailer, a truncated last record is ignored */
+static int scan_replay_archive(off_t file_size) {
+    struct archive_cycle_header cycle_header;
+    uint64_t *new_replay_index;
+    size_t replay_index_capacity = 0;
+    off_t offset = sizeof(struct archive_header);
+
+    while (offset + (off_t)sizeof(cycle_header) <= file_size) {
+        if (fseeko(replay_file, offset, SEEK_SET) < 0 || fread(&cycle_header, sizeof(cycle_header), 1, replay_file) != 1) {
+            break;
+        }
+
+        if (cycle_header.magic != ARCHIVE_CYCLE_MAGIC || cycle_header.record_size < sizeof(cycle_header) || offset + (off_t)cycle_header.record_size > file_size) {
+            break;
+        }
+
+        if (replay_cycle_count == replay_index_capacity) {
+            new_replay_index = (uint64_t *)realloc(replay_index, (replay_index_capacity + 64) * sizeof(uint64_t));
+            if (new_replay_index == NULL) {
+                return -1;
+            }
+
+            replay_index = new_replay_index;
+            replay_index_capacity += 64;
+        }
+
+        replay_index[replay_cycle_count++] = offset;
+        offset += cycle_header.record_size;
+    }
+
+    return 0;
+}
+
+int open_replay_archive(char *path, uint64_t *cycle_count) {
+    struct archive_header header;
+    struct archive_trailer trailer;
+    off_t file_size;
+
+    replay_file = fopen(path, "r");
+    if (replay_file == NULL) {
+        fprintf(stderr, "ERROR: failed to open the archive file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    if (fread(&header, sizeof(header), 1, replay_file) != 1 || memcmp(header.magic, ARCHIVE_MAGIC, sizeof(header.magic)) != 0 || header.version != ARCHIVE_VERSION) {
+        fprintf(stderr, "ERROR: %s is not a memdoor archive file\n", path);
+        close_replay_archive();
+        return -1;
+    }
+
+    if (fseeko(replay_file, 0, SEEK_END) < 0 || (file_size = ftello(replay_file)) < 0) {
+        fprintf(stderr, "ERROR: failed to read the archive file %s: %s\n", path, strerror(errno));
+        close_replay_archive();
+        return -1;
+    }
+
+    /* load the index, or scan the records if memdoor did not exit cleanly */
+    if (file_size >= (off_t)(sizeof(header) + sizeof(trailer)) && fseeko(replay_file, file_size - sizeof(trailer), SEEK_SET) == 0 && fread(&trailer, sizeof(trailer), 1, replay_file) == 1 && memcmp(trailer.magic, ARCHIVE_TRAILER_MAGIC, sizeof(trailer.magic)) == 0 && trailer.index_offset + trailer.cycle_count * sizeof(uint64_t) + sizeof(trailer) == (uint64_t)file_size) {
+        replay_index = (uint64_t *)malloc((trailer.cycle_count > 0 ? trailer.cycle_count : 1) * sizeof(uint64_t));
+        if (replay_index == NULL || fseeko(replay_file, trailer.index_offset, SEEK_SET) < 0 || fread(replay_index, sizeof(uint64_t), trailer.cycle_count, replay_file) != trailer.cycle_count) {
+            fprintf(stderr, "ERROR: failed to read the archive index of %s\n", path);
+            close_replay_archive();
+            return -1;
+        }
+
+        replay_cycle_count = trailer.cycle_count;
+    } else {
+        fprintf(stderr, "WARNING: the archive file %s has no index, scanning its records\n", path);
+
+        if (scan_replay_archive(file_size) < 0) {
+            fprintf(stderr, "ERROR: failed to allocate memory for the archive index\n");
+            close_replay_archive();
+            return -1;
+        }
+    }
+
+    replay_next_cycle = 0;
+    *cycle_count = replay_cycle_count;
+
+    return 0;
+}
+
+int read_replay_cycle(struct report *report) {
+    struct archive_cycle_header cycle_header;
+    struct archive_file_header file_header;
+    char path[PROCFS_PATH_SIZE];
+    char *new_replay_data;
+    uint32_t i;
+
+    if (replay_next_cycle == replay_cycle_count) {
+        return 0;
+    }
+
+    if (fseeko(replay_file, replay_index[replay_next_cycle++], SEEK_SET) < 0 || fread(&cycle_header, sizeof(cycle_header), 1, replay_file) != 1 || cycle_header.magic != ARCHIVE_CYCLE_MAGIC) {
+        return -1;
+    }
+
+    report->report_time = cycle_header.report_time;
+    report->capture_window = cycle_header.capture_window;
+    report->sched_latency = cycle_header.sched_latency;
+    report->capture_time = cycle_header.capture_time;
+    report->pid = cycle_header.pid;
+    report->status = cycle_header.status & ~ARCHIVE_CYCLE_INCOMPLETE;
+    report->memory_data.total_memory = cycle_header.total_memory;
+    report->statm_rss = cycle_header.statm_rss;
+    cycle_header.exename[sizeof(cycle_header.exename) - 1] = '\0';
+    strcpy(report->exename, cycle_header.exename);
+
+    /* the missing files are read as unavailable, like files which could not be read at capture time */
+    if (cycle_header.status & ARCHIVE_CYCLE_INCOMPLETE) {
+        fprintf(stderr, "WARNING: cycle %lu of the archive is incomplete, some files could not be recorded\n", (unsigned long)replay_next_cycle);
+    }
+
+    procfs_batch_begin(report->batch);
+
+    for (i = 0; i < cycle_header.file_count; ++i) {
+        if (fread(&file_header, sizeof(file_header), 1, replay_file) != 1 || file_header.path_length >= sizeof(path)) {
+            return -1;
+        }
+
+        if (fread(path, 1, file_header.path_length, replay_file) != file_header.path_length) {
+            return -1;
+        }
+
+        path[file_header.path_length] = '\0';
+
+        if (file_header.length > replay_data_capacity) {
+            new_replay_data = (char *)realloc(replay_data, file_header.length);
+            if (new_replay_data == NULL) {
+                return -1;
+            }
+
+            replay_data = new_replay_data;
+            replay_data_capacity = file_header.length;
+        }
+
+        if (file_header.length > 0 && fread(replay_data, 1, file_header.length, replay_file) != file_header.length) {
+            return -1;
+        }
+
+        if (procfs_batch_load(report->batch, path, file_header.type, replay_data, file_header.length, file_header.error) < 0) {
+            fprintf(stderr, "WARNING: failed to load %s from the archive\n", path);
+        }
+    }
+
+    return 1;
+}
+
+void close_replay_archive() {
+    if (replay_file != NULL) {
+        fclose(replay_file);
+        replay_file = NULL;
+    }
+
+    free(replay_index);
+    replay_index = NULL;
+    replay_cycle_count = 0;
+    replay_next_cycle = 0;
+
+    free(replay_data);
+    replay_data = NULL;
+    replay_data_capacity = 0;
+}
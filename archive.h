@@ -0,0 +1,66 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <limits.h>
+#include <stdint.h>
+#include "report.h"
+
+/*
+ * archive file layout:
+ *   archive header
+ *   cycle record * N: cycle header, then file header + path + content per procfs file
+ *   index: file offset of each cycle record (uint64_t * N)
+ *   archive trailer
+ * the index and the trailer are written when memdoor exits, an archive without them is scanned record by record
+ */
+#define ARCHIVE_MAGIC "MDARCHV1"
+#define ARCHIVE_TRAILER_MAGIC "MDINDEX1"
+#define ARCHIVE_CYCLE_MAGIC 0x4d444359 /* "MDCY" */
+#define ARCHIVE_VERSION 2
+#define ARCHIVE_CYCLE_INCOMPLETE 0x10000 /* set in the status of a cycle if a file read while rendering could not be recorded */
+
+struct archive_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct archive_cycle_header {
+    uint32_t magic;
+    uint32_t file_count;
+    uint64_t record_size; /* bytes of the record including this header */
+    int64_t report_time;
+    int64_t capture_window; /* unit: microsecond */
+    int64_t sched_latency; /* unit: microsecond */
+    double capture_time; /* CLOCK_MONOTONIC seconds at the end of the capture */
+    int32_t pid;
+    int32_t status;
+    int64_t total_memory; /* unit: kB */
+    int64_t statm_rss; /* unit: kB */
+    char exename[PATH_MAX];
+};
+
+struct archive_file_header {
+    uint32_t type;
+    int32_t error; /* errno of the failed read, 0 on success */
+    uint32_t path_length;
+    uint32_t reserved;
+    uint64_t length;
+};
+
+struct archive_trailer {
+    char magic[8];
+    uint64_t index_offset;
+    uint64_t cycle_count;
+};
+
+extern int open_archive(char *path);
+extern int is_archive_open();
+extern void archive_begin_cycle();
+extern void archive_end_cycle(struct report *report);
+extern void close_archive();
+extern int open_replay_archive(char *path, uint64_t *cycle_count);
+extern int read_replay_cycle(struct report *report);
+extern void close_replay_archive();
+
+#endif /* ARCHIVE_H */
@@ -0,0 +1,421 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include "cgroup.h"
+#include "process.h"
+#include "procfs.h"
+#include "utils.h"
+
+/* memory.events of the watched cgroup, the kernel notifies a modification whenever one of its counters changes */
+static char watch_path[PATH_MAX];
+static int watch_fd = -1;
+static int watch_descriptor = -1;
+static struct cgroup_events watch_totals;
+
+/* mount point of the unified hierarchy, hybrid setups mount it below CGROUP_MOUNT_PATH */
+static char cgroup_mount_path[PATH_MAX];
+
+/* memory.stat entries in the report, all of them are in bytes */
+static char *cgroup_stat_keys[] = {"anon", "file", "kernel", "sock", "slab"};
+
+static void find_cgroup_mount() {
+    char *mounts_buffer;
+    char line[PATH_MAX];
+    char mount_point[PATH_MAX];
+    char fs_type[64];
+
+    strcpy(cgroup_mount_path, CGROUP_MOUNT_PATH);
+
+    mounts_buffer = read_procfs_file("/proc/self/mounts", NULL);
+    if (mounts_buffer == NULL) {
+        return;
+    }
+
+    while (procfs_getline(line, sizeof(line), &mounts_buffer) != NULL) {
+        if (sscanf(line, "%*s %4095s %63s", mount_point, fs_type) == 2 && strcmp(fs_type, "cgroup2") == 0) {
+            strcpy(cgroup_mount_path, mount_point);
+            return;
+        }
+    }
+}
+
+int resolve_cgroup(pid_t pid, char *cgroup_path, size_t size) {
+    char *pid_cgroup_buffer;
+    char pid_cgroup_path[PATH_MAX];
+    char line[PATH_MAX];
+    int ret_snprintf;
+
+    if (cgroup_mount_path[0] == '\0') {
+        find_cgroup_mount();
+    }
+
+    /* construct /proc/pid/cgroup file path name */
+    ret_snprintf = snprintf(pid_cgroup_path, sizeof(pid_cgroup_path), "/proc/%d/cgroup", pid);
+    if (ret_snprintf < 0) {
+        return -1;
+    }
+
+    pid_cgroup_buffer = read_procfs_file(pid_cgroup_path, NULL);
+    if (pid_cgroup_buffer == NULL) {
+        return -1;
+    }
+
+    /* the unified hierarchy is the entry with hierarchy ID 0 and no controller list, e.g. "0::/system.slice/foo.service" */
+    while (procfs_getline(line, sizeof(line), &pid_cgroup_buffer) != NULL) {
+        if (strncmp(line, "0::", 3) != 0) {
+            continue;
+        }
+
+        line[strcspn(line, "\n")] = '\0';
+
+        ret_snprintf = snprintf(cgroup_path, size, "%s%s", cgroup_mount_path, line + 3);
+        if (ret_snprintf < 0 || (size_t)ret_snprintf >= size) {
+            return -1;
+        }
+
+        return 0;
+    }
+
+    return -1;
+}
+
+static int read_cgroup_value(char *cgroup_path, char *name, long int *value, int *unlimited) {
+    char cgroup_file_path[PATH_MAX];
+    char *cgroup_file_buffer;
+    int ret_snprintf;
+
+    ret_snprintf = snprintf(cgroup_file_path, sizeof(cgroup_file_path), "%s/%s", cgroup_path, name);
+    if (ret_snprintf < 0) {
+        return -1;
+    }
+
+    cgroup_file_buffer = read_procfs_file(cgroup_file_path, NULL);
+    if (cgroup_file_buffer == NULL) {
+        return -1;
+    }
+
+    *unlimited = strncmp(cgroup_file_buffer, "max", 3) == 0;
+    if (*unlimited) {
+        return 0;
+    }
+
+    /* covert the string to integer */
+    errno = 0;
+    *value = strtol(cgroup_file_buffer, NULL, 10);
+
+    if (errno != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int get_cgroup_memory(struct cgroup_memory *cgroup, long int total_memory) {
+    long int current = 0;
+    long int limit = 0;
+    int unlimited;
+
+    if (read_cgroup_value(cgroup->path, "memory.current", &current, &unlimited) < 0) {
+        return -1;
+    }
+
+    if (read_cgroup_value(cgroup->path, "memory.max", &limit, &unlimited) < 0) {
+        return -1;
+    }
+
+    cgroup->current = current / 1024;
+
+    /* an unlimited cgroup is only bounded by the system memory */
+    if (unlimited || limit / 1024 > total_memory) {
+        cgroup->limit = total_memory;
+        cgroup->limited = 0;
+    } else {
+        cgroup->limit = limit / 1024;
+        cgroup->limited = 1;
+    }
+
+    return 0;
+}
+
+static int read_cgroup_events(char *cgroup_path, struct cgroup_events *events) {
+    char cgroup_events_path[PATH_MAX];
+    char *cgroup_events_buffer;
+    char line[256];
+    char key[64];
+    long int value;
+    int ret_snprintf;
+
+    ret_snprintf = snprintf(cgroup_events_path, sizeof(cgroup_events_path), "%s/memory.events", cgroup_path);
+    if (ret_snprintf < 0) {
+        return -1;
+    }
+
+    cgroup_events_buffer = read_procfs_file(cgroup_events_path, NULL);
+    if (cgroup_events_buffer == NULL) {
+        return -1;
+    }
+
+    memset(events, 0, sizeof(struct cgroup_events));
+
+    while (procfs_getline(line, sizeof(line), &cgroup_events_buffer) != NULL) {
+        if (sscanf(line, "%63s %ld", key, &value) != 2) {
+            continue;
+        }
+
+        if (strcmp(key, "low") == 0) {
+            events->low = value;
+        } else if (strcmp(key, "high") == 0) {
+            events->high = value;
+        } else if (strcmp(key, "max") == 0) {
+            events->max = value;
+        } else if (strcmp(key, "oom") == 0) {
+            events->oom = value;
+        } else if (strcmp(key, "oom_kill") == 0) {
+            events->oom_kill = value;
+        }
+    }
+
+    return 0;
+}
+
+/* start watching memory.events of another cgroup, its current counters are the baseline */
+static int watch_cgroup_events(char *cgroup_path) {
+    char cgroup_events_path[PATH_MAX];
+    int ret_snprintf;
+
+    if (watch_fd < 0) {
+        watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (watch_fd < 0) {
+            fprintf(stderr, "WARNING: failed to initialize inotify, memory.events is read in every cycle: %s\n", strerror(errno));
+        }
+    }
+
+    if (watch_fd >= 0 && watch_descriptor >= 0) {
+        inotify_rm_watch(watch_fd, watch_descriptor);
+        watch_descriptor = -1;
+    }
+
+    watch_path[0] = '\0';
+
+    ret_snprintf = snprintf(cgroup_events_path, sizeof(cgroup_events_path), "%s/memory.events", cgroup_path);
+    if (ret_snprintf < 0) {
+        return -1;
+    }
+
+    if (watch_fd >= 0) {
+        watch_descriptor = inotify_add_watch(watch_fd, cgroup_events_path, IN_MODIFY);
+        if (watch_descriptor < 0) {
+            fprintf(stderr, "WARNING: failed to watch %s, it is read in every cycle: %s\n", cgroup_events_path, strerror(errno));
+        }
+    }
+
+    if (read_cgroup_events(cgroup_path, &watch_totals) < 0) {
+        return -1;
+    }
+
+    strcpy(watch_path, cgroup_path);
+
+    return 0;
+}
+
+/* drain pending notifications, returns 1 if memory.events has been modified */
+static int cgroup_events_modified() {
+    char event_buffer[4096];
+    int modified = 0;
+
+    /* without a watch the counters are compared in every cycle */
+    if (watch_fd < 0 || watch_descriptor < 0) {
+        return 1;
+    }
+
+    while (read(watch_fd, event_buffer, sizeof(event_buffer)) > 0) {
+        modified = 1;
+    }
+
+    return modified;
+}
+
+int get_cgroup_events(struct cgroup_memory *cgroup) {
+    struct cgroup_events totals;
+
+    memset(&cgroup->events, 0, sizeof(struct cgroup_events));
+
+    /* the first cycle of a cgroup has nothing to compare with */
+    if (strcmp(watch_path, cgroup->path) != 0) {
+        return watch_cgroup_events(cgroup->path) < 0 ? -1 : 0;
+    }
+
+    if (!cgroup_events_modified()) {
+        return 0;
+    }
+
+    if (read_cgroup_events(cgroup->path, &totals) < 0) {
+        return -1;
+    }
+
+    cgroup->events.low = totals.low - watch_totals.low;
+    cgroup->events.high = totals.high - watch_totals.high;
+    cgroup->events.max = totals.max - watch_totals.max;
+    cgroup->events.oom = totals.oom - watch_totals.oom;
+    cgroup->events.oom_kill = totals.oom_kill - watch_totals.oom_kill;
+    watch_totals = totals;
+
+    /* hitting memory.max or the OOM killer is worth a full report regardless of the threshold */
+    if (cgroup->events.max > 0 || cgroup->events.oom > 0 || cgroup->events.oom_kill > 0) {
+        return 1;
+    }
+
+    return 0;
+}
+
+void add_cgroup_batch_files(struct procfs_batch *batch, char *cgroup_path) {
+    char path[PATH_MAX];
+
+    if (snprintf(path, sizeof(path), "%s/memory.stat", cgroup_path) < 0) {
+        return;
+    }
+    procfs_batch_add(batch, path);
+
+    if (snprintf(path, sizeof(path), "%s/cgroup.procs", cgroup_path) < 0) {
+        return;
+    }
+    procfs_batch_add(batch, path);
+}
+
+static void print_cgroup_memory_stat(char *cgroup_path) {
+    char cgroup_stat_path[PATH_MAX];
+    char *cgroup_stat_buffer;
+    char line[256];
+    char key[64];
+    long int value;
+    long int values[sizeof(cgroup_stat_keys) / sizeof(cgroup_stat_keys[0])];
+    size_t i;
+
+    if (snprintf(cgroup_stat_path, sizeof(cgroup_stat_path), "%s/memory.stat", cgroup_path) < 0) {
+        return;
+    }
+
+    cgroup_stat_buffer = read_procfs_file(cgroup_stat_path, NULL);
+    if (cgroup_stat_buffer == NULL) {
+        fprintf(stderr, "WARNING: failed to get cgroup memory.stat of %s\n", cgroup_path);
+        return;
+    }
+
+    /* entries missing on older kernels, e.g. kernel before Linux 5.18, are shown as n/a */
+    for (i = 0; i < sizeof(cgroup_stat_keys) / sizeof(cgroup_stat_keys[0]); ++i) {
+        values[i] = -1;
+    }
+
+    while (procfs_getline(line, sizeof(line), &cgroup_stat_buffer) != NULL) {
+        if (sscanf(line, "%63s %ld", key, &value) != 2) {
+            continue;
+        }
+
+        for (i = 0; i < sizeof(cgroup_stat_keys) / sizeof(cgroup_stat_keys[0]); ++i) {
+            if (strcmp(key, cgroup_stat_keys[i]) == 0) {
+                values[i] = value / 1024;
+                break;
+            }
+        }
+    }
+
+    for (i = 0; i < sizeof(cgroup_stat_keys) / sizeof(cgroup_stat_keys[0]); ++i) {
+        if (values[i] < 0) {
+            fprintf(report_output, "Cgroup Memory Stat %s: n/a\n", cgroup_stat_keys[i]);
+        } else {
+            fprintf(report_output, "Cgroup Memory Stat %s: %ld kB\n", cgroup_stat_keys[i], values[i]);
+        }
+    }
+    fflush(report_output);
+}
+
+static void print_cgroup_members(char *cgroup_path) {
+    char cgroup_procs_path[PATH_MAX];
+    char *cgroup_procs_buffer;
+    char line[64];
+    char exe_name[PATH_MAX];
+    pid_t member_pids[CGROUP_MAX_MEMBERS];
+    int member_count = 0;
+    int member_total = 0;
+    int ppid;
+    long int process_rss;
+    long int process_pss;
+    long int process_uss;
+    int i;
+
+    if (snprintf(cgroup_procs_path, sizeof(cgroup_procs_path), "%s/cgroup.procs", cgroup_path) < 0) {
+        return;
+    }
+
+    cgroup_procs_buffer = read_procfs_file(cgroup_procs_path, NULL);
+    if (cgroup_procs_buffer == NULL) {
+        fprintf(stderr, "WARNING: failed to get cgroup member processes of %s\n", cgroup_path);
+        return;
+    }
+
+    /* the PIDs are copied first, reading the members may reuse the buffer of cgroup.procs */
+    while (procfs_getline(line, sizeof(line), &cgroup_procs_buffer) != NULL) {
+        ++member_total;
+        if (member_count < CGROUP_MAX_MEMBERS) {
+            member_pids[member_count++] = strtol(line, NULL, 10);
+        }
+    }
+
+    fprintf(report_output, "Cgroup Member Processes: %d\n", member_total);
+    fflush(report_output);
+
+    for (i = 0; i < member_count; ++i) {
+        /* a member may exit while the report is rendered */
+        if (get_ppid(member_pids[i], &ppid, exe_name) < 0) {
+            continue;
+        }
+
+        if (get_memory_usage(member_pids[i], &process_rss, &process_pss, &process_uss) < 0) {
+            fprintf(report_output, "%d %s - RSS: n/a - PSS: n/a - USS: n/a\n", member_pids[i], exe_name);
+            continue;
+        }
+
+        fprintf(report_output, "%d %s - RSS: %ld kB - PSS: %ld kB - USS: %ld kB\n", member_pids[i], exe_name, process_rss, process_pss, process_uss);
+    }
+
+    if (member_total > member_count) {
+        fprintf(report_output, "... %d more member process(es) are not listed\n", member_total - member_count);
+    }
+    fflush(report_output);
+}
+
+void get_cgroup_memory_report(struct cgroup_memory *cgroup) {
+    fprintf(report_output, "Cgroup Path: %s\n", cgroup->path);
+    fprintf(report_output, "Cgroup Memory Usage: %ld kB\n", cgroup->current);
+
+    if (cgroup->limited) {
+        fprintf(report_output, "Cgroup Memory Limit: %ld kB\n", cgroup->limit);
+    } else {
+        fprintf(report_output, "Cgroup Memory Limit: max (system memory %ld kB)\n", cgroup->limit);
+    }
+
+    if (cgroup->limit > 0) {
+        fprintf(report_output, "Cgroup Memory Pressure: %d%%\n", (int)((float)cgroup->current / (float)cgroup->limit * 100));
+    }
+
+    fprintf(report_output, "Cgroup Memory Events: low +%ld - high +%ld - max +%ld - oom +%ld - oom_kill +%ld\n", cgroup->events.low, cgroup->events.high, cgroup->events.max, cgroup->events.oom, cgroup->events.oom_kill);
+    fflush(report_output);
+
+    print_cgroup_memory_stat(cgroup->path);
+
+    print_cgroup_members(cgroup->path);
+}
+
+void free_cgroup_watch() {
+    if (watch_fd >= 0) {
+        close(watch_fd);
+    }
+
+    watch_fd = -1;
+    watch_descriptor = -1;
+    watch_path[0] = '\0';
+}
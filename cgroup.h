@@ -0,0 +1,36 @@
+#ifndef CGROUP_H
+#define CGROUP_H
+
+#include <limits.h>
+#include <sys/types.h>
+#include "procfs.h"
+
+#define CGROUP_MOUNT_PATH "/sys/fs/cgroup" /* cgroup v2 unified hierarchy, unless /proc/self/mounts has another one */
+#define CGROUP_MAX_MEMBERS 1024 /* member processes listed in a report */
+
+/* counters of memory.events */
+struct cgroup_events {
+    long int low;
+    long int high;
+    long int max;
+    long int oom;
+    long int oom_kill;
+};
+
+/* memory state of the cgroup of the target process, captured in each cycle */
+struct cgroup_memory {
+    char path[PATH_MAX]; /* cgroup directory, empty if it is not resolved */
+    long int current; /* unit: kB */
+    long int limit; /* unit: kB, memory.max or the system memory if memory.max is "max" */
+    int limited; /* 1 if memory.max is set */
+    struct cgroup_events events; /* increase since the previous cycle */
+};
+
+extern int resolve_cgroup(pid_t pid, char *cgroup_path, size_t size);
+extern int get_cgroup_memory(struct cgroup_memory *cgroup, long int total_memory);
+extern int get_cgroup_events(struct cgroup_memory *cgroup);
+extern void add_cgroup_batch_files(struct procfs_batch *batch, char *cgroup_path);
+extern void get_cgroup_memory_report(struct cgroup_memory *cgroup);
+extern void free_cgroup_watch();
+
+#endif /* CGROUP_H */
@@ -0,0 +1,317 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "dump.h"
+#include "process.h"
+#include "procfs.h"
+#include "utils.h"
+
+/* an anonymous mapping selected for the dump */
+struct dump_vma {
+    unsigned long start_address;
+    unsigned long end_address;
+    char permission_bits[5];
+    char file_pathname[16]; /* [heap], [stack] or empty */
+};
+
+/* everything is allocated up front, a dump under memory pressure must not allocate */
+static char dump_directory[PATH_MAX];
+static unsigned long dump_budget = 0;
+static char *dump_buffer = NULL;
+static char *zero_page = NULL;
+static struct dump_vma *dump_vmas = NULL;
+static struct iovec dump_remote_iov[DUMP_BUFFER_SIZE / 4096];
+static unsigned char dump_unreadable_pages[DUMP_BUFFER_SIZE / 4096]; /* 1 for each page of the buffer that could not be read */
+static long dump_page_size = 0;
+
+int init_memory_dump(char *directory, long budget_mb) {
+    struct stat directory_stat;
+
+    if (stat(directory, &directory_stat) < 0 || !S_ISDIR(directory_stat.st_mode)) {
+        fprintf(stderr, "ERROR: dump directory %s is not a directory\n", directory);
+        return -1;
+    }
+
+    if (snprintf(dump_directory, sizeof(dump_directory), "%s", directory) >= (int)sizeof(dump_directory)) {
+        fprintf(stderr, "ERROR: dump directory path %s is too long\n", directory);
+        return -1;
+    }
+
+    dump_page_size = sysconf(_SC_PAGESIZE);
+    if (dump_page_size <= 0 || DUMP_BUFFER_SIZE % dump_page_size != 0 || DUMP_BUFFER_SIZE / dump_page_size > (long)(sizeof(dump_remote_iov) / sizeof(dump_remote_iov[0]))) {
+        fprintf(stderr, "ERROR: page size %ld is not supported by the memory dump\n", dump_page_size);
+        return -1;
+    }
+
+    dump_budget = (unsigned long)budget_mb * 1024 * 1024;
+
+    dump_buffer = (char *)malloc(DUMP_BUFFER_SIZE);
+    zero_page = (char *)calloc(1, dump_page_size);
+    dump_vmas = (struct dump_vma *)malloc(DUMP_MAX_VMAS * sizeof(struct dump_vma));
+    if (dump_buffer == NULL || zero_page == NULL || dump_vmas == NULL) {
+        fprintf(stderr, "ERROR: failed to allocate memory for the memory dump\n");
+        free_memory_dump();
+        return -1;
+    }
+
+    /* touch the buffer now, so that it is not faulted in while the target is under pressure */
+    memset(dump_buffer, 0, DUMP_BUFFER_SIZE);
+
+    return 0;
+}
+
+/* private writable anonymous mappings, [heap] first as it is the usual suspect */
+static size_t select_dump_vmas(pid_t pid) {
+    char maps_path[PATH_MAX];
+    char *maps_buffer;
+    char line[BUFSIZ];
+    struct mapping mapping;
+    struct dump_vma swap;
+    size_t count = 0;
+
+    if (snprintf(maps_path, sizeof(maps_path), "/proc/%d/maps", pid) < 0) {
+        return 0;
+    }
+
+    maps_buffer = read_procfs_file(maps_path, NULL);
+    if (maps_buffer == NULL) {
+        return 0;
+    }
+
+    while (count < DUMP_MAX_VMAS && procfs_getline(line, sizeof(line), &maps_buffer) != NULL) {
+        if (parse_memory_mapping(line, &mapping) < 0) {
+            continue;
+        }
+
+        if (strcmp(mapping.permission_bits, "rw-p") != 0 && strcmp(mapping.permission_bits, "rwxp") != 0) {
+            continue;
+        }
+
+        if (mapping.file_pathname[0] != '\0' && strcmp(mapping.file_pathname, "[heap]") != 0 && strcmp(mapping.file_pathname, "[stack]") != 0) {
+            continue;
+        }
+
+        dump_vmas[count].start_address = mapping.start_address;
+        dump_vmas[count].end_address = mapping.end_address;
+        strcpy(dump_vmas[count].permission_bits, mapping.permission_bits);
+        strcpy(dump_vmas[count].file_pathname, mapping.file_pathname);
+
+        if (strcmp(mapping.file_pathname, "[heap]") == 0 && count > 0) {
+            swap = dump_vmas[0];
+            dump_vmas[0] = dump_vmas[count];
+            dump_vmas[count] = swap;
+        }
+
+        ++count;
+    }
+
+    return count;
+}
+
+/* read the pages of [address, address + length) into the buffer, an unreadable page is marked and counted */
+static int read_dump_chunk(pid_t pid, unsigned long address, size_t length, unsigned long *unreadable_bytes) {
+    struct iovec local_iov;
+    size_t page_count = length / dump_page_size;
+    size_t done = 0;
+    size_t requested;
+    ssize_t ret_readv;
+    size_t i;
+
+    for (i = 0; i < page_count; ++i) {
+        dump_remote_iov[i].iov_base = (void *)(address + i * dump_page_size);
+        dump_remote_iov[i].iov_len = dump_page_size;
+        dump_unreadable_pages[i] = 0;
+    }
+
+    /* one iovec per page, so that a failed page only stops the batch where it is */
+    while (done < page_count) {
+        requested = (page_count - done) * dump_page_size;
+        local_iov.iov_base = dump_buffer + done * dump_page_size;
+        local_iov.iov_len = requested;
+
+        ret_readv = process_vm_readv(pid, &local_iov, 1, &dump_remote_iov[done], page_count - done, 0);
+        if (ret_readv < 0 && errno != EFAULT && errno != ENOMEM) {
+            return -1;
+        }
+
+        if (ret_readv > 0) {
+            done += ret_readv / dump_page_size;
+        }
+
+        /* the page where the batch stopped is not mapped or not readable, e.g. a PROT_NONE guard page */
+        if (done < page_count && ret_readv < (ssize_t)requested) {
+            dump_unreadable_pages[done] = 1;
+            *unreadable_bytes += dump_page_size;
+            ++done;
+        }
+    }
+
+    return 0;
+}
+
+/* 1 if the page at offset of the buffer is left as a hole, i.e. it is unreadable or zero */
+static int is_dump_hole(size_t offset) {
+    return dump_unreadable_pages[offset / dump_page_size] || memcmp(dump_buffer + offset, zero_page, dump_page_size) == 0;
+}
+
+/* write the readable non-zero pages of the buffer, the other pages are left as holes of the sparse file */
+static int write_dump_chunk(int dump_fd, off_t file_offset, size_t length, unsigned long *bytes_written, unsigned long *zero_bytes) {
+    size_t run_start;
+    size_t offset = 0;
+
+    while (offset < length) {
+        if (is_dump_hole(offset)) {
+            /* an unreadable page is already counted by read_dump_chunk() */
+            if (!dump_unreadable_pages[offset / dump_page_size]) {
+                *zero_bytes += dump_page_size;
+            }
+
+            offset += dump_page_size;
+            continue;
+        }
+
+        run_start = offset;
+        while (offset < length && !is_dump_hole(offset)) {
+            offset += dump_page_size;
+        }
+
+        if (pwrite(dump_fd, dump_buffer + run_start, offset - run_start, file_offset + run_start) != (ssize_t)(offset - run_start)) {
+            return -1;
+        }
+
+        *bytes_written += offset - run_start;
+    }
+
+    /* the dump must not pile up in the page cache of a host under pressure */
+    sync_file_range(dump_fd, file_offset, length, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+    posix_fadvise(dump_fd, file_offset, length, POSIX_FADV_DONTNEED);
+
+    return 0;
+}
+
+int dump_anonymous_memory(pid_t pid, time_t report_time, struct dump_result *result) {
+    char index_path[PATH_MAX];
+    struct timespec dump_start_time;
+    struct dump_vma *vma;
+    FILE *index_file;
+    int dump_fd;
+    int index_fd;
+    size_t vma_count;
+    size_t i;
+    unsigned long address;
+    unsigned long vma_end;
+    unsigned long vma_unreadable;
+    unsigned long vma_zero;
+    size_t length;
+    off_t file_offset = 0;
+    off_t vma_offset;
+    int ret_dump = 0;
+
+    memset(result, 0, sizeof(struct dump_result));
+    result->status = -1;
+
+    if (dump_buffer == NULL) {
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &dump_start_time);
+
+    if (snprintf(result->path, sizeof(result->path), "%s/memdoor-%d-%ld.dump", dump_directory, pid, (long)report_time) >= (int)sizeof(result->path) || snprintf(index_path, sizeof(index_path), "%s.index", result->path) >= (int)sizeof(index_path)) {
+        fprintf(stderr, "ERROR: dump file path in %s is too long\n", dump_directory);
+        return -1;
+    }
+
+    vma_count = select_dump_vmas(pid);
+
+    dump_fd = open(result->path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (dump_fd < 0) {
+        fprintf(stderr, "ERROR: failed to create dump file %s: %s\n", result->path, strerror(errno));
+        return -1;
+    }
+
+    /* the index tells where the memory is, it is as private as the dump */
+    index_fd = open(index_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    index_file = index_fd < 0 ? NULL : fdopen(index_fd, "w");
+    if (index_file == NULL) {
+        fprintf(stderr, "ERROR: failed to create dump index file %s: %s\n", index_path, strerror(errno));
+        if (index_fd >= 0) {
+            close(index_fd);
+        }
+        close(dump_fd);
+        return -1;
+    }
+
+    fprintf(index_file, "# memdoor anonymous memory dump of PID %d, report time %ld, page size %ld\n", pid, (long)report_time, dump_page_size);
+    fprintf(index_file, "# FILE OFFSET, LENGTH, START ADDRESS, END ADDRESS, PERM, ZERO BYTES, UNREADABLE BYTES, FILE PATH\n");
+
+    for (i = 0; i < vma_count && result->bytes_read < dump_budget && ret_dump == 0; ++i) {
+        vma = &dump_vmas[i];
+        vma_offset = file_offset;
+        vma_zero = result->zero_bytes;
+        vma_unreadable = result->unreadable_bytes;
+
+        /* the budget may cut the last mapping short */
+        vma_end = vma->end_address;
+        if (vma_end - vma->start_address > dump_budget - result->bytes_read) {
+            vma_end = vma->start_address + (dump_budget - result->bytes_read);
+        }
+
+        for (address = vma->start_address; address < vma_end; address += length) {
+            length = vma_end - address < DUMP_BUFFER_SIZE ? vma_end - address : DUMP_BUFFER_SIZE;
+
+            if (read_dump_chunk(pid, address, length, &result->unreadable_bytes) < 0) {
+                fprintf(stderr, "ERROR: failed to read the memory of PID %d: %s\n", pid, strerror(errno));
+                ret_dump = -1;
+                break;
+            }
+
+            if (write_dump_chunk(dump_fd, file_offset, length, &result->bytes_written, &result->zero_bytes) < 0) {
+                fprintf(stderr, "ERROR: failed to write dump file %s: %s\n", result->path, strerror(errno));
+                ret_dump = -1;
+                break;
+            }
+
+            file_offset += length;
+            result->bytes_read += length;
+        }
+
+        if (file_offset > vma_offset) {
+            fprintf(index_file, "%016lx %016lx %016lx %016lx %s %lu %lu %s\n", (unsigned long)vma_offset, (unsigned long)(file_offset - vma_offset), vma->start_address, vma->start_address + (file_offset - vma_offset), vma->permission_bits, result->zero_bytes - vma_zero, result->unreadable_bytes - vma_unreadable, vma->file_pathname);
+            ++result->vma_count;
+        }
+    }
+
+    /* trailing zero pages are a hole as well */
+    if (ret_dump == 0 && ftruncate(dump_fd, file_offset) < 0) {
+        fprintf(stderr, "ERROR: failed to extend dump file %s: %s\n", result->path, strerror(errno));
+        ret_dump = -1;
+    }
+
+    if (fclose(index_file) != 0) {
+        fprintf(stderr, "ERROR: failed to write dump index file %s: %s\n", index_path, strerror(errno));
+        ret_dump = -1;
+    }
+    close(dump_fd);
+
+    result->latency = get_elapsed_microseconds(&dump_start_time);
+    result->status = ret_dump == 0 ? 1 : -1;
+
+    return ret_dump;
+}
+
+void free_memory_dump() {
+    free(dump_buffer);
+    free(zero_page);
+    free(dump_vmas);
+
+    dump_buffer = NULL;
+    zero_page = NULL;
+    dump_vmas = NULL;
+}
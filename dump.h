@@ -0,0 +1,28 @@
+#ifndef DUMP_H
+#define DUMP_H
+
+#include <limits.h>
+#include <time.h>
+#include <sys/types.h>
+
+#define DUMP_BUFFER_SIZE (1024 * 1024) /* the only buffer of the dump, the target memory is streamed through it */
+#define DUMP_MAX_VMAS 4096 /* anonymous mappings considered by one dump */
+#define DUMP_DEFAULT_BUDGET 64 /* unit: MB */
+
+/* outcome of the latest dump, rendered with the report that triggered it */
+struct dump_result {
+    int status; /* 0 if no dump is taken in this cycle, 1 if it is written, -1 if it failed */
+    char path[PATH_MAX];
+    size_t vma_count; /* mappings in the dump, the last one may be truncated by the budget */
+    unsigned long bytes_read; /* unit: byte, logical size of the dump */
+    unsigned long bytes_written; /* unit: byte, pages which are neither zero nor unreadable */
+    unsigned long zero_bytes; /* unit: byte, holes of zero pages */
+    unsigned long unreadable_bytes; /* unit: byte, holes of pages process_vm_readv() could not read */
+    long latency; /* unit: microsecond */
+};
+
+extern int init_memory_dump(char *directory, long budget_mb);
+extern int dump_anonymous_memory(pid_t pid, time_t report_time, struct dump_result *result);
+extern void free_memory_dump();
+
+#endif /* DUMP_H */
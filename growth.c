@@ -0,0 +1,423 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include "growth.h"
+#include "procfs.h"
+#include "process.h"
+#include "utils.h"
+
+/* a candidate of the top growing mappings */
+struct vma_growth {
+    double rate; /* unit: kB/s */
+    double window; /* unit: second */
+    struct vma_history *history;
+};
+
+static pid_t history_pid = 0;
+
+/* number of samples taken so far, the index of the current sample is sample_count */
+static unsigned long sample_count = 0;
+static double sample_time[VMA_HISTORY_SIZE]; /* CLOCK_MONOTONIC seconds when each sample was captured */
+
+/* mappings of the previous and the current sample, both sorted by start address as in /proc/pid/smaps */
+static struct vma_history **previous_history = NULL;
+static size_t previous_count = 0;
+static size_t previous_capacity = 0;
+static struct vma_history **current_history = NULL;
+static size_t current_count = 0;
+static size_t current_capacity = 0;
+
+static void free_history_entry(struct vma_history *entry) {
+    free(entry->file_pathname);
+    free(entry);
+}
+
+/* entries of the previous sample which are not taken over by a current mapping are gone */
+static void release_history_entry(struct vma_history *entry) {
+    if (entry->reused_sample != sample_count) {
+        free_history_entry(entry);
+    }
+}
+
+static int append_history_entry(struct vma_history *entry) {
+    struct vma_history **new_history;
+    size_t new_capacity;
+
+    if (current_count == current_capacity) {
+        new_capacity = current_capacity == 0 ? 1024 : current_capacity * 2;
+        new_history = (struct vma_history **)realloc(current_history, new_capacity * sizeof(struct vma_history *));
+        if (new_history == NULL) {
+            return -1;
+        }
+
+        current_history = new_history;
+        current_capacity = new_capacity;
+    }
+
+    current_history[current_count++] = entry;
+
+    return 0;
+}
+
+/* match one mapping of the current sample against the previous sample, the cursor only moves forward */
+static int record_mapping(struct mapping *mapping, long int rss, size_t *cursor) {
+    struct vma_history *entry;
+    struct vma_history *match = NULL;
+    unsigned long oldest_sample;
+    unsigned long overlap_start;
+    unsigned long overlap_end;
+    unsigned long i;
+    size_t matches = 0;
+    size_t j;
+    double share;
+
+    /* drop entries of the previous sample that end before this mapping */
+    while (*cursor < previous_count && previous_history[*cursor]->end_address <= mapping->start_address) {
+        release_history_entry(previous_history[*cursor]);
+        ++*cursor;
+    }
+
+    /* find the previous entries of the same backing object overlapping this mapping */
+    for (j = *cursor; j < previous_count && previous_history[j]->start_address < mapping->end_address; ++j) {
+        if (strcmp(previous_history[j]->file_pathname, mapping->file_pathname) == 0) {
+            match = previous_history[j];
+            ++matches;
+        }
+    }
+
+    if (matches == 1 && match->start_address >= mapping->start_address && match->end_address <= mapping->end_address && match->reused_sample != sample_count) {
+        /* unchanged, grown or moved start (e.g. [stack]) mapping keeps its history as is */
+        entry = match;
+    } else {
+        entry = (struct vma_history *)calloc(1, sizeof(struct vma_history));
+        if (entry == NULL) {
+            return -1;
+        }
+
+        entry->file_pathname = strdup(mapping->file_pathname);
+        if (entry->file_pathname == NULL) {
+            free(entry);
+            return -1;
+        }
+
+        entry->first_sample = sample_count;
+
+        /* split, merged or shrunk mapping: inherit history in proportion to the overlapping address range */
+        if (matches > 0) {
+            entry->first_sample = 0;
+
+            for (j = *cursor; j < previous_count && previous_history[j]->start_address < mapping->end_address; ++j) {
+                if (strcmp(previous_history[j]->file_pathname, mapping->file_pathname) == 0 && previous_history[j]->first_sample > entry->first_sample) {
+                    entry->first_sample = previous_history[j]->first_sample;
+                }
+            }
+
+            oldest_sample = entry->first_sample;
+            if (sample_count >= VMA_HISTORY_SIZE && oldest_sample < sample_count - VMA_HISTORY_SIZE + 1) {
+                oldest_sample = sample_count - VMA_HISTORY_SIZE + 1;
+            }
+
+            for (j = *cursor; j < previous_count && previous_history[j]->start_address < mapping->end_address; ++j) {
+                match = previous_history[j];
+                if (strcmp(match->file_pathname, mapping->file_pathname) != 0) {
+                    continue;
+                }
+
+                overlap_start = match->start_address > mapping->start_address ? match->start_address : mapping->start_address;
+                overlap_end = match->end_address < mapping->end_address ? match->end_address : mapping->end_address;
+                share = (double)(overlap_end - overlap_start) / (match->end_address - match->start_address);
+
+                for (i = oldest_sample; i < sample_count; ++i) {
+                    entry->rss[i % VMA_HISTORY_SIZE] += (long int)(match->rss[i % VMA_HISTORY_SIZE] * share);
+                }
+            }
+        }
+    }
+
+    entry->start_address = mapping->start_address;
+    entry->end_address = mapping->end_address;
+    strcpy(entry->permission_bits, mapping->permission_bits);
+    entry->reused_sample = sample_count;
+    entry->rss[sample_count % VMA_HISTORY_SIZE] = rss;
+
+    if (append_history_entry(entry) < 0) {
+        free_history_entry(entry);
+        return -1;
+    }
+
+    return 0;
+}
+
+int update_vma_history(pid_t pid, double capture_time) {
+    char *process_smaps_buffer;
+    process_smaps_buffer = NULL;
+
+    char process_smaps_file_path[PATH_MAX];
+    int ret_snprintf;
+
+    char line[BUFSIZ];
+    char *toggle_str;
+
+    /* a mapping header line is followed by its Rss line, the mapping is recorded once the next header is read */
+    struct mapping mappings[2];
+    struct mapping *pending_mapping = NULL;
+    struct mapping *next_mapping = &mappings[0];
+    long int rss = 0;
+    int ret_record = 0;
+
+    struct vma_history **swap_history;
+    size_t swap_capacity;
+    size_t cursor = 0;
+
+    /* start over if the target process has changed */
+    if (history_pid != pid) {
+        free_vma_history();
+        history_pid = pid;
+    }
+
+    /* construct process smaps file path based on pid */
+    ret_snprintf = snprintf(process_smaps_file_path, sizeof(process_smaps_file_path), "/proc/%d/smaps", pid);
+    if (ret_snprintf < 0) {
+        return -1;
+    }
+
+    process_smaps_buffer = read_procfs_file(process_smaps_file_path, NULL);
+    if (process_smaps_buffer == NULL) {
+        return -1;
+    }
+
+    sample_time[sample_count % VMA_HISTORY_SIZE] = capture_time;
+    current_count = 0;
+
+    while (ret_record == 0 && procfs_getline(line, sizeof(line), &process_smaps_buffer) != NULL) {
+        if (strncmp(line, "Rss:", 4) == 0) {
+            /* skip ':' char */
+            toggle_str = strchr(line, ':') + 1;
+
+            /* covert the string to integer */
+            errno = 0;
+            rss = strtol(toggle_str, NULL, 10);
+
+            if (errno != 0) {
+                rss = 0;
+            }
+
+            continue;
+        }
+
+        if (parse_memory_mapping(line, next_mapping) < 0) {
+            continue;
+        }
+
+        if (pending_mapping != NULL) {
+            ret_record = record_mapping(pending_mapping, rss, &cursor);
+        }
+
+        pending_mapping = next_mapping;
+        next_mapping = next_mapping == &mappings[0] ? &mappings[1] : &mappings[0];
+        rss = 0;
+    }
+
+    if (ret_record == 0 && pending_mapping != NULL) {
+        ret_record = record_mapping(pending_mapping, rss, &cursor);
+    }
+
+    /* the rest of the previous sample is gone */
+    while (cursor < previous_count) {
+        release_history_entry(previous_history[cursor]);
+        ++cursor;
+    }
+
+    /* the current sample becomes the previous sample of the next cycle */
+    swap_history = previous_history;
+    swap_capacity = previous_capacity;
+    previous_history = current_history;
+    previous_count = current_count;
+    previous_capacity = current_capacity;
+    current_history = swap_history;
+    current_count = 0;
+    current_capacity = swap_capacity;
+
+    ++sample_count;
+
+    if (ret_record < 0) {
+        fprintf(stderr, "ERROR: failed to allocate memory for mapping history\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+void add_vma_history_batch_files(struct procfs_batch *batch, pid_t pid) {
+    char path[PATH_MAX];
+
+    if (snprintf(path, sizeof(path), "/proc/%d/smaps", pid) < 0) {
+        return;
+    }
+
+    procfs_batch_add(batch, path);
+}
+
+/* min-heap on the growth rate keeps the top N candidates */
+static void sift_down_growth(struct vma_growth *heap, size_t heap_count, size_t index) {
+    struct vma_growth swap;
+    size_t smallest;
+    size_t child;
+
+    while (1) {
+        smallest = index;
+        child = index * 2 + 1;
+
+        if (child < heap_count && heap[child].rate < heap[smallest].rate) {
+            smallest = child;
+        }
+
+        if (child + 1 < heap_count && heap[child + 1].rate < heap[smallest].rate) {
+            smallest = child + 1;
+        }
+
+        if (smallest == index) {
+            return;
+        }
+
+        swap = heap[index];
+        heap[index] = heap[smallest];
+        heap[smallest] = swap;
+        index = smallest;
+    }
+}
+
+static void sift_up_growth(struct vma_growth *heap, size_t index) {
+    struct vma_growth swap;
+    size_t parent;
+
+    while (index > 0) {
+        parent = (index - 1) / 2;
+
+        if (heap[parent].rate <= heap[index].rate) {
+            return;
+        }
+
+        swap = heap[index];
+        heap[index] = heap[parent];
+        heap[parent] = swap;
+        index = parent;
+    }
+}
+
+static int compare_growth(const void *a, const void *b) {
+    const struct vma_growth *growth_a = (const struct vma_growth *)a;
+    const struct vma_growth *growth_b = (const struct vma_growth *)b;
+
+    if (growth_a->rate < growth_b->rate) {
+        return 1;
+    } else if (growth_a->rate > growth_b->rate) {
+        return -1;
+    }
+
+    return 0;
+}
+
+void get_top_growing_mappings(pid_t pid, long top_count, double capture_time) {
+    struct vma_growth *heap;
+    struct vma_growth candidate;
+    size_t heap_capacity;
+    size_t heap_count = 0;
+    size_t i;
+
+    struct vma_history *entry;
+    unsigned long latest_sample;
+    unsigned long oldest_sample;
+
+    if (update_vma_history(pid, capture_time) < 0) {
+        fprintf(stderr, "ERROR: failed to update the PID %d memory mapping history\n", pid);
+        return;
+    }
+
+    if (sample_count < 2) {
+        fprintf(report_output, "Collecting memory mapping growth samples, growth rates are available from the next cycle\n");
+        fflush(report_output);
+        return;
+    }
+
+    heap_capacity = (size_t)top_count < previous_count ? (size_t)top_count : previous_count;
+    if (heap_capacity == 0) {
+        return;
+    }
+
+    heap = (struct vma_growth *)malloc(heap_capacity * sizeof(struct vma_growth));
+    if (heap == NULL) {
+        fprintf(stderr, "ERROR: failed to allocate memory for top growing mappings\n");
+        return;
+    }
+
+    latest_sample = sample_count - 1;
+
+    /* growth rate over the samples kept in the ring of each mapping */
+    for (i = 0; i < previous_count; ++i) {
+        entry = previous_history[i];
+
+        oldest_sample = entry->first_sample;
+        if (latest_sample >= VMA_HISTORY_SIZE && oldest_sample < latest_sample - VMA_HISTORY_SIZE + 1) {
+            oldest_sample = latest_sample - VMA_HISTORY_SIZE + 1;
+        }
+
+        if (oldest_sample == latest_sample) {
+            continue;
+        }
+
+        candidate.window = sample_time[latest_sample % VMA_HISTORY_SIZE] - sample_time[oldest_sample % VMA_HISTORY_SIZE];
+        if (candidate.window <= 0) {
+            continue;
+        }
+
+        candidate.rate = (entry->rss[latest_sample % VMA_HISTORY_SIZE] - entry->rss[oldest_sample % VMA_HISTORY_SIZE]) / candidate.window;
+        candidate.history = entry;
+
+        if (heap_count < heap_capacity) {
+            heap[heap_count] = candidate;
+            sift_up_growth(heap, heap_count);
+            ++heap_count;
+        } else if (candidate.rate > heap[0].rate) {
+            heap[0] = candidate;
+            sift_down_growth(heap, heap_count, 0);
+        }
+    }
+
+    qsort(heap, heap_count, sizeof(struct vma_growth), compare_growth);
+
+    /* print header */
+    fprintf(report_output, "%-16s  %-15s     %-15s       %-10s %-5s %s\n", "START ADDRESS", "RSS", "GROWTH", "WINDOW", "PERM", "FILE PATH");
+    fflush(report_output);
+
+    for (i = 0; i < heap_count; ++i) {
+        entry = heap[i].history;
+
+        fprintf(report_output, "%016lx  %-15ld kB  %-15.1f kB/s  %-8.1f s  %-5s %s\n", entry->start_address, entry->rss[latest_sample % VMA_HISTORY_SIZE], heap[i].rate, heap[i].window, entry->permission_bits, entry->file_pathname);
+        fflush(report_output);
+    }
+
+    free(heap);
+}
+
+void free_vma_history() {
+    size_t i;
+
+    for (i = 0; i < previous_count; ++i) {
+        free_history_entry(previous_history[i]);
+    }
+
+    free(previous_history);
+    free(current_history);
+
+    previous_history = NULL;
+    previous_count = 0;
+    previous_capacity = 0;
+    current_history = NULL;
+    current_count = 0;
+    current_capacity = 0;
+    sample_count = 0;
+    history_pid = 0;
+}
@@ -0,0 +1,25 @@
+#ifndef GROWTH_H
+#define GROWTH_H
+
+#include <sys/types.h>
+#include "procfs.h"
+
+#define VMA_HISTORY_SIZE 16 /* samples kept per mapping, it is also the growth rate window */
+
+/* RSS history of one mapping, keyed by start address and pathname */
+struct vma_history {
+    unsigned long start_address;
+    unsigned long end_address;
+    char permission_bits[5];
+    char *file_pathname;
+    unsigned long first_sample; /* index of the oldest valid sample */
+    unsigned long reused_sample; /* index of the sample that took over this entry */
+    long int rss[VMA_HISTORY_SIZE]; /* unit: kB, indexed by sample index % VMA_HISTORY_SIZE */
+};
+
+extern int update_vma_history(pid_t pid, double capture_time);
+extern void add_vma_history_batch_files(struct procfs_batch *batch, pid_t pid);
+extern void get_top_growing_mappings(pid_t pid, long top_count, double capture_time);
+extern void free_vma_history();
+
+#endif /* GROWTH_H */
@@ -0,0 +1,31 @@
+#ifndef LIBMEMDOOR_H
+#define LIBMEMDOOR_H
+
+/*
+ * collectors of libmemdoor, they fill caller-provided records instead of printing
+ *
+ * - collect_process_tree(): the ancestor chain of a PID into an array of struct ancestor, the ancestors are cached by PID
+ *   and start time and their memory figures are read every set_process_tree_refresh() walks
+ * - collect_memory_mappings(): /proc/pid/maps into a reusable struct mapping_list, get_mapping_path() returns the path
+ *   of an entry
+ * - collect_network_connections(): the sockets of a PID into a reusable struct socket_list
+ * - collect_mapping_summary(): /proc/pid/maps or smaps grouped by backing object into a reusable struct mapping_summary
+ * - collect_thread_census(): the threads of a PID grouped by comm, with their stack mappings, into a reusable struct thread_census
+ *
+ * the lists only grow, a caller keeps them across collections and releases them with free_mapping_list(),
+ * free_socket_list(), free_mapping_summary() and free_thread_census(). files are read with blocking syscalls into
+ * a thread-local buffer unless a procfs batch is used, a thread calls procfs_thread_cleanup() before it exits and
+ * free_netns_cache() releases the parsed /proc/net tables, call netns_cache_next_cycle() to load fresh tables.
+ *
+ * the reusable arrays stay at the size of the largest collection until they are freed, which matters on a host that
+ * is running out of memory: a struct mapping_list costs about 64 bytes per mapping plus its path, e.g. about 4 MB for
+ * a JVM with 40k thread stacks, a struct mapping_summary about the same per group and a struct socket_list per socket.
+ * free the lists after a large collection if the memory should be returned.
+ */
+#include "mapsummary.h"
+#include "process.h"
+#include "network.h"
+#include "procfs.h"
+#include "threads.h"
+
+#endif /* LIBMEMDOOR_H */
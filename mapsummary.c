@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include "mapsummary.h"
+#include "process.h"
+#include "procfs.h"
+
+static char *mapping_object_type_names[MAPPING_OBJECT_TYPE_COUNT] = {"file", "anon", "heap", "stack", "shmem", "special"};
+
+char *get_mapping_object_type_name(enum mapping_object_type type) {
+    return mapping_object_type_names[type];
+}
+
+static enum mapping_object_type get_mapping_object_type(struct mapping *mapping) {
+    char *path = mapping->file_pathname;
+
+    if (path[0] == '\0' || strncmp(path, "[anon:", 6) == 0) {
+        return MAPPING_OBJECT_ANON;
+    }
+
+    if (strcmp(path, "[heap]") == 0) {
+        return MAPPING_OBJECT_HEAP;
+    }
+
+    /* older kernels name thread stacks [stack:<tid>] */
+    if (strncmp(path, "[stack", 6) == 0) {
+        return MAPPING_OBJECT_STACK;
+    }
+
+    if (strncmp(path, "[anon_shmem:", 12) == 0 || strncmp(path, "/memfd:", 7) == 0 || strncmp(path, "/SYSV", 5) == 0 || strncmp(path, "/dev/shm/", 9) == 0 || strcmp(path, "/dev/zero") == 0) {
+        return MAPPING_OBJECT_SHMEM;
+    }
+
+    if (path[0] == '[') {
+        return MAPPING_OBJECT_SPECIAL;
+    }
+
+    return MAPPING_OBJECT_FILE;
+}
+
+/* FNV-1a over the group key */
+static uint64_t hash_mapping_key(struct mapping *mapping) {
+    uint64_t hash = 14695981039346656037ULL;
+    unsigned char *cursor;
+    size_t i;
+
+    cursor = (unsigned char *)&mapping->file_inode;
+    for (i = 0; i < sizeof(mapping->file_inode); ++i) {
+        hash = (hash ^ cursor[i]) * 1099511628211ULL;
+    }
+
+    for (cursor = (unsigned char *)mapping->dev; *cursor != '\0'; ++cursor) {
+        hash = (hash ^ *cursor) * 1099511628211ULL;
+    }
+
+    for (cursor = (unsigned char *)mapping->permission_bits; *cursor != '\0'; ++cursor) {
+        hash = (hash ^ *cursor) * 1099511628211ULL;
+    }
+
+    for (cursor = (unsigned char *)mapping->file_pathname; *cursor != '\0'; ++cursor) {
+        hash = (hash ^ *cursor) * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static int is_mapping_group(struct mapping_group *group, uint64_t hash, struct mapping *mapping) {
+    return group->hash == hash && group->file_inode == mapping->file_inode && strcmp(group->dev, mapping->dev) == 0 && strcmp(group->permission_bits, mapping->permission_bits) == 0 && strcmp(group->file_pathname, mapping->file_pathname) == 0;
+}
+
+static int grow_mapping_buckets(struct mapping_summary *summary) {
+    size_t *new_buckets;
+    size_t new_bucket_count;
+    size_t bucket;
+    size_t i;
+
+    new_bucket_count = summary->bucket_count > 0 ? summary->bucket_count * 2 : MAPPING_SUMMARY_INITIAL_BUCKETS;
+    new_buckets = (size_t *)calloc(new_bucket_count, sizeof(size_t));
+    if (new_buckets == NULL) {
+        return -1;
+    }
+
+    /* linear probing, the groups are inserted again into the larger table */
+    for (i = 0; i < summary->count; ++i) {
+        bucket = summary->groups[i].hash & (new_bucket_count - 1);
+        while (new_buckets[bucket] != 0) {
+            bucket = (bucket + 1) & (new_bucket_count - 1);
+        }
+        new_buckets[bucket] = i + 1;
+    }
+
+    free(summary->buckets);
+    summary->buckets = new_buckets;
+    summary->bucket_count = new_bucket_count;
+
+    return 0;
+}
+
+/* returns the index of the group of the mapping, -1 if it cannot be allocated */
+static long add_summary_mapping(struct mapping_summary *summary, struct mapping *mapping, int use_smaps) {
+    struct mapping_group *group;
+    struct mapping_group *new_groups;
+    size_t new_capacity;
+    size_t bucket;
+    uint64_t hash;
+
+    hash = hash_mapping_key(mapping);
+
+    bucket = hash & (summary->bucket_count - 1);
+    while (summary->buckets[bucket] != 0) {
+        group = &summary->groups[summary->buckets[bucket] - 1];
+        if (is_mapping_group(group, hash, mapping)) {
+            ++group->count;
+            group->size += mapping->end_address - mapping->start_address;
+            return summary->buckets[bucket] - 1;
+        }
+
+        bucket = (bucket + 1) & (summary->bucket_count - 1);
+    }
+
+    if (summary->count == summary->capacity) {
+        new_capacity = summary->capacity > 0 ? summary->capacity * 2 : 64;
+        new_groups = (struct mapping_group *)realloc(summary->groups, new_capacity * sizeof(struct mapping_group));
+        if (new_groups == NULL) {
+            return -1;
+        }
+
+        summary->groups = new_groups;
+        summary->capacity = new_capacity;
+    }
+
+    group = &summary->groups[summary->count];
+    group->file_pathname = strdup(mapping->file_pathname);
+    if (group->file_pathname == NULL) {
+        return -1;
+    }
+
+    group->type = get_mapping_object_type(mapping);
+    strcpy(group->permission_bits, mapping->permission_bits);
+    strcpy(group->dev, mapping->dev);
+    group->file_inode = mapping->file_inode;
+    group->hash = hash;
+    group->count = 1;
+    group->size = mapping->end_address - mapping->start_address;
+    group->rss = use_smaps ? 0 : -1;
+
+    summary->buckets[bucket] = ++summary->count;
+
+    /* keep the load factor at most 1/2 */
+    if (summary->count * 2 >= summary->bucket_count && grow_mapping_buckets(summary) < 0) {
+        return -1;
+    }
+
+    return summary->count - 1;
+}
+
+static void reset_mapping_summary(struct mapping_summary *summary) {
+    size_t i;
+
+    for (i = 0; i < summary->count; ++i) {
+        free(summary->groups[i].file_pathname);
+    }
+
+    summary->count = 0;
+    summary->mapping_count = 0;
+    summary->rss_available = 0;
+
+    if (summary->buckets != NULL) {
+        memset(summary->buckets, 0, summary->bucket_count * sizeof(size_t));
+    }
+}
+
+static int compare_mapping_group_size(const void *a, const void *b) {
+    const struct mapping_group *group_a = (const struct mapping_group *)a;
+    const struct mapping_group *group_b = (const struct mapping_group *)b;
+
+    if (group_a->size < group_b->size) {
+        return 1;
+    } else if (group_a->size > group_b->size) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int collect_mapping_summary(pid_t pid, int use_smaps, struct mapping_summary *summary) {
+    char mapping_file_path[PATH_MAX];
+    char *mapping_buffer = NULL;
+    char line[BUFSIZ];
+    char *rss_str;
+    struct mapping mapping;
+    long group_index = -1;
+    long int rss;
+
+    reset_mapping_summary(summary);
+
+    if (summary->buckets == NULL && grow_mapping_buckets(summary) < 0) {
+        fprintf(stderr, "ERROR: failed to allocate memory for the PID %d mapping summary\n", pid);
+        return -1;
+    }
+
+    /* smaps is only read if it is captured for the top growing mappings anyway */
+    if (use_smaps && snprintf(mapping_file_path, sizeof(mapping_file_path), "/proc/%d/smaps", pid) >= 0) {
+        mapping_buffer = read_procfs_file(mapping_file_path, NULL);
+    }
+
+    if (mapping_buffer != NULL) {
+        summary->rss_available = 1;
+    } else {
+        use_smaps = 0;
+
+        if (snprintf(mapping_file_path, sizeof(mapping_file_path), "/proc/%d/maps", pid) < 0) {
+            return -1;
+        }
+
+        mapping_buffer = read_procfs_file(mapping_file_path, NULL);
+        if (mapping_buffer == NULL) {
+            fprintf(stderr, "ERROR: failed to open the PID %d memory mapping file: %s\n", pid, mapping_file_path);
+            return -1;
+        }
+    }
+
+    /* one pass, each mapping is merged into its group as it is read */
+    while (procfs_getline(line, sizeof(line), &mapping_buffer) != NULL) {
+        /* the Rss line of smaps belongs to the mapping header before it */
+        if (use_smaps && strncmp(line, "Rss:", 4) == 0) {
+            rss_str = strchr(line, ':') + 1;
+
+            errno = 0;
+            rss = strtol(rss_str, NULL, 10);
+            if (errno == 0 && group_index >= 0) {
+                summary->groups[group_index].rss += rss;
+            }
+
+            continue;
+        }
+
+        if (parse_memory_mapping(line, &mapping) < 0) {
+            continue;
+        }
+
+        group_index = add_summary_mapping(summary, &mapping, use_smaps);
+        if (group_index < 0) {
+            fprintf(stderr, "ERROR: failed to allocate memory for the PID %d mapping summary\n", pid);
+            return -1;
+        }
+
+        ++summary->mapping_count;
+    }
+
+    /* the buckets refer to the unsorted order, they are cleared by the next collection */
+    qsort(summary->groups, summary->count, sizeof(struct mapping_group), compare_mapping_group_size);
+
+    return 0;
+}
+
+void free_mapping_summary(struct mapping_summary *summary) {
+    reset_mapping_summary(summary);
+
+    free(summary->groups);
+    free(summary->buckets);
+    memset(summary, 0, sizeof(struct mapping_summary));
+}
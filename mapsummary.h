@@ -0,0 +1,49 @@
+#ifndef MAPSUMMARY_H
+#define MAPSUMMARY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define MAPPING_SUMMARY_INITIAL_BUCKETS 1024 /* power of two, the table doubles once it is half full */
+
+/* backing object of a mapping */
+enum mapping_object_type {
+    MAPPING_OBJECT_FILE,
+    MAPPING_OBJECT_ANON,
+    MAPPING_OBJECT_HEAP,
+    MAPPING_OBJECT_STACK,
+    MAPPING_OBJECT_SHMEM, /* shmem, memfd, System V shared memory and shared anonymous mappings */
+    MAPPING_OBJECT_SPECIAL, /* [vdso], [vvar], [vsyscall] and other kernel-named mappings */
+    MAPPING_OBJECT_TYPE_COUNT
+};
+
+/* mappings of one backing object with the same permissions, keyed by (dev, inode, path, permissions) */
+struct mapping_group {
+    enum mapping_object_type type;
+    char permission_bits[5];
+    char dev[6];
+    long int file_inode;
+    char *file_pathname; /* empty for anonymous mappings */
+    uint64_t hash;
+    size_t count;
+    unsigned long size; /* unit: byte */
+    long int rss; /* unit: kB, -1 if smaps is not read */
+};
+
+/* groups of the last collection, the arrays are kept and reused by the next collections */
+struct mapping_summary {
+    struct mapping_group *groups; /* sorted by size, largest first */
+    size_t count;
+    size_t capacity;
+    size_t *buckets; /* index + 1 of the group in each hash bucket, 0 if empty */
+    size_t bucket_count;
+    size_t mapping_count;
+    int rss_available; /* 1 if the groups are collected from /proc/pid/smaps */
+};
+
+extern char *get_mapping_object_type_name(enum mapping_object_type type);
+extern int collect_mapping_summary(pid_t pid, int use_smaps, struct mapping_summary *summary);
+extern void free_mapping_summary(struct mapping_summary *summary);
+
+#endif /* MAPSUMMARY_H */
@@ -1,22 +1,35 @@
 #include <errno.h>
 #include <getopt.h>
 #include <limits.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include "archive.h"
+#include "cgroup.h"
+#include "dump.h"
+#include "growth.h"
+#include "network.h"
+#include "numa.h"
+#include "pagemap.h"
 #include "process.h"
+#include "procfs.h"
+#include "report.h"
+#include "runtime.h"
+#include "shmstats.h"
+#include "threads.h"
+#include "topmem.h"
+#include "trend.h"
+#include "trigger.h"
 #include "utils.h"
+#include "vmstat.h"
 
 #define VERSION "1.7.0"
-#define PROCESS_BASIC_INFO_BANNER "##### PROCESS BASIC INFORMATION #####"
-#define PROCESS_MEMORY_INFO_BANNER "##### PROCESS MEMORY INFORMATION #####"
-#define PROCESS_TREE_INFO_BANNER "##### PROCESS TREE INFORMATION #####"
-#define PROCESS_MEMORY_MAPPING_INFO_BANNER "##### PROCESS MEMORY MAPPING INFORMATION #####"
-#define PROCESS_NETWORK_CONNECTION_INFO_BANNER "##### PROCESS NETWORK CONNECTION INFORMATION #####"
 
 /* command options flags */
 static int opt_flag_p = 0;
@@ -24,9 +37,55 @@ static int opt_flag_e = 0;
 static int opt_flag_m = 0;
 static int opt_flag_i = 0;
 static int opt_flag_l = 0;
+static int opt_flag_g = 0;
+static int opt_flag_t = 0;
+static int opt_flag_no_io_uring = 0;
+static int opt_flag_io_stats = 0;
+static int opt_flag_archive = 0;
+static int opt_flag_replay = 0;
+static int opt_flag_sched_fifo = 0;
+static int opt_flag_nice = 0;
+static int opt_flag_oom_protect = 0;
+static int opt_flag_cgroup = 0;
+static int opt_flag_top_consumers = 0;
+static int opt_flag_numa = 0;
+static int opt_flag_numa_threshold = 0;
+static int opt_flag_vmstat = 0;
+static int opt_flag_threads = 0;
+static int opt_flag_trigger = 0;
+
+/* long-only options use values beyond the range of short option characters */
+enum {
+    OPT_PAGEMAP_STRIDE = 256,
+    OPT_PAGEMAP_BUDGET,
+    OPT_HEAVY_CYCLES,
+    OPT_NO_IO_URING,
+    OPT_IO_STATS,
+    OPT_ARCHIVE,
+    OPT_REPLAY,
+    OPT_SCHED_FIFO,
+    OPT_NICE,
+    OPT_CPU_AFFINITY,
+    OPT_OOM_PROTECT,
+    OPT_OUTPUT_POLICY,
+    OPT_SHM_STATS,
+    OPT_CGROUP,
+    OPT_TOP_CONSUMERS,
+    OPT_TREND,
+    OPT_NUMA,
+    OPT_NUMA_THRESHOLD,
+    OPT_MAPPINGS,
+    OPT_DUMP,
+    OPT_DUMP_BUDGET,
+    OPT_VMSTAT,
+    OPT_THREADS,
+    OPT_THREADS_BUDGET,
+    OPT_TRIGGER,
+    OPT_TREE_REFRESH
+};
 
 /* define command-line options */
-static char *short_opts = "p:e:m:i:c:l";
+static char *short_opts = "p:e:m:i:c:lgt:";
 struct option long_opts[] = {
     {"pid", required_argument, NULL, 'p'},
     {"exename", required_argument, NULL, 'e'},
@@ -34,6 +93,34 @@ struct option long_opts[] = {
     {"interval", required_argument, NULL, 'i'},
     {"count", required_argument, NULL, 'c'},
     {"lock-memory", no_argument, NULL, 'l'},
+    {"pagemap", no_argument, NULL, 'g'},
+    {"top-growing", required_argument, NULL, 't'},
+    {"pagemap-stride", required_argument, NULL, OPT_PAGEMAP_STRIDE},
+    {"pagemap-budget", required_argument, NULL, OPT_PAGEMAP_BUDGET},
+    {"heavy-cycles", required_argument, NULL, OPT_HEAVY_CYCLES},
+    {"no-io-uring", no_argument, NULL, OPT_NO_IO_URING},
+    {"io-stats", no_argument, NULL, OPT_IO_STATS},
+    {"archive", required_argument, NULL, OPT_ARCHIVE},
+    {"replay", required_argument, NULL, OPT_REPLAY},
+    {"sched-fifo", required_argument, NULL, OPT_SCHED_FIFO},
+    {"nice", required_argument, NULL, OPT_NICE},
+    {"cpu-affinity", required_argument, NULL, OPT_CPU_AFFINITY},
+    {"oom-protect", no_argument, NULL, OPT_OOM_PROTECT},
+    {"output-policy", required_argument, NULL, OPT_OUTPUT_POLICY},
+    {"shm-stats", required_argument, NULL, OPT_SHM_STATS},
+    {"cgroup", no_argument, NULL, OPT_CGROUP},
+    {"top-consumers", required_argument, NULL, OPT_TOP_CONSUMERS},
+    {"trend", required_argument, NULL, OPT_TREND},
+    {"numa", no_argument, NULL, OPT_NUMA},
+    {"numa-threshold", no_argument, NULL, OPT_NUMA_THRESHOLD},
+    {"mappings", required_argument, NULL, OPT_MAPPINGS},
+    {"dump", required_argument, NULL, OPT_DUMP},
+    {"dump-budget", required_argument, NULL, OPT_DUMP_BUDGET},
+    {"vmstat", no_argument, NULL, OPT_VMSTAT},
+    {"threads", no_argument, NULL, OPT_THREADS},
+    {"threads-budget", required_argument, NULL, OPT_THREADS_BUDGET},
+    {"trigger", required_argument, NULL, OPT_TRIGGER},
+    {"tree-refresh", required_argument, NULL, OPT_TREE_REFRESH},
     {NULL, 0, NULL, 0}
 };
 
@@ -45,12 +132,37 @@ static int ret_munlockall;
 static void usage() {
     printf(
         "memdoor version %s\n"
-        "usage: memdoor -p|--pid <target process id>\n"
+        "usage: memdoor [-p|--pid <target process id>]\n"
         "               -e|--exename <full path of target process>\n"
         "               -i|--interval <second(s)>\n"
         "               [-m|--memory-pressure-threshold <percentage integer>]\n"
         "               [-c|--count <count(s)>]\n"
-        "               [-l|--lock-memory]\n", VERSION
+        "               [-l|--lock-memory]\n"
+        "               [-g|--pagemap]\n"
+        "               [-t|--top-growing <count of mappings>]\n"
+        "               [--pagemap-stride <page(s)>]\n"
+        "               [--pagemap-budget <page(s)>]\n"
+        "               [--heavy-cycles <count(s)>]\n"
+        "               [--no-io-uring]\n"
+        "               [--io-stats]\n"
+        "               [--archive <archive file>]\n"
+        "               [--sched-fifo <priority> | --nice <nice value>]\n"
+        "               [--cpu-affinity <cpu list>]\n"
+        "               [--oom-protect]\n"
+        "               [--output-policy <block|drop-oldest|drop-detail>]\n"
+        "               [--shm-stats </name>]\n"
+        "               [--cgroup]\n"
+        "               [--top-consumers <count of processes>]\n"
+        "               [--trend <csv file>]\n"
+        "               [--numa]\n"
+        "               [--numa-threshold]\n"
+        "               [--mappings <full|summary|both>]\n"
+        "               [--dump <directory> [--dump-budget <MB>]]\n"
+        "               [--vmstat]\n"
+        "               [--threads [--threads-budget <count of threads>]]\n"
+        "               [--trigger <rule> [--trigger <rule>]...]\n"
+        "               [--tree-refresh <count of reports>]\n"
+        "       memdoor --replay <archive file> [-m|-c|-t|--io-stats|--shm-stats|--trend|--numa|--numa-threshold|--mappings|--trigger|--tree-refresh]\n", VERSION
     );
 }
 
@@ -74,21 +186,146 @@ static void sigint_handler(int signo) {
     sigint_flag = 1;
 }
 
+/* render the cycles of an archive at full speed, the threshold of this run is applied to the archived statm RSS */
+static void replay_archive(char *archive_path, long int memory_pressure_threshold, long int count, struct report_config *report_config) {
+    struct report *report;
+    uint64_t cycle_count;
+    int ret_read_replay_cycle;
+    int numa_pressure;
+    int pressure_node;
+    struct trigger_metrics trigger_metrics;
+    unsigned int trigger_sections;
+    int threshold_reached;
+
+    if (open_replay_archive(archive_path, &cycle_count) < 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(stdout, "Replaying %lu cycle(s) from %s\n\n", (unsigned long)cycle_count, archive_path);
+    fflush(stdout);
+
+    /* the archived process is gone, nothing is read from the live /proc */
+    procfs_set_offline(1);
+
+    start_report_renderer(report_config);
+
+    while (sigint_flag == 0 && count != 0) {
+        report = acquire_report();
+
+        ret_read_replay_cycle = read_replay_cycle(report);
+        if (ret_read_replay_cycle < 0) {
+            fprintf(stderr, "ERROR: failed to read a cycle from the archive file %s\n", archive_path);
+            break;
+        }
+
+        if (ret_read_replay_cycle == 0) {
+            break;
+        }
+
+        if (report->status != REPORT_BASIC) {
+            report->status = REPORT_FULL;
+
+            /* the per-node threshold needs numa_maps in the archive, which is only captured with --numa or --numa-threshold */
+            if (opt_flag_m == 1 && opt_flag_numa_threshold) {
+                procfs_batch_use(report->batch);
+                if (get_numa_memory(report->pid, &report->numa_data) < 0) {
+                    report->numa_data.loaded = 0;
+                }
+                procfs_batch_use(NULL);
+            }
+
+            if (opt_flag_m == 1 && report->numa_data.loaded) {
+                numa_pressure = get_numa_pressure(&report->numa_data, &pressure_node);
+                if (numa_pressure >= 0 && numa_pressure < memory_pressure_threshold) {
+                    report->status = REPORT_BELOW_THRESHOLD;
+                }
+            } else if (opt_flag_m == 1 && report->memory_data.total_memory > 0 && (int)((float)report->statm_rss / (float)report->memory_data.total_memory * 100) < memory_pressure_threshold) {
+                report->status = REPORT_BELOW_THRESHOLD;
+            }
+
+            /* the rules run on the archived files, the rates use the archived capture times */
+            if (opt_flag_trigger) {
+                threshold_reached = opt_flag_m == 1 && report->status == REPORT_FULL;
+
+                procfs_batch_use(report->batch);
+                load_trigger_metrics(report->pid, &report->memory_data, report->statm_rss, report->capture_time, &trigger_metrics);
+                procfs_batch_use(NULL);
+
+                report->trigger_rule = evaluate_trigger_rules(&trigger_metrics, &trigger_sections);
+                if (report->trigger_rule >= 0) {
+                    report->status = REPORT_FULL;
+
+                    if (!threshold_reached) {
+                        report->sections = trigger_sections;
+                    }
+                } else if (!threshold_reached) {
+                    report->status = REPORT_BELOW_THRESHOLD;
+                }
+            }
+        }
+
+        submit_report(report);
+
+        if (count > 0) {
+            --count;
+        }
+    }
+
+    stop_report_renderer();
+    close_replay_archive();
+
+    free_netns_cache();
+    free_vma_history();
+    procfs_cleanup();
+}
+
 int main(int argc, char *argv[]) {
-    pid_t pid;
+    pid_t pid = 0;
     char exename[PATH_MAX];
-    long int memory_pressure_threshold;
-    long int interval;
+    struct exe_identity exe_identity;
+    int discovery_waiting = 0;
+    long int memory_pressure_threshold = 0;
+    long int interval = 0;
     long int count = -1;
-
-    struct meminfo memory_data;
+    long int pagemap_stride = PAGEMAP_DEFAULT_STRIDE;
+    long int pagemap_budget = PAGEMAP_DEFAULT_BUDGET;
+    long int heavy_cycles = 0;
+    long int top_growing_count = 0;
+    long int top_consumers_count = 0;
+    long int heavy_cycles_elapsed = 0;
+    char *archive_path = NULL;
+    long int sched_fifo_priority = 0;
+    long int nice_value = 0;
+    char *cpu_list = NULL;
+    long int sched_latency = 0;
+    struct timespec next_wakeup;
+    enum writer_policy output_policy = WRITER_BLOCK;
+    enum mapping_report_mode mapping_mode = MAPPING_REPORT_FULL;
+    char *dump_directory = NULL;
+    long int dump_budget = DUMP_DEFAULT_BUDGET;
+    long int threads_budget = THREAD_CENSUS_DEFAULT_BUDGET;
+    long int tree_refresh = PROCESS_TREE_DEFAULT_REFRESH;
+    int dump_armed = 1;
+    int pressure_reached = 0;
+    int threshold_reached = 0;
+    struct trigger_metrics trigger_metrics;
+    unsigned int trigger_sections;
+    char *shm_stats_name = NULL;
+    char *trend_path = NULL;
+
+    struct report *report;
+    struct report_config report_config;
+    struct timespec capture_start_time;
 
     int ret_check_pid;
     int ret_compare_pid_exe;
     int ret_get_system_memory;
-    int ret_get_memory_usage;
-    int ret_get_page_tables_usage;
-    int ret_get_oom_score;
+    int ret_get_statm_rss;
+    int ret_set_cpu_affinity;
+    int ret_get_cgroup_events = 0;
+    long int pressure_usage;
+    long int pressure_limit;
+    int pressure_node;
 
     /* suppress default getopt error messages */
     opterr = 0;
@@ -120,7 +357,10 @@ int main(int argc, char *argv[]) {
                 opt_flag_p = 1;
                 break;
             case 'e':
-                strncpy(exename, optarg, strlen(optarg) + 1);
+                if (snprintf(exename, sizeof(exename), "%s", optarg) >= (int)sizeof(exename)) {
+                    fprintf(stderr, "ERROR: full path of target process is too long\n\n");
+                    exit(EXIT_FAILURE);
+                }
                 opt_flag_e = 1;
                 break;
             case 'm':
@@ -180,6 +420,236 @@ int main(int argc, char *argv[]) {
             case 'l':
                 opt_flag_l = 1;
                 break;
+            case 'g':
+                opt_flag_g = 1;
+                break;
+            case 't':
+                errno = 0;
+                top_growing_count = strtol(optarg, NULL, 10);
+
+                if (errno != 0) {
+                    fprintf(stderr, "ERROR: failed to covert top growing mappings count value\n\n");
+                    exit(EXIT_FAILURE);
+                }
+
+                if (top_growing_count <= 0) {
+                    fprintf(stderr, "ERROR: top growing mappings count must be an integer and greater than 0\n\n");
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                opt_flag_t = 1;
+                break;
+            case OPT_PAGEMAP_STRIDE:
+                errno = 0;
+                pagemap_stride = strtol(optarg, NULL, 10);
+
+                if (errno != 0) {
+                    fprintf(stderr, "ERROR: failed to covert pagemap stride value\n\n");
+                    exit(EXIT_FAILURE);
+                }
+
+                if (pagemap_stride <= 0) {
+                    fprintf(stderr, "ERROR: pagemap stride must be an integer and greater than 0\n\n");
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_PAGEMAP_BUDGET:
+                errno = 0;
+                pagemap_budget = strtol(optarg, NULL, 10);
+
+                if (errno != 0) {
+                    fprintf(stderr, "ERROR: failed to covert pagemap budget value\n\n");
+                    exit(EXIT_FAILURE);
+                }
+
+                if (pagemap_budget <= 0) {
+                    fprintf(stderr, "ERROR: pagemap budget must be an integer and greater than 0\n\n");
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_HEAVY_CYCLES:
+                errno = 0;
+                heavy_cycles = strtol(optarg, NULL, 10);
+
+                if (errno != 0) {
+                    fprintf(stderr, "ERROR: failed to covert heavy cycles value\n\n");
+                    exit(EXIT_FAILURE);
+                }
+
+                if (heavy_cycles <= 0) {
+                    fprintf(stderr, "ERROR: heavy cycles must be an integer and greater than 0\n\n");
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_NO_IO_URING:
+                opt_flag_no_io_uring = 1;
+                break;
+            case OPT_IO_STATS:
+                opt_flag_io_stats = 1;
+                break;
+            case OPT_ARCHIVE:
+                archive_path = optarg;
+                opt_flag_archive = 1;
+                break;
+            case OPT_REPLAY:
+                archive_path = optarg;
+                opt_flag_replay = 1;
+                break;
+            case OPT_SCHED_FIFO:
+                errno = 0;
+                sched_fifo_priority = strtol(optarg, NULL, 10);
+
+                if (errno != 0) {
+                    fprintf(stderr, "ERROR: failed to covert SCHED_FIFO priority value\n\n");
+                    exit(EXIT_FAILURE);
+                }
+
+                if (sched_fifo_priority < sched_get_priority_min(SCHED_FIFO) || sched_fifo_priority > sched_get_priority_max(SCHED_FIFO)) {
+                    fprintf(stderr, "ERROR: SCHED_FIFO priority must be an integer and the range should be [%d,%d]\n\n", sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO));
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                opt_flag_sched_fifo = 1;
+                break;
+            case OPT_NICE:
+                errno = 0;
+                nice_value = strtol(optarg, NULL, 10);
+
+                if (errno != 0) {
+                    fprintf(stderr, "ERROR: failed to covert nice value\n\n");
+                    exit(EXIT_FAILURE);
+                }
+
+                if (nice_value < -20 || nice_value > 19) {
+                    fprintf(stderr, "ERROR: nice value must be an integer and the range should be [-20,19]\n\n");
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                opt_flag_nice = 1;
+                break;
+            case OPT_CPU_AFFINITY:
+                cpu_list = optarg;
+                break;
+            case OPT_OOM_PROTECT:
+                opt_flag_oom_protect = 1;
+                break;
+            case OPT_OUTPUT_POLICY:
+                if (parse_writer_policy(optarg, &output_policy) < 0) {
+                    fprintf(stderr, "ERROR: output policy must be one of block, drop-oldest and drop-detail\n\n");
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_SHM_STATS:
+                shm_stats_name = optarg;
+                break;
+            case OPT_CGROUP:
+                opt_flag_cgroup = 1;
+                break;
+            case OPT_TOP_CONSUMERS:
+                errno = 0;
+                top_consumers_count = strtol(optarg, NULL, 10);
+
+                if (errno != 0) {
+                    fprintf(stderr, "ERROR: failed to covert top consumers count value\n\n");
+                    exit(EXIT_FAILURE);
+                }
+
+                if (top_consumers_count <= 0 || top_consumers_count > TOPMEM_MAX_COUNT) {
+                    fprintf(stderr, "ERROR: top consumers count must be an integer and the range should be [1,%d]\n\n", TOPMEM_MAX_COUNT);
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                opt_flag_top_consumers = 1;
+                break;
+            case OPT_TREND:
+                trend_path = optarg;
+                break;
+            case OPT_NUMA:
+                opt_flag_numa = 1;
+                break;
+            case OPT_NUMA_THRESHOLD:
+                opt_flag_numa_threshold = 1;
+                break;
+            case OPT_MAPPINGS:
+                if (strcmp(optarg, "full") == 0) {
+                    mapping_mode = MAPPING_REPORT_FULL;
+                } else if (strcmp(optarg, "summary") == 0) {
+                    mapping_mode = MAPPING_REPORT_SUMMARY;
+                } else if (strcmp(optarg, "both") == 0) {
+                    mapping_mode = MAPPING_REPORT_BOTH;
+                } else {
+                    fprintf(stderr, "ERROR: mappings mode must be one of full, summary and both\n\n");
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_VMSTAT:
+                opt_flag_vmstat = 1;
+                break;
+            case OPT_THREADS:
+                opt_flag_threads = 1;
+                break;
+            case OPT_THREADS_BUDGET:
+                errno = 0;
+                threads_budget = strtol(optarg, NULL, 10);
+
+                if (errno != 0) {
+                    fprintf(stderr, "ERROR: failed to covert threads budget value\n\n");
+                    exit(EXIT_FAILURE);
+                }
+
+                if (threads_budget <= 0 || threads_budget > 4194304) {
+                    fprintf(stderr, "ERROR: threads budget must be an integer and the range should be [1,4194304]\n\n");
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_DUMP:
+                dump_directory = optarg;
+                break;
+            case OPT_TREE_REFRESH:
+                errno = 0;
+                tree_refresh = strtol(optarg, NULL, 10);
+
+                if (errno != 0) {
+                    fprintf(stderr, "ERROR: failed to covert process tree refresh value\n\n");
+                    exit(EXIT_FAILURE);
+                }
+
+                if (tree_refresh <= 0 || tree_refresh > 3600) {
+                    fprintf(stderr, "ERROR: process tree refresh must be an integer and the range should be [1,3600]\n\n");
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_TRIGGER:
+                /* the rule is compiled once here, each cycle only runs its code */
+                if (add_trigger_rule(optarg) < 0) {
+                    fprintf(stderr, "\n");
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                opt_flag_trigger = 1;
+                break;
+            case OPT_DUMP_BUDGET:
+                errno = 0;
+                dump_budget = strtol(optarg, NULL, 10);
+
+                if (errno != 0) {
+                    fprintf(stderr, "ERROR: failed to covert dump budget value\n\n");
+                    exit(EXIT_FAILURE);
+                }
+
+                if (dump_budget <= 0 || dump_budget > 1048576) {
+                    fprintf(stderr, "ERROR: dump budget must be an integer and the range should be [1,1048576]\n\n");
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                break;
             case '?':
                 fprintf(stderr, "ERROR: Unknown option\n\n");
                 usage();
@@ -191,12 +661,133 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    /* check if necessary options are specified */
-    if (!opt_flag_p || !opt_flag_e || !opt_flag_i) {
+    if (opt_flag_sched_fifo && opt_flag_nice) {
+        fprintf(stderr, "ERROR: --sched-fifo and --nice cannot be used together\n\n");
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    if (opt_flag_archive && opt_flag_replay) {
+        fprintf(stderr, "ERROR: --archive and --replay cannot be used together\n\n");
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    /* the heavy tiers run in every cycle without a threshold, a cadence only applies below it */
+    if (heavy_cycles > 0 && !opt_flag_m && !opt_flag_trigger) {
+        fprintf(stderr, "ERROR: --heavy-cycles requires a memory pressure threshold or a trigger rule\n\n");
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    if (dump_directory != NULL && !opt_flag_m && !opt_flag_trigger) {
+        fprintf(stderr, "ERROR: --dump requires a memory pressure threshold or a trigger rule\n\n");
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    if (opt_flag_numa_threshold && !opt_flag_m) {
+        fprintf(stderr, "ERROR: --numa-threshold requires a memory pressure threshold\n\n");
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    if (opt_flag_numa_threshold && opt_flag_cgroup) {
+        fprintf(stderr, "ERROR: --numa-threshold and --cgroup cannot be used together\n\n");
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    /* report sections, they are rendered on a lower-priority thread while the next cycle is captured */
+    report_config.mapping_mode = mapping_mode;
+    report_config.top_growing = opt_flag_t;
+    report_config.top_growing_count = top_growing_count;
+    report_config.pagemap = opt_flag_g;
+    report_config.pagemap_stride = pagemap_stride;
+    report_config.pagemap_budget = pagemap_budget;
+    report_config.io_stats = opt_flag_io_stats;
+    report_config.cgroup = opt_flag_cgroup;
+    report_config.numa = opt_flag_numa || opt_flag_numa_threshold;
+    report_config.top_consumers = opt_flag_top_consumers;
+    report_config.top_consumers_count = top_consumers_count;
+    report_config.vmstat = opt_flag_vmstat;
+    report_config.threads = opt_flag_threads;
+    report_config.threads_budget = threads_budget;
+    report_config.output_policy = output_policy;
+
+    /* the ancestor chain is walked by the render thread, the cadence is set before it starts */
+    set_process_tree_refresh(tree_refresh);
+
+    /* replay mode does not need a live process */
+    if (opt_flag_replay) {
+        if (opt_flag_g) {
+            fprintf(stderr, "WARNING: pagemap is not archived, --pagemap is ignored in replay mode\n");
+            report_config.pagemap = 0;
+        }
+
+        if (opt_flag_cgroup) {
+            fprintf(stderr, "WARNING: cgroup files are not archived, --cgroup is ignored in replay mode\n");
+            report_config.cgroup = 0;
+        }
+
+        if (opt_flag_top_consumers) {
+            fprintf(stderr, "WARNING: other processes are not archived, --top-consumers is ignored in replay mode\n");
+            report_config.top_consumers = 0;
+        }
+
+        if (opt_flag_vmstat) {
+            fprintf(stderr, "WARNING: /proc/vmstat is not archived, --vmstat is ignored in replay mode\n");
+            report_config.vmstat = 0;
+        }
+
+        if (opt_flag_threads) {
+            fprintf(stderr, "WARNING: threads are not archived, --threads is ignored in replay mode\n");
+            report_config.threads = 0;
+        }
+
+        if (dump_directory != NULL) {
+            fprintf(stderr, "WARNING: the archived process is not running, --dump is ignored in replay mode\n");
+        }
+
+        if (signal(SIGINT, sigint_handler) == SIG_ERR) {
+            fprintf(stderr, "ERROR: failed to register SIGINT signal handler\n");
+            exit(EXIT_FAILURE);
+        }
+
+        if (shm_stats_name != NULL && open_shm_stats(shm_stats_name) < 0) {
+            exit(EXIT_FAILURE);
+        }
+
+        /* a trend of an archive is built from the archived report times */
+        if (trend_path != NULL && init_trend_store() < 0) {
+            close_shm_stats();
+            exit(EXIT_FAILURE);
+        }
+
+        replay_archive(archive_path, memory_pressure_threshold, count, &report_config);
+
+        close_shm_stats();
+
+        if (trend_path != NULL) {
+            dump_trend_store(trend_path);
+            free_trend_store();
+        }
+
+        exit(EXIT_SUCCESS);
+    }
+
+    /* check if necessary options are specified, the PID is discovered from the executable if it is omitted */
+    if (!opt_flag_e || !opt_flag_i) {
         usage();
         exit(EXIT_FAILURE);
     }
 
+    /* processes are matched by the device and inode of their executable instead of resolving paths */
+    if (get_exe_identity(exename, &exe_identity) < 0) {
+        fprintf(stderr, "ERROR: failed to get the executable file information of %s: %s\n\n", exename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
     /* check if lock memory option is specified, if yes then triggering mlockall() */
     if (opt_flag_l) {
         ret_mlockall = mlockall(MCL_CURRENT | MCL_FUTURE);
@@ -206,15 +797,85 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    /* set up io_uring for batched procfs reads, blocking reads are used if it is not available */
+    procfs_init(!opt_flag_no_io_uring);
+
+    /* raw procfs bytes of each cycle are appended to the archive */
+    if (opt_flag_archive && open_archive(archive_path) < 0) {
+        unlock_memory();
+        exit(EXIT_FAILURE);
+    }
+
+    /* the latest values are published for local readers, which map the segment without syscalls */
+    if (shm_stats_name != NULL && open_shm_stats(shm_stats_name) < 0) {
+        close_archive();
+        unlock_memory();
+        exit(EXIT_FAILURE);
+    }
+
+    /* downsampled values are kept in fixed-size tiers and written out when memdoor exits */
+    if (trend_path != NULL && init_trend_store() < 0) {
+        close_archive();
+        close_shm_stats();
+        unlock_memory();
+        exit(EXIT_FAILURE);
+    }
+
+    /* the dump buffer is allocated and touched now, a dump is taken when the target is already under pressure */
+    if (dump_directory != NULL && init_memory_dump(dump_directory, dump_budget) < 0) {
+        close_archive();
+        close_shm_stats();
+        free_trend_store();
+        unlock_memory();
+        exit(EXIT_FAILURE);
+    }
+
     /* install SIGINT signal handler */
     if (signal(SIGINT, sigint_handler) == SIG_ERR) {
         fprintf(stderr, "ERROR: failed to register SIGINT signal handler\n");
 
+        close_shm_stats();
+        unlock_memory();
+
+        exit(EXIT_FAILURE);
+    }
+
+    /* keep sampling under memory pressure: CPU placement first, so that the render thread inherits it */
+    if (cpu_list != NULL) {
+        ret_set_cpu_affinity = set_cpu_affinity(cpu_list);
+        if (ret_set_cpu_affinity < 0) {
+            if (ret_set_cpu_affinity == -1) {
+                fprintf(stderr, "ERROR: invalid CPU list %s\n\n", cpu_list);
+            }
+
+            close_archive();
+            close_shm_stats();
+            unlock_memory();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* a nice value is inherited by the render thread, which runs REPORT_RENDER_NICE lower */
+    if ((opt_flag_nice && set_nice(nice_value) < 0) || (opt_flag_oom_protect && protect_from_oom() < 0)) {
+        close_archive();
+        close_shm_stats();
         unlock_memory();
+        exit(EXIT_FAILURE);
+    }
 
+    start_report_renderer(&report_config);
+
+    /* SCHED_FIFO is set on the capture thread only, after the render thread is created with SCHED_OTHER */
+    if (opt_flag_sched_fifo && set_sched_fifo(sched_fifo_priority) < 0) {
+        stop_report_renderer();
+        close_archive();
+        close_shm_stats();
+        unlock_memory();
         exit(EXIT_FAILURE);
     }
 
+    clock_gettime(CLOCK_MONOTONIC, &next_wakeup);
+
     while (1) {
         /* exit the loop once SIGINT is captured */
         if (sigint_flag == 1) {
@@ -228,34 +889,70 @@ int main(int argc, char *argv[]) {
             break;
         }
 
-        /* print timestamp */
-        print_current_time();
+        /* without -p, the target is discovered by its executable and attached again once it is restarted */
+        if (!opt_flag_p && (pid == 0 || check_pid(pid) != 0 || compare_pid_exe(pid, &exe_identity) < 0)) {
+            if (pid != 0) {
+                fprintf(stderr, "WARNING: PID %d of %s exited, waiting for it to restart\n", pid, exename);
+                discovery_waiting = 1;
+            }
 
-        /* check if PID exists and have permission to read information */
-        ret_check_pid = check_pid(pid);
-        if (ret_check_pid != 0) {
-            fprintf(stderr, "ERROR: PID %d is not accessible: %s\n", pid, strerror(ret_check_pid));
-            exit(EXIT_FAILURE);
-        }
+            /* the executable may have been replaced by an upgrade before the restart */
+            get_exe_identity(exename, &exe_identity);
 
-        /* check if PID matches the input executable absolute path */
-        ret_compare_pid_exe = compare_pid_exe(pid, exename);
-        if (ret_compare_pid_exe < 0) {
-            fprintf(stderr, "ERROR: PID %d does not match the executable name %s\n", pid, exename);
-            exit(EXIT_FAILURE);
+            pid = find_pid_by_exe(&exe_identity);
+            if (pid <= 0) {
+                if (!discovery_waiting) {
+                    fprintf(stderr, "WARNING: no process of %s is running, waiting for it to start\n", exename);
+                    discovery_waiting = 1;
+                }
+
+                pid = 0;
+                sched_latency = sleep_until_next_cycle(&next_wakeup, interval);
+                continue;
+            }
+
+            discovery_waiting = 0;
         }
 
-        /* print process basic information */
-        fprintf(stdout, "%s\n", PROCESS_BASIC_INFO_BANNER);
-        fprintf(stdout, "PID: %d\n", pid);
-        fprintf(stdout, "Executable Absolute Path: %s\n\n", exename);
-        fflush(stdout);
+        /* wait for a free report slot, its batch buffers are reused */
+        report = acquire_report();
+        report->report_time = time(NULL);
+        report->pid = pid;
+        strcpy(report->exename, exename);
+        report->sched_latency = sched_latency;
+
+        clock_gettime(CLOCK_MONOTONIC, &capture_start_time);
+
+        /* a PID given with -p must stay the same process, a discovered PID has been checked before acquiring the slot */
+        if (opt_flag_p) {
+            /* check if PID exists and have permission to read information */
+            ret_check_pid = check_pid(pid);
+            if (ret_check_pid != 0) {
+                fprintf(stderr, "ERROR: PID %d is not accessible: %s\n", pid, strerror(ret_check_pid));
+                stop_report_renderer();
+                close_archive();
+                close_shm_stats();
+                exit(EXIT_FAILURE);
+            }
+
+            /* check if PID runs the input executable file */
+            ret_compare_pid_exe = compare_pid_exe(pid, &exe_identity);
+            if (ret_compare_pid_exe < 0) {
+                fprintf(stderr, "ERROR: PID %d does not match the executable name %s\n", pid, exename);
+                stop_report_renderer();
+                close_archive();
+                close_shm_stats();
+                exit(EXIT_FAILURE);
+            }
+        }
 
         /* check if process memory usage is equal or greater than input memory pressure threshold */
-        ret_get_system_memory = get_system_memory(&memory_data.total_memory);
+        ret_get_system_memory = get_system_memory(&report->memory_data.total_memory);
         if (ret_get_system_memory < 0) {
             fprintf(stderr, "ERROR: failed to get system memory information\n\n");
-            sleep(interval);
+            report->capture_window = get_elapsed_microseconds(&capture_start_time);
+            submit_report(report);
+            sched_latency = sleep_until_next_cycle(&next_wakeup, interval);
 
             if (count > 0) {
                 --count;
@@ -264,37 +961,57 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
-        /* get process memory usage */
-        ret_get_memory_usage = get_memory_usage(pid, &memory_data.process_rss, &memory_data.process_pss, &memory_data.process_uss);
-        if (ret_get_memory_usage < 0) {
-            fprintf(stderr, "ERROR: failed to get process memory usage information\n\n");
-            sleep(interval);
+        /* cgroup mode: the pressure is evaluated against memory.max of the cgroup, whose limit triggers the OOM killer */
+        if (opt_flag_cgroup) {
+            if (resolve_cgroup(pid, report->cgroup_data.path, sizeof(report->cgroup_data.path)) < 0 || get_cgroup_memory(&report->cgroup_data, report->memory_data.total_memory) < 0) {
+                fprintf(stderr, "ERROR: failed to get cgroup v2 memory information of PID %d\n\n", pid);
+                report->capture_window = get_elapsed_microseconds(&capture_start_time);
+                submit_report(report);
+                sched_latency = sleep_until_next_cycle(&next_wakeup, interval);
 
-            if (count > 0) {
-                --count;
+                if (count > 0) {
+                    --count;
+                }
+
+                continue;
             }
 
-            continue;
+            ret_get_cgroup_events = get_cgroup_events(&report->cgroup_data);
+            if (ret_get_cgroup_events < 0) {
+                fprintf(stderr, "WARNING: failed to get cgroup memory events of %s\n", report->cgroup_data.path);
+            }
         }
 
-        /* get process page tables usage */
-        ret_get_page_tables_usage = get_page_tables_usage(pid, &memory_data.process_page_tables_size);
-        if (ret_get_page_tables_usage < 0) {
-            fprintf(stderr, "ERROR: failed to get process page tables usage information\n\n");
-            sleep(interval);
+        /* the system-wide counters are read in every cycle, so that the deltas of a full report cover one interval */
+        if (opt_flag_vmstat && get_vmstat_activity(&report->vmstat_data) < 0) {
+            fprintf(stderr, "WARNING: failed to get system memory activity from %s\n", VMSTAT_PATH);
+        }
 
-            if (count > 0) {
-                --count;
-            }
+        /* NUMA mode: the pressure is evaluated on each node, a process bound to one node exhausts it while the system memory looks fine */
+        if (opt_flag_numa_threshold) {
+            if (get_numa_memory(pid, &report->numa_data) < 0 || get_numa_pressure(&report->numa_data, &pressure_node) < 0) {
+                fprintf(stderr, "ERROR: failed to get NUMA memory information of PID %d\n\n", pid);
+                report->numa_data.loaded = 0;
+                report->capture_window = get_elapsed_microseconds(&capture_start_time);
+                submit_report(report);
+                sched_latency = sleep_until_next_cycle(&next_wakeup, interval);
 
-            continue;
+                if (count > 0) {
+                    --count;
+                }
+
+                continue;
+            }
         }
 
-        if (opt_flag_m == 1) {
-            if ((int)((float)memory_data.process_rss / (float)memory_data.total_memory * 100) < memory_pressure_threshold) {
-                fprintf(stdout, "Process memory usage is not equal to or greater than input memory pressure threshold\n\n");
-                fflush(stdout);
-                sleep(interval);
+        /* fast tier: evaluate the memory pressure threshold with /proc/pid/statm only, an archive keeps it for replays with another threshold */
+        if ((opt_flag_m == 1 && !opt_flag_cgroup && !opt_flag_numa_threshold) || opt_flag_archive || (get_trigger_sources() & TRIGGER_SOURCE_STATM)) {
+            ret_get_statm_rss = get_statm_rss(pid, &report->statm_rss);
+            if (ret_get_statm_rss < 0) {
+                fprintf(stderr, "ERROR: failed to get process statm memory usage information\n\n");
+                report->capture_window = get_elapsed_microseconds(&capture_start_time);
+                submit_report(report);
+                sched_latency = sleep_until_next_cycle(&next_wakeup, interval);
 
                 if (count > 0) {
                     --count;
@@ -302,67 +1019,121 @@ int main(int argc, char *argv[]) {
 
                 continue;
             }
+
         }
 
-        /* print process memory and page tables usage information */
-        fprintf(stdout, "%s\n", PROCESS_MEMORY_INFO_BANNER);
-        fflush(stdout);
+        if (opt_flag_m == 1 || opt_flag_trigger) {
+            ++heavy_cycles_elapsed;
+            threshold_reached = 0;
+
+            if (opt_flag_m == 1) {
+                if (opt_flag_cgroup) {
+                    pressure_usage = report->cgroup_data.current;
+                    pressure_limit = report->cgroup_data.limit;
+                } else if (opt_flag_numa_threshold) {
+                    pressure_usage = report->numa_data.nodes[pressure_node].total - report->numa_data.nodes[pressure_node].free;
+                    pressure_limit = report->numa_data.nodes[pressure_node].total;
+                } else {
+                    pressure_usage = report->statm_rss;
+                    pressure_limit = report->memory_data.total_memory;
+                }
 
-        fprintf(stdout, "Total System Memory: %ld kB\n", memory_data.total_memory);
-        fprintf(stdout, "Process RSS Memory Usage: %ld kB\n", memory_data.process_rss);
-        fprintf(stdout, "Process PSS Memory Usage: %ld kB\n", memory_data.process_pss);
-        fprintf(stdout, "Process USS Memory Usage: %ld kB\n", memory_data.process_uss);
-        fprintf(stdout, "Process Page Tables Usage: %ld kB\n", memory_data.process_page_tables_size);
-        fflush(stdout);
+                threshold_reached = (int)((float)pressure_usage / (float)pressure_limit * 100) >= memory_pressure_threshold || ret_get_cgroup_events == 1;
+            }
 
-        ret_get_oom_score = get_oom_score(pid, &memory_data.process_oom_score, &memory_data.process_oom_score_adj);
-        if (ret_get_oom_score < 0) {
-            fprintf(stderr, "WARNING: failed to get process OOM score\n");
-        } else {
-            fprintf(stdout, "Process OOM Score: %d\n", memory_data.process_oom_score);
-            fprintf(stdout, "Process OOM Score Adjustment Value: %d\n", memory_data.process_oom_score_adj);
-            fflush(stdout);
-        }
+            /* the rules only read the files of the metrics they refer to, a met rule selects the sections to render */
+            if (opt_flag_trigger) {
+                load_trigger_metrics(pid, &report->memory_data, report->statm_rss, get_monotonic_time(), &trigger_metrics);
 
-        fprintf(stdout, "\n");
-        fflush(stdout);
+                report->trigger_rule = evaluate_trigger_rules(&trigger_metrics, &trigger_sections);
+                if (report->trigger_rule >= 0 && !threshold_reached) {
+                    report->sections = trigger_sections;
+                }
+            }
 
-        /* print process tree information */
-        fprintf(stdout, "%s\n", PROCESS_TREE_INFO_BANNER);
-        fflush(stdout);
+            pressure_reached = threshold_reached || report->trigger_rule >= 0;
 
-        get_process_tree(pid);
+            /* the dump is taken once each time the threshold is crossed or a rule is met */
+            if (!pressure_reached) {
+                dump_armed = 1;
+            }
 
-        fprintf(stdout, "\n");
-        fflush(stdout);
+            /* heavy tiers still run on their own slower cadence if it is specified, and when the cgroup hits memory.max or OOM */
+            if (!pressure_reached && (heavy_cycles == 0 || heavy_cycles_elapsed < heavy_cycles)) {
+                report->status = REPORT_BELOW_THRESHOLD;
 
-        /* print process memory mapping information */
-        fprintf(stdout, "%s\n", PROCESS_MEMORY_MAPPING_INFO_BANNER);
-        fflush(stdout);
+                /* an archive still captures the heavy tiers, so that they can be replayed with a lower threshold */
+                if (!opt_flag_archive) {
+                    report->capture_window = get_elapsed_microseconds(&capture_start_time);
+                    submit_report(report);
+                    sched_latency = sleep_until_next_cycle(&next_wakeup, interval);
 
-        get_memory_mapping(pid);
+                    if (count > 0) {
+                        --count;
+                    }
 
-        fprintf(stdout, "\n");
-        fflush(stdout);
-        
-        /* print process network connection information */
-        fprintf(stdout, "%s\n", PROCESS_NETWORK_CONNECTION_INFO_BANNER);
-        fflush(stdout);
+                    continue;
+                }
+            } else {
+                heavy_cycles_elapsed = 0;
+            }
+        }
 
-        get_network_connection(pid);
+        /* heavy tiers: smaps_rollup, status, tree, maps, fds and network are captured in one batch */
+        procfs_batch_begin(report->batch);
+        add_process_batch_files(report->batch, pid);
+        if (opt_flag_t || opt_flag_archive) {
+            add_vma_history_batch_files(report->batch, pid);
+        }
+        add_netns_batch_files(report->batch, pid);
+        if (opt_flag_cgroup) {
+            add_cgroup_batch_files(report->batch, report->cgroup_data.path);
+        }
+        /* numa_maps walks the page tables, it is not read again if the threshold check has parsed it, unless it is archived */
+        if ((opt_flag_numa || opt_flag_numa_threshold) && (!report->numa_data.loaded || opt_flag_archive)) {
+            add_numa_batch_files(report->batch, pid);
+        }
+        procfs_batch_submit(report->batch, &report->procfs_stats);
 
-        fprintf(stdout, "\n");
-        fflush(stdout);
+        report->capture_window = get_elapsed_microseconds(&capture_start_time);
+        report->capture_time = get_monotonic_time();
 
-        sleep(interval);            
-        fprintf(stdout, "\n");
-        fflush(stdout);
+        /* the memory is read right after the batch, it is not part of the capture window */
+        if (dump_directory != NULL && pressure_reached && dump_armed) {
+            dump_anonymous_memory(pid, report->report_time, &report->dump_data);
+            dump_armed = 0;
+        }
+
+        if (report->status == REPORT_BASIC) {
+            report->status = REPORT_FULL;
+        }
+
+        submit_report(report);
+
+        sched_latency = sleep_until_next_cycle(&next_wakeup, interval);
 
         if (count > 0) {
             --count;
         }
     }
 
+    stop_report_renderer();
+    close_archive();
+    close_shm_stats();
+
+    free_netns_cache();
+    free_vma_history();
+    free_cgroup_watch();
+    free_top_memory_consumers();
+    free_memory_dump();
+    free_trigger_rules();
+    procfs_cleanup();
+
+    if (trend_path != NULL) {
+        dump_trend_store(trend_path);
+        free_trend_store();
+    }
+
     unlock_memory();
 
     exit(EXIT_SUCCESS);
@@ -1,9 +1,25 @@
+#define _GNU_SOURCE
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 #include <arpa/inet.h>
+#include <netinet/in.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include <linux/inet_diag.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/sock_diag.h>
+#include "procfs.h"
 #include "network.h"
 
 static char *tcp_state[] =
@@ -22,6 +38,20 @@ static char *tcp_state[] =
     "CLOSING"
 };
 
+/* protocols cached per network namespace, the index is shared with netns_cache.netstat[] */
+static char *netns_protocols[NETNS_PROTOCOL_COUNT] = {"tcp", "udp", "tcp6", "udp6"};
+
+/* parsed network tables of each network namespace seen in the current cycle */
+static struct netns_cache netns_cache[NETNS_CACHE_SIZE];
+static unsigned long netns_cache_generation = 1;
+static struct netstat_parse_stats netstat_parse_stats;
+
+/* sock_diag netlink socket created in the network namespace of the target, used by the render thread only */
+static int sock_diag_fd = -1;
+static dev_t sock_diag_netns_dev = 0;
+static ino_t sock_diag_netns_inode = 0;
+static int sock_diag_netns_failed = 0; /* the socket cannot be created in this namespace, e.g. without CAP_SYS_ADMIN */
+
 void free_netstat(struct netstat *input_netstat) {
     struct netstat *current = input_netstat;
     struct netstat *next;
@@ -34,176 +64,534 @@ void free_netstat(struct netstat *input_netstat) {
     }
 }
 
-struct netstat *load_netstat(char *protocol) {
-    char proc_netstat_filename[PATH_MAX];
+/* decode 8 hex digits into the value printed with %08X, returns -1 if one of them is not a hex digit */
+static int decode_hex32_scalar(const char *hex, uint32_t *value) {
+    uint32_t result = 0;
+    unsigned char c;
+    int i;
+
+    for (i = 0; i < 8; ++i) {
+        c = (unsigned char)hex[i];
+
+        if (c >= '0' && c <= '9') {
+            c -= '0';
+        } else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+            c = (c | 0x20) - 'a' + 10;
+        } else {
+            return -1;
+        }
+
+        result = (result << 4) | c;
+    }
+
+    *value = result;
+
+    return 0;
+}
+
+static int decode_hex128_scalar(const char *hex, uint32_t words[4]) {
+    int i;
+
+    for (i = 0; i < 4; ++i) {
+        if (decode_hex32_scalar(hex + i * 8, &words[i]) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+#if defined(__SSE2__)
+/*
+ * nibble conversion of 16 hex digits at once: digits and letters are mapped to their values in every byte lane,
+ * then the lanes of each 16-bit pair are merged into one byte, most significant digit first
+ */
+static inline int decode_hex_nibbles_sse2(__m128i digits, __m128i *bytes) {
+    __m128i digit_values = _mm_sub_epi8(digits, _mm_set1_epi8('0'));
+    __m128i letter_values = _mm_sub_epi8(_mm_or_si128(digits, _mm_set1_epi8(0x20)), _mm_set1_epi8('a' - 10));
+    __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(digit_values, _mm_set1_epi8(-1)), _mm_cmplt_epi8(digit_values, _mm_set1_epi8(10)));
+    __m128i is_letter = _mm_and_si128(_mm_cmpgt_epi8(letter_values, _mm_set1_epi8(9)), _mm_cmplt_epi8(letter_values, _mm_set1_epi8(16)));
+    __m128i nibbles = _mm_or_si128(_mm_and_si128(is_digit, digit_values), _mm_and_si128(is_letter, letter_values));
+
+    if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_letter)) != 0xffff) {
+        return -1;
+    }
+
+    /* each 16-bit lane holds (high digit, low digit) */
+    nibbles = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(nibbles, 4), _mm_set1_epi16(0x00f0)), _mm_srli_epi16(nibbles, 8));
+    *bytes = _mm_packus_epi16(nibbles, nibbles);
+
+    return 0;
+}
+
+static int decode_hex32_sse2(const char *hex, uint32_t *value) {
+    __m128i bytes;
+    uint32_t packed;
+
+    /* the upper half of the register is filled with '0' so that it passes the check */
+    if (decode_hex_nibbles_sse2(_mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)hex), _mm_set1_epi8('0')), &bytes) < 0) {
+        return -1;
+    }
+
+    packed = (uint32_t)_mm_cvtsi128_si32(bytes);
+    *value = __builtin_bswap32(packed);
+
+    return 0;
+}
+
+/* 32 hex digits of an IPv6 address, printed as 4 * %08X of its 32-bit words */
+static int decode_hex128_sse2(const char *hex, uint32_t words[4]) {
+    __m128i low_bytes;
+    __m128i high_bytes;
+    uint64_t packed;
+
+    if (decode_hex_nibbles_sse2(_mm_loadu_si128((const __m128i *)hex), &low_bytes) < 0 || decode_hex_nibbles_sse2(_mm_loadu_si128((const __m128i *)(hex + 16)), &high_bytes) < 0) {
+        return -1;
+    }
+
+    packed = (uint64_t)_mm_cvtsi128_si64(low_bytes);
+    words[0] = __builtin_bswap32((uint32_t)packed);
+    words[1] = __builtin_bswap32((uint32_t)(packed >> 32));
+
+    packed = (uint64_t)_mm_cvtsi128_si64(high_bytes);
+    words[2] = __builtin_bswap32((uint32_t)packed);
+    words[3] = __builtin_bswap32((uint32_t)(packed >> 32));
+
+    return 0;
+}
+
+/* the same conversion over the 32 digits in one AVX2 register, selected at runtime */
+__attribute__((target("avx2"))) static int decode_hex128_avx2(const char *hex, uint32_t words[4]) {
+    __m256i digits = _mm256_loadu_si256((const __m256i *)hex);
+    __m256i digit_values = _mm256_sub_epi8(digits, _mm256_set1_epi8('0'));
+    __m256i letter_values = _mm256_sub_epi8(_mm256_or_si256(digits, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a' - 10));
+    __m256i is_digit = _mm256_and_si256(_mm256_cmpgt_epi8(digit_values, _mm256_set1_epi8(-1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(10), digit_values));
+    __m256i is_letter = _mm256_and_si256(_mm256_cmpgt_epi8(letter_values, _mm256_set1_epi8(9)), _mm256_cmpgt_epi8(_mm256_set1_epi8(16), letter_values));
+    __m256i nibbles = _mm256_or_si256(_mm256_and_si256(is_digit, digit_values), _mm256_and_si256(is_letter, letter_values));
+    __m256i bytes;
+
+    if ((uint32_t)_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_letter)) != 0xffffffffU) {
+        return -1;
+    }
+
+    /* (high digit, low digit) pairs into bytes, then the 4 bytes of each word into host order */
+    nibbles = _mm256_maddubs_epi16(nibbles, _mm256_set1_epi16(0x0110));
+    bytes = _mm256_packus_epi16(nibbles, nibbles);
+    bytes = _mm256_shuffle_epi8(bytes, _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, -1, -1, -1, -1, -1, -1, -1, -1, 3, 2, 1, 0, 7, 6, 5, 4, -1, -1, -1, -1, -1, -1, -1, -1));
 
-    /* specify the network stat filename based on the protocol type */
-    if (strcmp(protocol, "tcp") == 0) {
-        strcpy(proc_netstat_filename, "/proc/net/tcp");
-    } else if (strcmp(protocol, "udp") == 0) {
-        strcpy(proc_netstat_filename, "/proc/net/udp");
-    } else if (strcmp(protocol, "tcp6") == 0) {
-        strcpy(proc_netstat_filename, "/proc/net/tcp6");
-    } else if (strcmp(protocol, "udp6") == 0) {
-        strcpy(proc_netstat_filename, "/proc/net/udp6");
+    words[0] = (uint32_t)_mm256_extract_epi32(bytes, 0);
+    words[1] = (uint32_t)_mm256_extract_epi32(bytes, 1);
+    words[2] = (uint32_t)_mm256_extract_epi32(bytes, 4);
+    words[3] = (uint32_t)_mm256_extract_epi32(bytes, 5);
+
+    return 0;
+}
+#endif
+
+/* decoder of the address fields, selected from the CPU features on first use. `make check` forces each of them */
+enum hex_decoder {
+    HEX_DECODER_UNSET,
+    HEX_DECODER_SCALAR,
+    HEX_DECODER_SSE2,
+    HEX_DECODER_AVX2
+};
+
+static enum hex_decoder hex_decoder = HEX_DECODER_UNSET;
+
+static void select_hex_decoder(void) {
+#if defined(__SSE2__)
+    hex_decoder = __builtin_cpu_supports("avx2") ? HEX_DECODER_AVX2 : HEX_DECODER_SSE2;
+#else
+    hex_decoder = HEX_DECODER_SCALAR;
+#endif
+}
+
+/* 8 digits are decoded with SSE2 unless the scalar decoder is forced, AVX2 only pays off for 32 digits */
+static int decode_hex32(const char *hex, uint32_t *value) {
+#if defined(__SSE2__)
+    if (hex_decoder != HEX_DECODER_SCALAR) {
+        return decode_hex32_sse2(hex, value);
+    }
+#endif
+
+    return decode_hex32_scalar(hex, value);
+}
+
+static int decode_hex128(const char *hex, uint32_t words[4]) {
+    if (hex_decoder == HEX_DECODER_UNSET) {
+        select_hex_decoder();
+    }
+
+#if defined(__SSE2__)
+    if (hex_decoder == HEX_DECODER_AVX2) {
+        return decode_hex128_avx2(hex, words);
+    }
+    if (hex_decoder == HEX_DECODER_SSE2) {
+        return decode_hex128_sse2(hex, words);
+    }
+#endif
+
+    return decode_hex128_scalar(hex, words);
+}
+
+/* short hex fields, e.g. ports and the socket state */
+static int decode_hex_field(const char *hex, int width, unsigned long *value) {
+    uint32_t padded;
+    char digits[8] = {'0', '0', '0', '0', '0', '0', '0', '0'};
+
+    memcpy(digits + 8 - width, hex, width);
+
+    if (decode_hex32_scalar(digits, &padded) < 0) {
+        return -1;
+    }
+
+    *value = padded;
+
+    return 0;
+}
+
+static const char *parse_decimal_field(const char *cursor, long int *value) {
+    long int result = 0;
+    int negative = 0;
+
+    while (*cursor == ' ') {
+        ++cursor;
+    }
+
+    if (*cursor == '-') {
+        negative = 1;
+        ++cursor;
+    }
+
+    if (*cursor < '0' || *cursor > '9') {
+        return NULL;
+    }
+
+    while (*cursor >= '0' && *cursor <= '9') {
+        result = result * 10 + (*cursor - '0');
+        ++cursor;
+    }
+
+    *value = negative ? -result : result;
+
+    return cursor;
+}
+
+/* parse one address:port field, the address is copied in network byte order */
+static const char *parse_address_field(const char *cursor, const char *line_end, int ipv6, unsigned char *address, int *port) {
+    uint32_t words[4];
+    unsigned long port_value;
+    int address_width = ipv6 ? 32 : 8;
+
+    if (line_end - cursor < address_width + 5 || cursor[address_width] != ':') {
+        return NULL;
+    }
+
+    if (ipv6) {
+        if (decode_hex128(cursor, words) < 0) {
+            return NULL;
+        }
+        memcpy(address, words, sizeof(words));
     } else {
-        fprintf(stderr, "ERROR: please pass correct protocol string: [tcp, tcp6, udp, udp6]\n");
+        if (decode_hex32(cursor, &words[0]) < 0) {
+            return NULL;
+        }
+        memcpy(address, &words[0], sizeof(uint32_t));
+    }
+
+    cursor += address_width + 1;
+
+    if (decode_hex_field(cursor, 4, &port_value) < 0) {
         return NULL;
     }
+    *port = (int)port_value;
 
-    FILE *proc_netstat_file;
-    proc_netstat_file = NULL;
-
-    char line[BUFSIZ];
-
-    /* define reading format of /proc/net/{tcp,udp,tcp6,udp6} file */
-    char *format = "%d: %64[0-9A-Fa-f]:%X %64[0-9A-Fa-f]:%X %X %lX:%lX %X:%lX %lX %d %d %ld %*s";
-
-    /* define field variables of /proc/net/{tcp,tcp6,udp,udp6} file
-     *
-     * 1st: index (d)
-     * 2nd: local address (64[0-9A-Fa-f])
-     * 3rd: local port (X)
-     * 4th: remote address (64[0-9A-Fa-f])
-     * 5th: remote port (X)
-     * 6th: socket state (X)
-     * 7th: TX queue size (lX)
-     * 8th: RX queue size (lX)
-     * 9th: timer active (X)
-     * 10th: number of jiffies until timer expires (lX)
-     * 11th: number of unrecovered RTO timeouts (lX)
-     * 12th: uid (d)
-     * 13th: unanswered 0-window probes (d)
-     * 14th: socket inode (ld)
-     */
-    int index;
-    char local_address[128];
-    int local_port;
-    char remote_address[128];
-    int remote_port;
-    int socket_state;
-    long int tx_queue;
-    long int rx_queue;
-    int timer_active;
-    long int time_length;
-    long int retry;
-    int uid;
-    int timeout;
-    long int socket_inode;
-
-    /* define address strings */
-    struct in_addr ip_address;
-    struct in6_addr ipv6_address;
-    char local_address_string[INET_ADDRSTRLEN];
-    char remote_address_string[INET_ADDRSTRLEN];
-    char ipv6_local_address_string[INET6_ADDRSTRLEN];
-    char ipv6_remote_address_string[INET6_ADDRSTRLEN];
-    uint32_t local_address_hex;
-    uint32_t remote_address_hex;
-
-    int ret_sscanf;
-
-    proc_netstat_file = fopen(proc_netstat_filename, "r");
-    if (proc_netstat_file == NULL) {
-        fprintf(stderr, "ERROR: failed to open %s stats file %s: %s\n", protocol, proc_netstat_filename, strerror(errno));
+    return cursor + 4;
+}
+
+/* skip the slot index of a table line, returns NULL for the header line */
+static const char *skip_netstat_slot(const char *line) {
+    const char *cursor = line;
+
+    while (*cursor == ' ') {
+        ++cursor;
+    }
+    while (*cursor >= '0' && *cursor <= '9') {
+        ++cursor;
+    }
+    if (cursor == line || *cursor != ':' || cursor[1] != ' ') {
         return NULL;
     }
 
-    /* build linked-list */
-    struct netstat *head = NULL;
-    struct netstat *next = NULL;
+    return cursor + 2;
+}
 
-    while (fgets(line, sizeof(line), proc_netstat_file) != NULL) {
-        /* read fields from each stat line */
-        ret_sscanf = sscanf(line, format, &index, local_address, &local_port, remote_address, &remote_port, &socket_state, &tx_queue, &rx_queue, &timer_active, &time_length, &retry, &uid, &timeout, &socket_inode);
+/*
+ * fixed-column line of /proc/net/{tcp,udp}{,6} after the slot index, e.g.
+ *    0: 0100007F:1F90 00000000:0000 0A 00000000:00000000 00:00000000 00000000  1000        0 12345 ...
+ * the addresses are the raw 32-bit words printed with %08X, so they are stored as they are
+ */
+static int parse_netstat_line(const char *entry, const char *line_end, int ipv6, struct netstat *node) {
+    const char *cursor = entry;
+    uint32_t tx_queue;
+    uint32_t rx_queue;
+    unsigned long socket_state;
+    long int uid;
+    long int timeout;
 
-        if (ret_sscanf < 11) {
-            continue;
-        }
+    cursor = parse_address_field(cursor, line_end, ipv6, node->local_address, &node->local_port);
+    if (cursor == NULL || *cursor != ' ') {
+        return -1;
+    }
 
-        /* IPv4 connections */
-        if (strcmp(protocol, "tcp") == 0 || strcmp(protocol, "udp") == 0) {
-            /* process local address and port*/
-            ret_sscanf = sscanf(local_address, "%X", &local_address_hex);
-            if (ret_sscanf < 1 || ret_sscanf == EOF) {
-                continue;
-            }
+    cursor = parse_address_field(cursor + 1, line_end, ipv6, node->remote_address, &node->remote_port);
+    if (cursor == NULL || *cursor != ' ') {
+        return -1;
+    }
+    ++cursor;
 
-            ip_address.s_addr = local_address_hex;
+    /* state, tx_queue:rx_queue, tr:tm->when and retrnsmt have fixed widths */
+    if (line_end - cursor < 2 + 1 + 17 + 1 + 11 + 1 + 8 || cursor[2] != ' ' || cursor[11] != ':' || cursor[20] != ' ' || cursor[23] != ':' || cursor[32] != ' ') {
+        return -1;
+    }
 
-            if (inet_ntop(AF_INET, &ip_address, local_address_string, INET_ADDRSTRLEN) == NULL) {
-                continue;
-            }
+    if (decode_hex_field(cursor, 2, &socket_state) < 0 || decode_hex32(cursor + 3, &tx_queue) < 0 || decode_hex32(cursor + 12, &rx_queue) < 0) {
+        return -1;
+    }
+    cursor += 41;
 
-            /* process remote address and port*/
-            ret_sscanf = sscanf(remote_address, "%X", &remote_address_hex);
-            if (ret_sscanf < 1 || ret_sscanf == EOF) {
-                continue;
-            }
+    /* uid, timeout and inode are decimal */
+    cursor = parse_decimal_field(cursor, &uid);
+    if (cursor == NULL) {
+        return -1;
+    }
 
-            ip_address.s_addr = remote_address_hex;
+    cursor = parse_decimal_field(cursor, &timeout);
+    if (cursor == NULL) {
+        return -1;
+    }
 
-            if (inet_ntop(AF_INET, &ip_address, remote_address_string, INET_ADDRSTRLEN) == NULL) {
-                continue;
-            }
+    cursor = parse_decimal_field(cursor, &node->socket_inode);
+    if (cursor == NULL) {
+        return -1;
+    }
+
+    node->family = ipv6 ? AF_INET6 : AF_INET;
+    node->socket_state = (int)socket_state;
+    node->tx_queue = tx_queue;
+    node->rx_queue = rx_queue;
+
+    return 0;
+}
+
+/*
+ * 64-bit hash of a line, 8 bytes at a time. the slot index is excluded by the caller, as it shifts
+ * whenever a socket before the line is opened or closed
+ */
+static uint64_t hash_netstat_line(const char *line, size_t length) {
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ length;
+    uint64_t word;
+    size_t offset;
+
+    for (offset = 0; offset + 8 <= length; offset += 8) {
+        memcpy(&word, line + offset, 8);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 32;
+    }
+
+    if (offset < length) {
+        word = 0;
+        memcpy(&word, line + offset, length - offset);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+/* take over the parsed line of the previous load if it is byte-identical, the hash only selects the candidates */
+static struct netstat *reuse_netstat_line(struct netstat_table *table, const char *line, uint64_t line_hash, size_t line_length) {
+    struct netstat *node;
+    size_t bucket;
+
+    if (table->buckets == NULL) {
+        return NULL;
+    }
+
+    bucket = line_hash & (table->bucket_count - 1);
+    while ((node = table->buckets[bucket]) != NULL) {
+        /* identical lines, e.g. of TIME_WAIT sockets, are taken over one by one */
+        if (node->line_hash == line_hash && node->line_length == line_length && !node->reused && memcmp(node->line, line, line_length) == 0) {
+            node->reused = 1;
+            return node;
         }
 
-        /* IPv6 connections */
-        if (strcmp(protocol, "tcp6") == 0 || strcmp(protocol, "udp6") == 0) {
-            /* process local address and port*/
-            ret_sscanf = sscanf(local_address, "%08X%08X%08X%08X", &ipv6_address.s6_addr32[0], &ipv6_address.s6_addr32[1], &ipv6_address.s6_addr32[2], &ipv6_address.s6_addr32[3]);
-            if (ret_sscanf < 4 || ret_sscanf == EOF) {
-                continue;
-            }
+        bucket = (bucket + 1) & (table->bucket_count - 1);
+    }
 
-            if (inet_ntop(AF_INET6, &ipv6_address, ipv6_local_address_string, INET6_ADDRSTRLEN) == NULL) {
-                continue;
-            }
+    return NULL;
+}
 
-            /* process remote address and port*/
-            ret_sscanf = sscanf(remote_address, "%08X%08X%08X%08X", &ipv6_address.s6_addr32[0], &ipv6_address.s6_addr32[1], &ipv6_address.s6_addr32[2], &ipv6_address.s6_addr32[3]);
-            if (ret_sscanf < 4 || ret_sscanf == EOF) {
-                continue;
-            }
+/* free the lines which are not taken over, then index the new lines */
+static int index_netstat_table(struct netstat_table *table, struct netstat *head, size_t line_count) {
+    struct netstat **new_buckets;
+    struct netstat *node;
+    size_t new_bucket_count;
+    size_t bucket;
+    size_t i;
 
-            if (inet_ntop(AF_INET6, &ipv6_address, ipv6_remote_address_string, INET6_ADDRSTRLEN) == NULL) {
-                continue;
+    /* every line of the previous load is in exactly one bucket, the list itself is relinked by the new load */
+    if (table->buckets != NULL) {
+        for (i = 0; i < table->bucket_count; ++i) {
+            node = table->buckets[i];
+            if (node != NULL && !node->reused) {
+                free(node);
             }
         }
+    } else {
+        free_netstat(table->head);
+    }
 
-        /* create netstat struct */
-        struct netstat *node = (struct netstat *)malloc(sizeof(struct netstat));
-        if (node == NULL) {
-            fprintf(stderr, "ERROR: failed to allocate memory for netstat struct\n");
-            return NULL;
-        }
+    table->head = head;
+    for (node = head; node != NULL; node = node->next_ptr) {
+        node->reused = 0;
+    }
 
-        /* fill out the node */
-        strcpy(node->protocol, protocol);
-        node->socket_state = socket_state;
-        node->socket_inode = socket_inode;
+    /* keep the load factor at most 1/2, the buckets only grow */
+    new_bucket_count = table->bucket_count > 0 ? table->bucket_count : NETSTAT_TABLE_INITIAL_BUCKETS;
+    while (line_count * 2 >= new_bucket_count) {
+        new_bucket_count *= 2;
+    }
 
-        if (strcmp(protocol, "tcp") == 0 || strcmp(protocol, "udp") == 0) {
-            strcpy(node->local_address, local_address_string);
+    if (new_bucket_count != table->bucket_count) {
+        new_buckets = (struct netstat **)realloc(table->buckets, new_bucket_count * sizeof(struct netstat *));
+        if (new_buckets == NULL) {
+            free(table->buckets);
+            table->buckets = NULL;
+            table->bucket_count = 0;
+            return -1;
         }
-        if (strcmp(protocol, "tcp6") == 0 || strcmp(protocol, "udp6") == 0) {
-            strcpy(node->local_address, ipv6_local_address_string);
+
+        table->buckets = new_buckets;
+        table->bucket_count = new_bucket_count;
+    }
+
+    memset(table->buckets, 0, table->bucket_count * sizeof(struct netstat *));
+
+    for (node = head; node != NULL; node = node->next_ptr) {
+        bucket = node->line_hash & (table->bucket_count - 1);
+        while (table->buckets[bucket] != NULL) {
+            bucket = (bucket + 1) & (table->bucket_count - 1);
         }
+        table->buckets[bucket] = node;
+    }
+
+    return 0;
+}
+
+static void free_netstat_table(struct netstat_table *table) {
+    free_netstat(table->head);
+    free(table->buckets);
+
+    table->head = NULL;
+    table->buckets = NULL;
+    table->bucket_count = 0;
+}
+
+/* load a table, the lines which are unchanged since the previous load of the same table are not parsed again */
+static int load_netstat_table(pid_t pid, char *protocol, struct netstat_table *table) {
+    char proc_netstat_filename[PATH_MAX];
+    char *proc_netstat_buffer;
+    const char *line;
+    const char *line_end;
+    const char *entry;
+    struct netstat parsed_node;
+    struct netstat *node;
+    struct netstat *head = NULL;
+    struct netstat *next = NULL;
+    uint64_t line_hash;
+    size_t line_length;
+    size_t line_count = 0;
+    int ret_load = 0;
+    int ret_snprintf;
+    int ipv6;
+
+    /* validate the protocol type */
+    if (strcmp(protocol, "tcp") != 0 && strcmp(protocol, "udp") != 0 && strcmp(protocol, "tcp6") != 0 && strcmp(protocol, "udp6") != 0) {
+        fprintf(stderr, "ERROR: please pass correct protocol string: [tcp, tcp6, udp, udp6]\n");
+        free_netstat_table(table);
+        return -1;
+    }
 
-        node->local_port = local_port;
+    ipv6 = strchr(protocol, '6') != NULL;
 
-        if (strcmp(protocol, "tcp") == 0 || strcmp(protocol, "udp") == 0) {
-            strcpy(node->remote_address, remote_address_string);
+    /* specify the network stat filename in the network namespace of the pid */
+    ret_snprintf = snprintf(proc_netstat_filename, sizeof(proc_netstat_filename), "/proc/%d/net/%s", pid, protocol);
+    if (ret_snprintf < 0) {
+        free_netstat_table(table);
+        return -1;
+    }
+
+    proc_netstat_buffer = read_procfs_file(proc_netstat_filename, NULL);
+    if (proc_netstat_buffer == NULL) {
+        fprintf(stderr, "ERROR: failed to open %s stats file %s: %s\n", protocol, proc_netstat_filename, strerror(errno));
+        free_netstat_table(table);
+        return -1;
+    }
+
+    /* build linked-list, the lines are parsed in place */
+    for (line = proc_netstat_buffer; *line != '\0'; line = *line_end == '\n' ? line_end + 1 : line_end) {
+        line_end = strchr(line, '\n');
+        if (line_end == NULL) {
+            line_end = line + strlen(line);
         }
-        if (strcmp(protocol, "tcp6") == 0 || strcmp(protocol, "udp6") == 0) {
-            strcpy(node->remote_address, ipv6_remote_address_string);
+
+        /* the header line is skipped */
+        entry = skip_netstat_slot(line);
+        if (entry == NULL || entry > line_end) {
+            continue;
         }
 
-        node->remote_port = remote_port;
-        node->tx_queue = tx_queue;
-        node->rx_queue = rx_queue;
-        node->next_ptr = NULL;
+        line_length = line_end - entry;
+        line_hash = hash_netstat_line(entry, line_length);
+
+        node = reuse_netstat_line(table, entry, line_hash, line_length);
+        if (node != NULL) {
+            ++netstat_parse_stats.reused_lines;
 
+            /* socket memory is not part of the line, it is queried again */
+            node->skmem_status = 0;
+            memset(&node->skmem, 0, sizeof(node->skmem));
+        } else {
+            /* malformed lines are skipped */
+            memset(&parsed_node, 0, sizeof(parsed_node));
+            if (parse_netstat_line(entry, line_end, ipv6, &parsed_node) < 0) {
+                continue;
+            }
+
+            /* create netstat struct, the raw line is kept behind it to be compared by the next load */
+            node = (struct netstat *)malloc(sizeof(struct netstat) + line_length);
+            if (node == NULL) {
+                fprintf(stderr, "ERROR: failed to allocate memory for netstat struct\n");
+                ret_load = -1;
+                break;
+            }
+
+            *node = parsed_node;
+            strcpy(node->protocol, protocol);
+            node->line_hash = line_hash;
+            node->line_length = line_length;
+            node->line = (char *)(node + 1);
+            memcpy(node->line, entry, line_length);
+        }
+
+        ++netstat_parse_stats.lines;
+        ++line_count;
+
+        node->next_ptr = NULL;
         if (head == NULL) {
             head = node;
             next = node;
@@ -213,27 +601,444 @@ struct netstat *load_netstat(char *protocol) {
         }
     }
 
-    fclose(proc_netstat_file);
+    /* the index is only an optimization, without it the next load parses every line */
+    if (index_netstat_table(table, head, line_count) < 0 && ret_load == 0) {
+        fprintf(stderr, "WARNING: failed to allocate memory for %s netstat index\n", protocol);
+    }
+
+    /* the lines loaded before the allocation failure are released as well */
+    if (ret_load < 0) {
+        free_netstat_table(table);
+    }
+
+    return ret_load;
+}
+
+int load_netstat(pid_t pid, char *protocol, struct netstat **netstat_list) {
+    struct netstat_table table = {0};
+    int ret_load_netstat_table;
+
+    ret_load_netstat_table = load_netstat_table(pid, protocol, &table);
+
+    /* a single load has nothing to reuse, only the list is returned */
+    *netstat_list = table.head;
+    free(table.buckets);
 
-    return head;
+    return ret_load_netstat_table;
 }
 
-void get_connection_stats(long int input_socket_inode, struct netstat *input_netstat) {
+int collect_connection_stats(pid_t pid, long int input_socket_inode, struct netstat *input_netstat, struct socket_list *socket_list) {
     struct netstat *head = NULL;
+    struct socket_record *record;
+    struct socket_record *new_sockets;
+    size_t new_capacity;
+
+    for (head = input_netstat; head != NULL; head = head->next_ptr) {
+        if (head->socket_inode != input_socket_inode) {
+            continue;
+        }
+
+        /* the array only grows, the next collections reuse it */
+        if (socket_list->count == socket_list->capacity) {
+            new_capacity = socket_list->capacity > 0 ? socket_list->capacity * 2 : SOCKET_LIST_INITIAL_CAPACITY;
+            new_sockets = (struct socket_record *)realloc(socket_list->sockets, new_capacity * sizeof(struct socket_record));
+            if (new_sockets == NULL) {
+                fprintf(stderr, "ERROR: failed to allocate memory for the PID %d sockets\n", pid);
+                return -1;
+            }
+
+            socket_list->sockets = new_sockets;
+            socket_list->capacity = new_capacity;
+        }
+
+        record = &socket_list->sockets[socket_list->count++];
+        strcpy(record->protocol, head->protocol);
+        record->family = head->family;
+        record->socket_state = head->socket_state;
+        record->socket_inode = head->socket_inode;
+        memcpy(record->local_address, head->local_address, sizeof(record->local_address));
+        record->local_port = head->local_port;
+        memcpy(record->remote_address, head->remote_address, sizeof(record->remote_address));
+        record->remote_port = head->remote_port;
+        record->tx_queue = head->tx_queue;
+        record->rx_queue = head->rx_queue;
+
+        /* sock_diag is only queried for the sockets of the process */
+        if (get_socket_memory(pid, head) == 0) {
+            record->skmem_status = 1;
+            record->skmem = head->skmem;
+        } else {
+            record->skmem_status = -1;
+            memset(&record->skmem, 0, sizeof(record->skmem));
+        }
+    }
+
+    return 0;
+}
+
+void free_socket_list(struct socket_list *socket_list) {
+    free(socket_list->sockets);
+    socket_list->sockets = NULL;
+    socket_list->count = 0;
+    socket_list->capacity = 0;
+}
+
+char *get_socket_state_name(int socket_state) {
+    if (socket_state <= 0 || socket_state >= (int)(sizeof(tcp_state) / sizeof(tcp_state[0]))) {
+        return tcp_state[0];
+    }
+
+    return tcp_state[socket_state];
+}
+
+/* memory charged to the socket: queued data and the forward allocation reserved for it */
+long int get_socket_charged_memory(struct socket_memory *skmem) {
+    return skmem->rmem_alloc + skmem->wmem_queued + skmem->fwd_alloc;
+}
+
+static int open_sock_diag_socket(pid_t pid) {
+    char netns_path[PATH_MAX];
+    int self_netns_fd;
+    int target_netns_fd;
+    int diag_fd;
+    struct stat self_netns_stat;
+    struct stat target_netns_stat;
+    int same_netns;
+
+    if (snprintf(netns_path, sizeof(netns_path), "/proc/%d/ns/net", pid) < 0) {
+        return -1;
+    }
+
+    target_netns_fd = open(netns_path, O_RDONLY | O_CLOEXEC);
+    if (target_netns_fd < 0) {
+        return -1;
+    }
+
+    /* setns() only moves the calling thread, /proc/thread-self is the namespace to return to */
+    self_netns_fd = open("/proc/thread-self/ns/net", O_RDONLY | O_CLOEXEC);
+    if (self_netns_fd < 0) {
+        close(target_netns_fd);
+        return -1;
+    }
+
+    if (fstat(self_netns_fd, &self_netns_stat) < 0 || fstat(target_netns_fd, &target_netns_stat) < 0) {
+        diag_fd = -1;
+        goto close_netns;
+    }
+
+    /* a socket keeps the network namespace it was created in */
+    same_netns = self_netns_stat.st_dev == target_netns_stat.st_dev && self_netns_stat.st_ino == target_netns_stat.st_ino;
+    if (!same_netns && setns(target_netns_fd, CLONE_NEWNET) < 0) {
+        fprintf(stderr, "WARNING: failed to enter the network namespace of PID %d, socket memory is not available: %s\n", pid, strerror(errno));
+        diag_fd = -1;
+        goto close_netns;
+    }
+
+    diag_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+
+    if (!same_netns && setns(self_netns_fd, CLONE_NEWNET) < 0) {
+        fprintf(stderr, "ERROR: failed to return to the network namespace of memdoor: %s\n", strerror(errno));
+    }
+
+    if (diag_fd < 0) {
+        fprintf(stderr, "WARNING: failed to create a sock_diag netlink socket: %s\n", strerror(errno));
+    }
+
+close_netns:
+    close(self_netns_fd);
+    close(target_netns_fd);
+
+    return diag_fd;
+}
+
+static int get_sock_diag_socket(pid_t pid) {
+    dev_t netns_dev;
+    ino_t netns_inode;
+    struct timeval receive_timeout = {0, 100000};
+
+    /* a replayed process is not running */
+    if (get_netns_id(pid, &netns_dev, &netns_inode) < 0) {
+        return -1;
+    }
+
+    if (netns_dev == sock_diag_netns_dev && netns_inode == sock_diag_netns_inode) {
+        return sock_diag_netns_failed ? -1 : sock_diag_fd;
+    }
+
+    if (sock_diag_fd >= 0) {
+        close(sock_diag_fd);
+    }
+
+    sock_diag_netns_dev = netns_dev;
+    sock_diag_netns_inode = netns_inode;
+    sock_diag_fd = open_sock_diag_socket(pid);
+    sock_diag_netns_failed = sock_diag_fd < 0;
+
+    if (sock_diag_fd >= 0) {
+        setsockopt(sock_diag_fd, SOL_SOCKET, SO_RCVTIMEO, &receive_timeout, sizeof(receive_timeout));
+    }
+
+    return sock_diag_fd;
+}
+
+static void parse_socket_memory(struct nlmsghdr *message, struct netstat *netstat_entry) {
+    struct inet_diag_msg *diag_message = (struct inet_diag_msg *)NLMSG_DATA(message);
+    struct rtattr *attribute = (struct rtattr *)(diag_message + 1);
+    int attribute_length = message->nlmsg_len - NLMSG_LENGTH(sizeof(struct inet_diag_msg));
+    uint32_t *meminfo;
+
+    for (; RTA_OK(attribute, attribute_length); attribute = RTA_NEXT(attribute, attribute_length)) {
+        if (attribute->rta_type != INET_DIAG_SKMEMINFO || RTA_PAYLOAD(attribute) < SK_MEMINFO_OPTMEM * sizeof(uint32_t) + sizeof(uint32_t)) {
+            continue;
+        }
 
-    if (input_netstat == NULL) {
+        meminfo = (uint32_t *)RTA_DATA(attribute);
+        netstat_entry->skmem.rmem_alloc = meminfo[SK_MEMINFO_RMEM_ALLOC];
+        netstat_entry->skmem.rcvbuf = meminfo[SK_MEMINFO_RCVBUF];
+        netstat_entry->skmem.wmem_alloc = meminfo[SK_MEMINFO_WMEM_ALLOC];
+        netstat_entry->skmem.sndbuf = meminfo[SK_MEMINFO_SNDBUF];
+        netstat_entry->skmem.fwd_alloc = meminfo[SK_MEMINFO_FWD_ALLOC];
+        netstat_entry->skmem.wmem_queued = meminfo[SK_MEMINFO_WMEM_QUEUED];
+        netstat_entry->skmem.optmem = meminfo[SK_MEMINFO_OPTMEM];
+        netstat_entry->skmem_status = 1;
         return;
     }
+}
+
+int get_socket_memory(pid_t pid, struct netstat *netstat_entry) {
+    struct {
+        struct nlmsghdr header;
+        struct inet_diag_req_v2 request;
+    } diag_request;
+    struct sockaddr_nl kernel_address = {.nl_family = AF_NETLINK};
+    struct inet_diag_sockid *socket_id = &diag_request.request.id;
+    char response_buffer[8192];
+    struct nlmsghdr *message;
+    ssize_t response_length;
+    int ipv6;
+    int udp;
+    int diag_fd;
+    void *local_address;
+    void *remote_address;
+
+    /* the result is kept with the cached table entry until the tables are reloaded in the next cycle */
+    if (netstat_entry->skmem_status != 0) {
+        return netstat_entry->skmem_status > 0 ? 0 : -1;
+    }
+
+    netstat_entry->skmem_status = -1;
 
-    head = input_netstat;
+    diag_fd = get_sock_diag_socket(pid);
+    if (diag_fd < 0) {
+        return -1;
+    }
 
-    while (head != NULL) {
-        if (head->socket_inode == input_socket_inode) {
-            /* print network connection stats */
-            fprintf(stdout, "%-6s%-13s%-45s%-8d%-45s%-8d%-10ld%-10ld\n", head->protocol, tcp_state[head->socket_state], head->local_address, head->local_port, head->remote_address, head->remote_port, head->tx_queue, head->rx_queue);
-            fflush(stdout);
+    ipv6 = strchr(netstat_entry->protocol, '6') != NULL;
+    udp = netstat_entry->protocol[0] == 'u';
+
+    memset(&diag_request, 0, sizeof(diag_request));
+    diag_request.header.nlmsg_len = sizeof(diag_request);
+    diag_request.header.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    diag_request.header.nlmsg_flags = NLM_F_REQUEST;
+    diag_request.request.sdiag_family = ipv6 ? AF_INET6 : AF_INET;
+    diag_request.request.sdiag_protocol = udp ? IPPROTO_UDP : IPPROTO_TCP;
+    diag_request.request.idiag_ext = 1 << (INET_DIAG_SKMEMINFO - 1);
+    diag_request.request.idiag_states = ~0U;
+
+    /* an exact lookup of one socket instead of dumping the whole table, the kernel looks up UDP sockets with src and dst swapped */
+    local_address = udp ? socket_id->idiag_dst : socket_id->idiag_src;
+    remote_address = udp ? socket_id->idiag_src : socket_id->idiag_dst;
+
+    memcpy(local_address, netstat_entry->local_address, ipv6 ? 16 : 4);
+    memcpy(remote_address, netstat_entry->remote_address, ipv6 ? 16 : 4);
+
+    if (udp) {
+        socket_id->idiag_dport = htons(netstat_entry->local_port);
+        socket_id->idiag_sport = htons(netstat_entry->remote_port);
+    } else {
+        socket_id->idiag_sport = htons(netstat_entry->local_port);
+        socket_id->idiag_dport = htons(netstat_entry->remote_port);
+    }
+
+    socket_id->idiag_cookie[0] = INET_DIAG_NOCOOKIE;
+    socket_id->idiag_cookie[1] = INET_DIAG_NOCOOKIE;
+
+    if (sendto(diag_fd, &diag_request, sizeof(diag_request), 0, (struct sockaddr *)&kernel_address, sizeof(kernel_address)) < 0) {
+        return -1;
+    }
+
+    response_length = recv(diag_fd, response_buffer, sizeof(response_buffer), 0);
+    if (response_length < 0) {
+        return -1;
+    }
+
+    for (message = (struct nlmsghdr *)response_buffer; NLMSG_OK(message, (size_t)response_length); message = NLMSG_NEXT(message, response_length)) {
+        if (message->nlmsg_type == NLMSG_ERROR || message->nlmsg_type == NLMSG_DONE) {
+            break;
         }
 
-        head = head->next_ptr;
+        /* the socket may have been replaced by another one with the same addresses */
+        if (message->nlmsg_type == SOCK_DIAG_BY_FAMILY && ((struct inet_diag_msg *)NLMSG_DATA(message))->idiag_inode == netstat_entry->socket_inode) {
+            parse_socket_memory(message, netstat_entry);
+        }
+    }
+
+    return netstat_entry->skmem_status > 0 ? 0 : -1;
+}
+
+int get_netns_id(pid_t pid, dev_t *netns_dev, ino_t *netns_inode) {
+    char netns_path[PATH_MAX];
+    struct stat netns_stat;
+
+    int ret_snprintf;
+
+    *netns_dev = 0;
+    *netns_inode = 0;
+
+    /* a replayed process is not running, its tables are cached by PID */
+    if (procfs_is_offline()) {
+        return -1;
     }
+
+    /* construct /proc/pid/ns/net file path name */
+    ret_snprintf = snprintf(netns_path, sizeof(netns_path), "/proc/%d/ns/net", pid);
+    if (ret_snprintf < 0) {
+        return -1;
+    }
+
+    /* the device and inode of the namespace file identify the network namespace */
+    if (stat(netns_path, &netns_stat) < 0) {
+        return -1;
+    }
+
+    *netns_dev = netns_stat.st_dev;
+    *netns_inode = netns_stat.st_ino;
+
+    return 0;
+}
+
+static void clear_netns_cache_entry(struct netns_cache *entry) {
+    int i;
+
+    for (i = 0; i < NETNS_PROTOCOL_COUNT; ++i) {
+        free_netstat_table(&entry->netstat[i]);
+        entry->loaded[i] = 0;
+    }
+
+    entry->netns_dev = 0;
+    entry->netns_inode = 0;
+    entry->pid = 0;
+    entry->generation = 0;
+}
+
+int get_netns_netstat(pid_t pid, char *protocol, struct netstat **netstat_list) {
+    dev_t netns_dev;
+    ino_t netns_inode;
+    struct netns_cache *entry = NULL;
+    struct netns_cache *stale_entry = NULL;
+
+    int protocol_index = -1;
+    int i;
+
+    *netstat_list = NULL;
+
+    for (i = 0; i < NETNS_PROTOCOL_COUNT; ++i) {
+        if (strcmp(protocol, netns_protocols[i]) == 0) {
+            protocol_index = i;
+            break;
+        }
+    }
+
+    if (protocol_index < 0) {
+        fprintf(stderr, "ERROR: please pass correct protocol string: [tcp, tcp6, udp, udp6]\n");
+        return -1;
+    }
+
+    /* without access to /proc/pid/ns/net the tables are still readable, they are cached per pid instead */
+    get_netns_id(pid, &netns_dev, &netns_inode);
+
+    /* look up the namespace, remember the least recently used slot which was not used in this cycle for eviction */
+    for (i = 0; i < NETNS_CACHE_SIZE; ++i) {
+        if (netns_cache[i].generation != 0 && netns_cache[i].netns_dev == netns_dev && netns_cache[i].netns_inode == netns_inode && (netns_inode != 0 || netns_cache[i].pid == pid)) {
+            entry = &netns_cache[i];
+            break;
+        }
+
+        if (netns_cache[i].generation != netns_cache_generation && (stale_entry == NULL || netns_cache[i].generation < stale_entry->generation)) {
+            stale_entry = &netns_cache[i];
+        }
+    }
+
+    /* the tables of the previous cycles are kept, their unchanged lines are reused when the tables are loaded again */
+    if (entry != NULL && entry->generation != netns_cache_generation) {
+        for (i = 0; i < NETNS_PROTOCOL_COUNT; ++i) {
+            entry->loaded[i] = 0;
+        }
+
+        entry->pid = pid;
+        entry->generation = netns_cache_generation;
+    }
+
+    if (entry == NULL) {
+        if (stale_entry == NULL) {
+            fprintf(stderr, "ERROR: network namespace cache is full, %d namespaces are already loaded in this cycle\n", NETNS_CACHE_SIZE);
+            return -1;
+        }
+
+        entry = stale_entry;
+        clear_netns_cache_entry(entry);
+        entry->netns_dev = netns_dev;
+        entry->netns_inode = netns_inode;
+        entry->pid = pid;
+        entry->generation = netns_cache_generation;
+    }
+
+    /* parse the table once per namespace per cycle */
+    if (!entry->loaded[protocol_index]) {
+        entry->load_status[protocol_index] = load_netstat_table(pid, protocol, &entry->netstat[protocol_index]);
+        entry->loaded[protocol_index] = 1;
+    }
+
+    *netstat_list = entry->netstat[protocol_index].head;
+
+    return entry->load_status[protocol_index];
+}
+
+void add_netns_batch_files(struct procfs_batch *batch, pid_t pid) {
+    char path[PATH_MAX];
+    int i;
+
+    for (i = 0; i < NETNS_PROTOCOL_COUNT; ++i) {
+        if (snprintf(path, sizeof(path), "/proc/%d/net/%s", pid, netns_protocols[i]) < 0) {
+            continue;
+        }
+
+        procfs_batch_add(batch, path);
+    }
+}
+
+void get_netstat_parse_stats(struct netstat_parse_stats *stats) {
+    *stats = netstat_parse_stats;
+}
+
+void netns_cache_next_cycle() {
+    ++netns_cache_generation;
+    memset(&netstat_parse_stats, 0, sizeof(netstat_parse_stats));
+}
+
+void free_netns_cache() {
+    int i;
+
+    for (i = 0; i < NETNS_CACHE_SIZE; ++i) {
+        clear_netns_cache_entry(&netns_cache[i]);
+    }
+
+    if (sock_diag_fd >= 0) {
+        close(sock_diag_fd);
+    }
+
+    sock_diag_fd = -1;
+    sock_diag_netns_dev = 0;
+    sock_diag_netns_inode = 0;
+    sock_diag_netns_failed = 0;
 }
@@ -1,21 +1,105 @@
 #ifndef NETWORK_H
 #define NETWORK_H
 
+#include <stdint.h>
+#include <sys/types.h>
+#include "procfs.h"
+
+#define NETNS_PROTOCOL_COUNT 4
+#define NETNS_CACHE_SIZE 16
+#define SOCKET_LIST_INITIAL_CAPACITY 16
+#define NETSTAT_TABLE_INITIAL_BUCKETS 256 /* power of two, at least twice the number of lines */
+
+/* socket memory reported by sock_diag SK_MEMINFO, unit: byte */
+struct socket_memory {
+    long int rmem_alloc; /* receive queue */
+    long int rcvbuf;
+    long int wmem_alloc; /* transmit queue in flight */
+    long int sndbuf;
+    long int fwd_alloc; /* reserved for future queueing */
+    long int wmem_queued; /* transmit queue */
+    long int optmem;
+};
+
 struct netstat {
     char protocol[5];
+    int family; /* AF_INET or AF_INET6 */
     int socket_state;
     long int socket_inode;
-    char local_address[128];
+    unsigned char local_address[16]; /* network byte order, IPv4 uses the first 4 bytes */
     int local_port;
-    char remote_address[128];
+    unsigned char remote_address[16]; /* network byte order, IPv4 uses the first 4 bytes */
     int remote_port;
     long int tx_queue;
     long int rx_queue;
+    int skmem_status; /* 0 if not queried yet, 1 if skmem is loaded, -1 if it is not available */
+    struct socket_memory skmem;
+    uint64_t line_hash; /* hash of the raw line without the slot index */
+    size_t line_length;
+    char *line; /* the raw line itself, allocated right after the record */
+    int reused; /* 1 while the line is taken over by the next load of the table */
     struct netstat *next_ptr;
 };
 
-extern struct netstat *load_netstat(char *protocol);
+/* parsed lines of one /proc/net table, indexed by line hash so that the next load only parses new or changed lines */
+struct netstat_table {
+    struct netstat *head;
+    struct netstat **buckets; /* linear probing, NULL if empty */
+    size_t bucket_count;
+};
+
+/* lines of the /proc/net tables loaded in the current cycle */
+struct netstat_parse_stats {
+    unsigned long lines;
+    unsigned long reused_lines;
+};
+
+/* one socket of a process, copied from its /proc/net table entry */
+struct socket_record {
+    char protocol[5];
+    int family; /* AF_INET or AF_INET6 */
+    int socket_state;
+    long int socket_inode;
+    unsigned char local_address[16]; /* network byte order, IPv4 uses the first 4 bytes */
+    int local_port;
+    unsigned char remote_address[16]; /* network byte order, IPv4 uses the first 4 bytes */
+    int remote_port;
+    long int tx_queue;
+    long int rx_queue;
+    int skmem_status; /* 1 if skmem is loaded, -1 if it is not available */
+    struct socket_memory skmem;
+};
+
+/* sockets of the last collection, the array is kept and reused by the next collections */
+struct socket_list {
+    struct socket_record *sockets;
+    size_t count;
+    size_t capacity;
+};
+
+/* parsed tcp, udp, tcp6 and udp6 tables of one network namespace */
+struct netns_cache {
+    dev_t netns_dev; /* a namespace is identified by the device and inode of /proc/pid/ns/net */
+    ino_t netns_inode; /* 0 if /proc/pid/ns/net is not accessible */
+    pid_t pid;
+    unsigned long generation;
+    int loaded[NETNS_PROTOCOL_COUNT];
+    int load_status[NETNS_PROTOCOL_COUNT];
+    struct netstat_table netstat[NETNS_PROTOCOL_COUNT]; /* kept for the next cycle of the same namespace */
+};
+
+extern int load_netstat(pid_t pid, char *protocol, struct netstat **netstat_list);
 extern void free_netstat(struct netstat *input_netstat);
-extern void get_connection_stats(long int input_socket_inode, struct netstat *input_netstat);
+extern int collect_connection_stats(pid_t pid, long int input_socket_inode, struct netstat *input_netstat, struct socket_list *socket_list);
+extern void free_socket_list(struct socket_list *socket_list);
+extern char *get_socket_state_name(int socket_state);
+extern int get_socket_memory(pid_t pid, struct netstat *netstat_entry);
+extern long int get_socket_charged_memory(struct socket_memory *skmem);
+extern int get_netns_id(pid_t pid, dev_t *netns_dev, ino_t *netns_inode);
+extern int get_netns_netstat(pid_t pid, char *protocol, struct netstat **netstat_list);
+extern void get_netstat_parse_stats(struct netstat_parse_stats *stats);
+extern void add_netns_batch_files(struct procfs_batch *batch, pid_t pid);
+extern void netns_cache_next_cycle();
+extern void free_netns_cache();
 
 #endif /* NETWORK_H */
@@ -0,0 +1,329 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include "numa.h"
+#include "procfs.h"
+#include "utils.h"
+
+/* online nodes found by the last collection, their meminfo is prefetched in the next cycle's batch */
+static int numa_online_nodes[NUMA_MAX_NODES];
+static int numa_online_count = 0;
+
+/* the nodes are collected by the render thread and prefetched by the capture thread */
+static pthread_mutex_t numa_nodes_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static char *numa_mapping_type_names[NUMA_MAPPING_TYPE_COUNT] = {"ANON", "HEAP", "STACK", "FILE", "HUGE"};
+
+/* parse a node list such as "0-1,3", returns the number of nodes or -1 */
+static int parse_numa_node_list(char *node_list, int *nodes) {
+    char *cursor = node_list;
+    char *end;
+    long first_node;
+    long last_node;
+    long node;
+    int count = 0;
+
+    while (*cursor != '\0' && *cursor != '\n') {
+        errno = 0;
+        first_node = strtol(cursor, &end, 10);
+        if (errno != 0 || end == cursor || first_node < 0) {
+            return -1;
+        }
+
+        last_node = first_node;
+        cursor = end;
+
+        if (*cursor == '-') {
+            ++cursor;
+
+            errno = 0;
+            last_node = strtol(cursor, &end, 10);
+            if (errno != 0 || end == cursor || last_node < first_node) {
+                return -1;
+            }
+
+            cursor = end;
+        }
+
+        for (node = first_node; node <= last_node && node < NUMA_MAX_NODES; ++node) {
+            nodes[count++] = node;
+        }
+
+        if (*cursor == ',') {
+            ++cursor;
+        } else if (*cursor != '\0' && *cursor != '\n') {
+            return -1;
+        }
+    }
+
+    return count;
+}
+
+static int get_numa_node_meminfo(int node, long int *total, long int *free) {
+    char meminfo_path[PATH_MAX];
+    char *meminfo_buffer;
+    char line[256];
+    char key[64];
+    long int value;
+
+    *total = -1;
+    *free = -1;
+
+    if (snprintf(meminfo_path, sizeof(meminfo_path), "%s/node%d/meminfo", NUMA_NODE_PATH, node) < 0) {
+        return -1;
+    }
+
+    meminfo_buffer = read_procfs_file(meminfo_path, NULL);
+    if (meminfo_buffer == NULL) {
+        return -1;
+    }
+
+    /* each line is prefixed with the node, e.g. "Node 0 MemTotal:  16314168 kB" */
+    while (procfs_getline(line, sizeof(line), &meminfo_buffer) != NULL && (*total == -1 || *free == -1)) {
+        if (sscanf(line, "Node %*d %63s %ld", key, &value) != 2) {
+            continue;
+        }
+
+        if (strcmp(key, "MemTotal:") == 0) {
+            *total = value;
+        } else if (strcmp(key, "MemFree:") == 0) {
+            *free = value;
+        }
+    }
+
+    if (*total == -1 || *free == -1) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* account the N<node>=<pages> entries of one numa_maps line to its mapping type */
+static void add_numa_mapping(char *line, struct numa_memory *numa, long int page_size_kb) {
+    enum numa_mapping_type type = NUMA_MAPPING_ANON;
+    int nodes[NUMA_MAX_NODES];
+    long int pages[NUMA_MAX_NODES];
+    int node_count = 0;
+    int huge = 0;
+    char *token;
+    char *saveptr;
+    char *end;
+    long int node;
+    long int value;
+    int i;
+
+    /* the first token is the start address, the second one is the memory policy */
+    token = strtok_r(line, " \n", &saveptr);
+    while (token != NULL) {
+        if (token[0] == 'N' && isdigit((unsigned char)token[1])) {
+            node = strtol(token + 1, &end, 10);
+            if (*end == '=' && node < NUMA_MAX_NODES && node_count < NUMA_MAX_NODES) {
+                value = strtol(end + 1, NULL, 10);
+                nodes[node_count] = node;
+                pages[node_count] = value;
+                ++node_count;
+            }
+        } else if (strncmp(token, "kernelpagesize_kB=", 18) == 0) {
+            page_size_kb = strtol(token + 18, NULL, 10);
+        } else if (strcmp(token, "huge") == 0) {
+            huge = 1;
+        } else if (strcmp(token, "heap") == 0) {
+            type = NUMA_MAPPING_HEAP;
+        } else if (strcmp(token, "stack") == 0) {
+            type = NUMA_MAPPING_STACK;
+        } else if (strncmp(token, "file=", 5) == 0 && type == NUMA_MAPPING_ANON) {
+            type = NUMA_MAPPING_FILE;
+        }
+
+        token = strtok_r(NULL, " \n", &saveptr);
+    }
+
+    /* hugetlbfs mappings are file mappings as well */
+    if (huge) {
+        type = NUMA_MAPPING_HUGE;
+    }
+
+    /* kernelpagesize_kB follows the node entries */
+    for (i = 0; i < node_count; ++i) {
+        numa->nodes[nodes[i]].process[type] += pages[i] * page_size_kb;
+        numa->nodes[nodes[i]].process_total += pages[i] * page_size_kb;
+    }
+}
+
+int get_numa_memory(pid_t pid, struct numa_memory *numa) {
+    char numa_maps_path[PATH_MAX];
+    char node_list_path[PATH_MAX];
+    char *numa_maps_buffer;
+    char *node_list_buffer;
+    char line[PATH_MAX + 256];
+    int online_nodes[NUMA_MAX_NODES];
+    int online_count = 0;
+    long int page_size_kb;
+    int i;
+
+    memset(numa, 0, sizeof(struct numa_memory));
+
+    for (i = 0; i < NUMA_MAX_NODES; ++i) {
+        numa->nodes[i].total = -1;
+        numa->nodes[i].free = -1;
+    }
+
+    /* nodes without memory of the process are reported as well, a bound process may exhaust only one of them */
+    if (snprintf(node_list_path, sizeof(node_list_path), "%s/online", NUMA_NODE_PATH) >= 0) {
+        node_list_buffer = read_procfs_file(node_list_path, NULL);
+        if (node_list_buffer != NULL) {
+            online_count = parse_numa_node_list(node_list_buffer, online_nodes);
+        }
+    }
+
+    if (online_count < 0) {
+        fprintf(stderr, "WARNING: failed to parse the online NUMA node list\n");
+        online_count = 0;
+    }
+
+    for (i = 0; i < online_count; ++i) {
+        numa->nodes[online_nodes[i]].online = 1;
+
+        if (get_numa_node_meminfo(online_nodes[i], &numa->nodes[online_nodes[i]].total, &numa->nodes[online_nodes[i]].free) < 0) {
+            fprintf(stderr, "WARNING: failed to get memory information of NUMA node %d\n", online_nodes[i]);
+        }
+    }
+
+    pthread_mutex_lock(&numa_nodes_mutex);
+    memcpy(numa_online_nodes, online_nodes, online_count * sizeof(int));
+    numa_online_count = online_count;
+    pthread_mutex_unlock(&numa_nodes_mutex);
+
+    /* construct /proc/pid/numa_maps file path name */
+    if (snprintf(numa_maps_path, sizeof(numa_maps_path), "/proc/%d/numa_maps", pid) < 0) {
+        return -1;
+    }
+
+    /* the pages of each mapping are counted by the kernel while the file is read, it is parsed in one pass */
+    numa_maps_buffer = read_procfs_file(numa_maps_path, NULL);
+    if (numa_maps_buffer == NULL) {
+        return -1;
+    }
+
+    page_size_kb = sysconf(_SC_PAGESIZE) / 1024;
+
+    while (procfs_getline(line, sizeof(line), &numa_maps_buffer) != NULL) {
+        add_numa_mapping(line, numa, page_size_kb);
+    }
+
+    numa->loaded = 1;
+
+    return 0;
+}
+
+/* used memory of a node, (MemTotal - MemFree) in percentage of MemTotal, -1 if its meminfo is not available */
+static int get_numa_node_pressure(struct numa_node_memory *node) {
+    if (node->total <= 0 || node->free < 0) {
+        return -1;
+    }
+
+    return (int)((float)(node->total - node->free) / (float)node->total * 100);
+}
+
+/*
+ * the highest usage among the nodes which hold memory of the process, -1 if none of them has meminfo. the pages of other
+ * processes and the page cache count as well, the process fails to allocate on a node no matter who has filled it
+ */
+int get_numa_pressure(struct numa_memory *numa, int *pressure_node) {
+    int pressure = -1;
+    int node_pressure;
+    int i;
+
+    *pressure_node = -1;
+
+    for (i = 0; i < NUMA_MAX_NODES; ++i) {
+        if (numa->nodes[i].process_total == 0) {
+            continue;
+        }
+
+        node_pressure = get_numa_node_pressure(&numa->nodes[i]);
+        if (node_pressure > pressure) {
+            pressure = node_pressure;
+            *pressure_node = i;
+        }
+    }
+
+    return pressure;
+}
+
+void add_numa_batch_files(struct procfs_batch *batch, pid_t pid) {
+    char path[PATH_MAX];
+    int i;
+
+    /* in the order they are consumed: online nodes, meminfo of each node of the previous cycle, numa_maps */
+    if (snprintf(path, sizeof(path), "%s/online", NUMA_NODE_PATH) >= 0) {
+        procfs_batch_add(batch, path);
+    }
+
+    pthread_mutex_lock(&numa_nodes_mutex);
+    for (i = 0; i < numa_online_count; ++i) {
+        if (snprintf(path, sizeof(path), "%s/node%d/meminfo", NUMA_NODE_PATH, numa_online_nodes[i]) >= 0) {
+            procfs_batch_add(batch, path);
+        }
+    }
+    pthread_mutex_unlock(&numa_nodes_mutex);
+
+    if (snprintf(path, sizeof(path), "/proc/%d/numa_maps", pid) >= 0) {
+        procfs_batch_add(batch, path);
+    }
+}
+
+static void print_numa_value(long int value) {
+    if (value < 0) {
+        fprintf(report_output, "%-15s  ", "n/a");
+    } else {
+        fprintf(report_output, "%-12ld kB  ", value);
+    }
+}
+
+void get_numa_memory_report(struct numa_memory *numa) {
+    struct numa_node_memory *node;
+    int pressure;
+    int pressure_node;
+    int i;
+    int j;
+
+    fprintf(report_output, "%-6s%-17s%-17s%-17s", "NODE", "MEM TOTAL", "MEM FREE", "PROCESS");
+    for (i = 0; i < NUMA_MAPPING_TYPE_COUNT; ++i) {
+        fprintf(report_output, "%-17s", numa_mapping_type_names[i]);
+    }
+    fprintf(report_output, "%s\n", "PRESSURE");
+
+    for (i = 0; i < NUMA_MAX_NODES; ++i) {
+        node = &numa->nodes[i];
+
+        if (!node->online && node->process_total == 0) {
+            continue;
+        }
+
+        fprintf(report_output, "%-6d", i);
+        print_numa_value(node->total);
+        print_numa_value(node->free);
+        print_numa_value(node->process_total);
+        for (j = 0; j < NUMA_MAPPING_TYPE_COUNT; ++j) {
+            print_numa_value(node->process[j]);
+        }
+
+        if (get_numa_node_pressure(node) >= 0) {
+            fprintf(report_output, "%d%%\n", get_numa_node_pressure(node));
+        } else {
+            fprintf(report_output, "n/a\n");
+        }
+    }
+
+    pressure = get_numa_pressure(numa, &pressure_node);
+    if (pressure >= 0) {
+        fprintf(report_output, "NUMA Memory Pressure: %d%% (node %d)\n", pressure, pressure_node);
+    }
+    fflush(report_output);
+}
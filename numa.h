@@ -0,0 +1,39 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <sys/types.h>
+#include "procfs.h"
+
+#define NUMA_NODE_PATH "/sys/devices/system/node"
+#define NUMA_MAX_NODES 64 /* node IDs beyond this are not reported */
+
+/* mapping types of /proc/pid/numa_maps, pages of a mapping are accounted to exactly one of them */
+enum numa_mapping_type {
+    NUMA_MAPPING_ANON,
+    NUMA_MAPPING_HEAP,
+    NUMA_MAPPING_STACK,
+    NUMA_MAPPING_FILE,
+    NUMA_MAPPING_HUGE, /* hugetlbfs */
+    NUMA_MAPPING_TYPE_COUNT
+};
+
+struct numa_node_memory {
+    int online; /* 1 if the node is listed in the online node list */
+    long int total; /* unit: kB, MemTotal of the node, -1 if it is not available */
+    long int free; /* unit: kB, MemFree of the node, -1 if it is not available */
+    long int process_total; /* unit: kB, pages of the process on the node */
+    long int process[NUMA_MAPPING_TYPE_COUNT]; /* unit: kB */
+};
+
+/* memory of the target process per NUMA node, indexed by node ID */
+struct numa_memory {
+    int loaded; /* 1 once /proc/pid/numa_maps is parsed */
+    struct numa_node_memory nodes[NUMA_MAX_NODES];
+};
+
+extern int get_numa_memory(pid_t pid, struct numa_memory *numa);
+extern int get_numa_pressure(struct numa_memory *numa, int *pressure_node);
+extern void add_numa_batch_files(struct procfs_batch *batch, pid_t pid);
+extern void get_numa_memory_report(struct numa_memory *numa);
+
+#endif /* NUMA_H */
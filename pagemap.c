@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include "pagemap.h"
+#include "procfs.h"
+#include "process.h"
+#include "utils.h"
+
+/* reusable pread() buffer of pagemap entries */
+static uint64_t pagemap_entries[PAGEMAP_BATCH_ENTRIES];
+
+/* the address where the previous cycle ran out of budget, the next cycle continues from there */
+static pid_t pagemap_resume_pid = 0;
+static unsigned long pagemap_resume_address = 0;
+
+/* only anonymous memory is scanned: [heap], [stack] and unnamed private mappings */
+static int is_pagemap_candidate(struct mapping *mapping) {
+    if (mapping->file_inode != 0) {
+        return 0;
+    }
+
+    if (mapping->file_pathname[0] == '\0' || strcmp(mapping->file_pathname, "[heap]") == 0 || strcmp(mapping->file_pathname, "[stack]") == 0) {
+        return 1;
+    }
+
+    return 0;
+}
+
+/* scale sampled page counts to the walked part of the range */
+static unsigned long estimate_pages(unsigned long pages, struct pagemap_stats *stats) {
+    if (stats->scanned_pages == 0) {
+        return 0;
+    }
+
+    return (unsigned long)((double)pages * stats->covered_pages / stats->scanned_pages);
+}
+
+int scan_pagemap_range(int pagemap_fd, int kpageflags_fd, unsigned long start_address, unsigned long end_address, long stride, unsigned long *budget, struct pagemap_stats *stats) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    unsigned long page_index = start_address / page_size;
+    unsigned long end_index = end_address / page_size;
+    unsigned long thp_pages_per_huge_page = PAGEMAP_THP_SIZE / page_size;
+    unsigned long thp_end_index = 0;
+
+    unsigned long chunk;
+    unsigned long advance;
+    unsigned long entries;
+    unsigned long i;
+
+    uint64_t entry;
+    uint64_t page_flags;
+
+    ssize_t ret_pread;
+
+    while (page_index < end_index) {
+        if (*budget == 0) {
+            return 1;
+        }
+
+        /* a sample window of the range if stride is used, otherwise as much as the buffer holds */
+        chunk = end_index - page_index;
+        if (stride > 1 && chunk > PAGEMAP_SAMPLE_WINDOW) {
+            chunk = PAGEMAP_SAMPLE_WINDOW;
+        }
+        if (chunk > PAGEMAP_BATCH_ENTRIES) {
+            chunk = PAGEMAP_BATCH_ENTRIES;
+        }
+        if (chunk > *budget) {
+            chunk = *budget;
+        }
+
+        ret_pread = pread(pagemap_fd, pagemap_entries, chunk * sizeof(uint64_t), page_index * sizeof(uint64_t));
+        if (ret_pread < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        entries = ret_pread / sizeof(uint64_t);
+        if (entries == 0) {
+            return -1;
+        }
+
+        for (i = 0; i < entries; ++i) {
+            entry = pagemap_entries[i];
+
+            if (entry & PAGEMAP_SOFT_DIRTY) {
+                ++stats->soft_dirty_pages;
+            }
+
+            if (entry & PAGEMAP_SWAPPED) {
+                ++stats->swapped_pages;
+                continue;
+            }
+
+            if (!(entry & PAGEMAP_PRESENT)) {
+                continue;
+            }
+
+            ++stats->present_pages;
+
+            /* a huge page is detected on its aligned head page, PFNs are only visible with CAP_SYS_ADMIN */
+            if (kpageflags_fd >= 0 && page_index + i >= thp_end_index && (page_index + i) % thp_pages_per_huge_page == 0 && (entry & PAGEMAP_PFN_MASK) != 0) {
+                if (pread(kpageflags_fd, &page_flags, sizeof(page_flags), (entry & PAGEMAP_PFN_MASK) * sizeof(uint64_t)) == sizeof(page_flags) && (page_flags & KPAGEFLAGS_THP)) {
+                    thp_end_index = page_index + i + thp_pages_per_huge_page;
+                }
+            }
+
+            if (page_index + i < thp_end_index) {
+                ++stats->thp_pages;
+            }
+        }
+
+        stats->scanned_pages += entries;
+        *budget -= entries;
+
+        /* skip the rest of the stride only after a full sample window */
+        advance = entries;
+        if (stride > 1 && entries == PAGEMAP_SAMPLE_WINDOW) {
+            advance = PAGEMAP_SAMPLE_WINDOW * stride;
+            if (advance > end_index - page_index) {
+                advance = end_index - page_index;
+            }
+        }
+
+        stats->covered_pages += advance;
+        page_index += advance;
+    }
+
+    return 0;
+}
+
+void get_pagemap_usage(pid_t pid, long stride, long budget) {
+    char *process_memory_mapping_buffer;
+    process_memory_mapping_buffer = NULL;
+
+    char process_memory_mapping_file_path[PATH_MAX];
+    char process_pagemap_file_path[PATH_MAX];
+
+    int pagemap_fd;
+    int kpageflags_fd;
+
+    int ret_snprintf;
+    int ret_scan_pagemap_range;
+
+    char line[BUFSIZ];
+
+    struct mapping mapping;
+    struct pagemap_stats stats;
+
+    long page_size = sysconf(_SC_PAGESIZE);
+    unsigned long remaining_budget = budget;
+    unsigned long scan_start_address;
+    unsigned long resume_address = 0;
+
+    /* start over if the target process has changed */
+    if (pagemap_resume_pid != pid) {
+        pagemap_resume_pid = pid;
+        pagemap_resume_address = 0;
+    }
+
+    /* construct process memory mapping and pagemap file paths based on pid */
+    ret_snprintf = snprintf(process_memory_mapping_file_path, sizeof(process_memory_mapping_file_path), "/proc/%d/maps", pid);
+    if (ret_snprintf < 0) {
+        fprintf(stderr, "ERROR: failed to construct the PID %d memory mapping file name\n", pid);
+        return;
+    }
+
+    ret_snprintf = snprintf(process_pagemap_file_path, sizeof(process_pagemap_file_path), "/proc/%d/pagemap", pid);
+    if (ret_snprintf < 0) {
+        fprintf(stderr, "ERROR: failed to construct the PID %d pagemap file name\n", pid);
+        return;
+    }
+
+    process_memory_mapping_buffer = read_procfs_file(process_memory_mapping_file_path, NULL);
+    if (process_memory_mapping_buffer == NULL) {
+        fprintf(stderr, "ERROR: failed to open the PID %d memory mapping file: %s\n", pid, process_memory_mapping_file_path);
+        return;
+    }
+
+    pagemap_fd = open(process_pagemap_file_path, O_RDONLY);
+    if (pagemap_fd < 0) {
+        fprintf(stderr, "ERROR: failed to open the PID %d pagemap file: %s\n", pid, strerror(errno));
+        return;
+    }
+
+    /* THP detection is optional since /proc/kpageflags is only readable by root */
+    kpageflags_fd = open("/proc/kpageflags", O_RDONLY);
+
+    /* print header */
+    fprintf(report_output, "%-16s  %-15s     %-10s %-10s %-10s %-10s %-10s %s\n", "START ADDRESS", "SIZE", "SCANNED", "PRESENT", "SWAPPED", "THP", "SOFT-DIRTY", "FILE PATH");
+    fflush(report_output);
+
+    while (procfs_getline(line, sizeof(line), &process_memory_mapping_buffer) != NULL) {
+        if (parse_memory_mapping(line, &mapping) < 0) {
+            continue;
+        }
+
+        if (!is_pagemap_candidate(&mapping) || mapping.end_address <= pagemap_resume_address) {
+            continue;
+        }
+
+        scan_start_address = mapping.start_address;
+        if (scan_start_address < pagemap_resume_address) {
+            scan_start_address = pagemap_resume_address;
+        }
+
+        memset(&stats, 0, sizeof(stats));
+
+        ret_scan_pagemap_range = scan_pagemap_range(pagemap_fd, kpageflags_fd, scan_start_address, mapping.end_address, stride, &remaining_budget, &stats);
+        if (ret_scan_pagemap_range < 0) {
+            fprintf(stderr, "WARNING: failed to read the PID %d pagemap at %016lx\n", pid, scan_start_address);
+            continue;
+        }
+
+        /* print page counts, estimated from the samples if stride is used */
+        if (stats.scanned_pages > 0) {
+            if (kpageflags_fd >= 0) {
+                fprintf(report_output, "%016lx  %-15lu kB  %-10lu %-10lu %-10lu %-10lu %-10lu %s\n", mapping.start_address, (mapping.end_address - mapping.start_address) / 1024, stats.scanned_pages, estimate_pages(stats.present_pages, &stats), estimate_pages(stats.swapped_pages, &stats), estimate_pages(stats.thp_pages, &stats), estimate_pages(stats.soft_dirty_pages, &stats), mapping.file_pathname);
+            } else {
+                fprintf(report_output, "%016lx  %-15lu kB  %-10lu %-10lu %-10lu %-10s %-10lu %s\n", mapping.start_address, (mapping.end_address - mapping.start_address) / 1024, stats.scanned_pages, estimate_pages(stats.present_pages, &stats), estimate_pages(stats.swapped_pages, &stats), "n/a", estimate_pages(stats.soft_dirty_pages, &stats), mapping.file_pathname);
+            }
+            fflush(report_output);
+        }
+
+        /* remember where to continue once the budget is used up */
+        if (ret_scan_pagemap_range == 1) {
+            resume_address = scan_start_address + stats.covered_pages * page_size;
+            break;
+        }
+    }
+
+    pagemap_resume_address = resume_address;
+
+    if (resume_address != 0) {
+        fprintf(report_output, "Pagemap scan budget of %ld pages is used up, next cycle resumes at %016lx\n", budget, resume_address);
+        fflush(report_output);
+    }
+
+    if (kpageflags_fd >= 0) {
+        close(kpageflags_fd);
+    }
+
+    close(pagemap_fd);
+}
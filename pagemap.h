@@ -0,0 +1,34 @@
+#ifndef PAGEMAP_H
+#define PAGEMAP_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define PAGEMAP_DEFAULT_STRIDE 1
+#define PAGEMAP_DEFAULT_BUDGET 262144 /* unit: pages per cycle */
+#define PAGEMAP_BATCH_ENTRIES 4096 /* pagemap entries read by one pread() */
+#define PAGEMAP_SAMPLE_WINDOW 512 /* contiguous pages read per sample when stride > 1 */
+#define PAGEMAP_THP_SIZE (2 * 1024 * 1024)
+
+/* bits of a /proc/pid/pagemap entry */
+#define PAGEMAP_PFN_MASK ((UINT64_C(1) << 55) - 1)
+#define PAGEMAP_SOFT_DIRTY (UINT64_C(1) << 55)
+#define PAGEMAP_SWAPPED (UINT64_C(1) << 62)
+#define PAGEMAP_PRESENT (UINT64_C(1) << 63)
+
+/* bit of a /proc/kpageflags entry */
+#define KPAGEFLAGS_THP (UINT64_C(1) << 22)
+
+struct pagemap_stats {
+    unsigned long covered_pages; /* pages of the range walked, including pages skipped by the stride */
+    unsigned long scanned_pages; /* pagemap entries actually read */
+    unsigned long present_pages;
+    unsigned long swapped_pages;
+    unsigned long thp_pages;
+    unsigned long soft_dirty_pages;
+};
+
+extern int scan_pagemap_range(int pagemap_fd, int kpageflags_fd, unsigned long start_address, unsigned long end_address, long stride, unsigned long *budget, struct pagemap_stats *stats);
+extern void get_pagemap_usage(pid_t pid, long stride, long budget);
+
+#endif /* PAGEMAP_H */
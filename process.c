@@ -2,13 +2,39 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <limits.h>
+#include <pthread.h>
 #include <string.h>
 #include <unistd.h>
+#include "procfs.h"
 #include "process.h"
 #include "network.h"
+#include "utils.h"
+
+/* ancestors found by the last process tree walk, they are prefetched in the next cycle's batch */
+static pid_t process_tree_pids[PROCESS_TREE_MAX_DEPTH];
+static int process_tree_refresh[PROCESS_TREE_MAX_DEPTH]; /* 1 if the memory figures are read in the next walk */
+static int process_tree_depth = 0;
+
+/* an ancestor of the last walk, identified by its PID and start time, used by the walking thread only */
+struct ancestor_cache_entry {
+    struct ancestor ancestor;
+    unsigned long long start_time;
+    long int age; /* walks since the memory figures were read */
+};
+
+static struct ancestor_cache_entry ancestor_cache[PROCESS_TREE_MAX_DEPTH];
+static int ancestor_cache_count = 0;
+static long int process_tree_refresh_cycles = PROCESS_TREE_DEFAULT_REFRESH;
+static struct process_tree_cache_stats process_tree_cache_stats;
+
+/* the tree is walked by the render thread and prefetched by the capture thread */
+static pthread_mutex_t process_tree_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 int check_pid(pid_t pid) {
     int ret_kill;
@@ -24,13 +50,13 @@ int check_pid(pid_t pid) {
 }
 
 int get_ppid(pid_t pid, int *ppid, char *exe_name) {
-    FILE *pid_stat_file;
-    pid_stat_file = NULL;
+    char *pid_stat_buffer;
+    pid_stat_buffer = NULL;
     char pid_stat_path[PATH_MAX];
     char *stat_format = "%*d %s %*s %d";
 
     int ret_snprintf;
-    int ret_fscanf;
+    int ret_sscanf;
 
     /* construct /proc/pid/stat file path name */
     ret_snprintf = snprintf(pid_stat_path, sizeof(pid_stat_path), "/proc/%d/stat", pid);
@@ -39,20 +65,17 @@ int get_ppid(pid_t pid, int *ppid, char *exe_name) {
     }
 
     /* get parent PID */
-    pid_stat_file = fopen(pid_stat_path, "r");
-    if (pid_stat_file == NULL) {
+    pid_stat_buffer = read_procfs_file(pid_stat_path, NULL);
+    if (pid_stat_buffer == NULL) {
         return -1;
     }
 
-    ret_fscanf = fscanf(pid_stat_file, stat_format, exe_name, ppid);
+    ret_sscanf = sscanf(pid_stat_buffer, stat_format, exe_name, ppid);
 
-    if (ret_fscanf < 2 || ret_fscanf == EOF) {
-        fclose(pid_stat_file);
+    if (ret_sscanf < 2 || ret_sscanf == EOF) {
         return -1;
     }
 
-    fclose(pid_stat_file);
-
     return 0;
 }
 
@@ -85,32 +108,145 @@ handle_error:
     return NULL;
 }
 
-int compare_pid_exe(pid_t pid, char *exe_name) {
-    int ret_strcmp;
-    char *exe_name_realpath;
-    exe_name_realpath = get_exe_path_name(pid);
+int get_exe_identity(char *exe_name, struct exe_identity *identity) {
+    struct stat exe_stat;
 
-    if (exe_name_realpath == NULL) {
+    if (stat(exe_name, &exe_stat) < 0) {
         return -1;
     }
 
-    /* compare executable absolute path and executable real path */
-    ret_strcmp = strcmp(exe_name, exe_name_realpath);
-    free(exe_name_realpath);
-    exe_name_realpath = NULL;
+    identity->dev = exe_stat.st_dev;
+    identity->inode = exe_stat.st_ino;
 
-    if (ret_strcmp == 0) {
+    return 0;
+}
+
+int compare_pid_exe(pid_t pid, struct exe_identity *identity) {
+    char exe_name_path[PATH_MAX];
+    struct stat exe_stat;
+    int ret_snprintf;
+
+    /* construct /proc/pid/exe file path name */
+    ret_snprintf = snprintf(exe_name_path, sizeof(exe_name_path), "/proc/%d/exe", pid);
+    if (ret_snprintf < 0) {
+        return -1;
+    }
+
+    /* stat() follows the link to the executable itself, no path resolution is needed */
+    if (stat(exe_name_path, &exe_stat) < 0) {
+        return -1;
+    }
+
+    if (exe_stat.st_dev == identity->dev && exe_stat.st_ino == identity->inode) {
         return 0;
     } else {
         return -1;
     }
 }
 
+/* the comm, the parent PID and the 22nd field(start time) of /proc/pid/stat with one read, the comm field may contain spaces and parentheses */
+static int get_process_stat(pid_t pid, pid_t *ppid, char *exe_name, size_t exe_name_size, unsigned long long *start_time) {
+    char *pid_stat_buffer;
+    char pid_stat_path[PATH_MAX];
+    char *comm_start;
+    char *stat_fields;
+    int ret_snprintf;
+    int ret_sscanf;
+
+    ret_snprintf = snprintf(pid_stat_path, sizeof(pid_stat_path), "/proc/%d/stat", pid);
+    if (ret_snprintf < 0) {
+        return -1;
+    }
+
+    pid_stat_buffer = read_procfs_file(pid_stat_path, NULL);
+    if (pid_stat_buffer == NULL) {
+        return -1;
+    }
+
+    comm_start = strchr(pid_stat_buffer, '(');
+    stat_fields = strrchr(pid_stat_buffer, ')');
+    if (comm_start == NULL || stat_fields == NULL) {
+        return -1;
+    }
+
+    /* the comm is kept with its parentheses like get_ppid() */
+    if (exe_name != NULL) {
+        snprintf(exe_name, exe_name_size, "%.*s", (int)(stat_fields - comm_start + 1), comm_start);
+    }
+
+    /* the 3rd field(state) is the first one after the comm */
+    ret_sscanf = sscanf(stat_fields + 1, "%*s %d %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %llu", ppid, start_time);
+
+    if (ret_sscanf < 2 || ret_sscanf == EOF) {
+        return -1;
+    }
+
+    return 0;
+}
+
+pid_t find_pid_by_exe(struct exe_identity *identity) {
+    char dirent_buffer[PROCESS_DISCOVERY_BUFFER_SIZE];
+    struct linux_dirent64 *dirent;
+    struct stat exe_stat;
+    char exe_name_path[NAME_MAX + sizeof("/exe")];
+    unsigned long long start_time;
+    unsigned long long oldest_start_time = 0;
+    pid_t oldest_pid = 0;
+    pid_t ppid;
+    pid_t pid;
+    long dirent_length;
+    long offset;
+    int proc_fd;
+
+    proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (proc_fd < 0) {
+        return -1;
+    }
+
+    /* getdents64() returns many entries per syscall without the allocations of readdir() */
+    while ((dirent_length = syscall(SYS_getdents64, proc_fd, dirent_buffer, sizeof(dirent_buffer))) > 0) {
+        for (offset = 0; offset < dirent_length; offset += dirent->d_reclen) {
+            dirent = (struct linux_dirent64 *)(dirent_buffer + offset);
+
+            /* only process directories are named with digits */
+            if (dirent->d_name[0] < '1' || dirent->d_name[0] > '9') {
+                continue;
+            }
+
+            snprintf(exe_name_path, sizeof(exe_name_path), "%s/exe", dirent->d_name);
+
+            /* kernel threads and processes of other users fail here and are skipped */
+            if (fstatat(proc_fd, exe_name_path, &exe_stat, 0) < 0) {
+                continue;
+            }
+
+            if (exe_stat.st_dev != identity->dev || exe_stat.st_ino != identity->inode) {
+                continue;
+            }
+
+            /* workers forked by the target share its executable, the oldest process is the one started by the supervisor */
+            pid = strtol(dirent->d_name, NULL, 10);
+            if (get_process_stat(pid, &ppid, NULL, 0, &start_time) < 0) {
+                continue;
+            }
+
+            if (oldest_pid == 0 || start_time < oldest_start_time) {
+                oldest_pid = pid;
+                oldest_start_time = start_time;
+            }
+        }
+    }
+
+    close(proc_fd);
+
+    return oldest_pid;
+}
+
 int get_oom_score(pid_t pid, int *oom_score, int *oom_score_adj) {
-    FILE *oom_score_file;
-    FILE *oom_score_adj_file;
-    oom_score_file = NULL;
-    oom_score_adj_file = NULL;
+    char *oom_score_buffer;
+    char *oom_score_adj_buffer;
+    oom_score_buffer = NULL;
+    oom_score_adj_buffer = NULL;
 
     char oom_score_file_path[PATH_MAX];
     char oom_score_adj_file_path[PATH_MAX];
@@ -133,60 +269,48 @@ int get_oom_score(pid_t pid, int *oom_score, int *oom_score_adj) {
     }
 
     /* read oom_score */
-    oom_score_file = fopen(oom_score_file_path, "r");
-    if (oom_score_file == NULL) {
+    oom_score_buffer = read_procfs_file(oom_score_file_path, NULL);
+    if (oom_score_buffer == NULL) {
         goto handle_error;
     }
 
-    if (fscanf(oom_score_file, "%d", oom_score) != 1) {
+    if (sscanf(oom_score_buffer, "%d", oom_score) != 1) {
         goto handle_error;
     }
 
     /* read oom_score_adj */
-    oom_score_adj_file = fopen(oom_score_adj_file_path, "r");
-    if (oom_score_adj_file == NULL) {
+    oom_score_adj_buffer = read_procfs_file(oom_score_adj_file_path, NULL);
+    if (oom_score_adj_buffer == NULL) {
         goto handle_error;
     }
 
-    if (fscanf(oom_score_adj_file, "%d", oom_score_adj) != 1) {
+    if (sscanf(oom_score_adj_buffer, "%d", oom_score_adj) != 1) {
         goto handle_error;
     }
 
-    /* close file handles */
-    fclose(oom_score_file);
-    fclose(oom_score_adj_file);
-
     return 0;
 
 /* error handling routine */
 handle_error:
-    if (oom_score_file != NULL) {
-        fclose(oom_score_file);
-    }
-
-    if (oom_score_adj_file != NULL) {
-        fclose(oom_score_adj_file);
-    }
-
     return -1;
 }
 
 int get_system_memory(long int *total_memory) {
     char *system_meminfo_filename = "/proc/meminfo";
-    FILE *system_meminfo_file;
-    system_meminfo_file = NULL;
+    char *system_meminfo_buffer;
+    system_meminfo_buffer = NULL;
 
     char line[BUFSIZ];
     char *toggle_str;
     *total_memory = -1;
 
-    system_meminfo_file = fopen(system_meminfo_filename, "r");
-    if (system_meminfo_file == NULL) {
+    system_meminfo_buffer = read_procfs_file(system_meminfo_filename, NULL);
+    if (system_meminfo_buffer == NULL) {
         return -1;
     }
 
     /* locate MemTotal string in /proc/meminfo file */
-    while (fgets(line, sizeof(line), system_meminfo_file) != NULL) {
+    while (procfs_getline(line, sizeof(line), &system_meminfo_buffer) != NULL) {
         if (strstr(line, "MemTotal:") != NULL) {
             /* skip ':' char */
             toggle_str = strchr(line, ':') + 1;
@@ -203,8 +327,6 @@ int get_system_memory(long int *total_memory) {
         }
     }
 
-    fclose(system_meminfo_file);
-
     /* if total_memory is not equal to -1, that means we have acquired total memory value. otherwise, return -1 as error */
     if (*total_memory != -1) {
         return 0;
@@ -214,8 +336,8 @@ int get_system_memory(long int *total_memory) {
 }
 
 int get_memory_usage(pid_t pid, long int *process_rss, long int *process_pss, long int *process_uss) {
-    FILE *process_smaps_rollup_file;
-    process_smaps_rollup_file = NULL;
+    char *process_smaps_rollup_buffer;
+    process_smaps_rollup_buffer = NULL;
 
     char process_smaps_rollup_file_path[PATH_MAX];
     int ret_snprintf;
@@ -239,13 +361,13 @@ int get_memory_usage(pid_t pid, long int *process_rss, long int *process_pss, lo
         return -1;
     }
 
-    process_smaps_rollup_file = fopen(process_smaps_rollup_file_path, "r");
-    if (process_smaps_rollup_file == NULL) {
+    process_smaps_rollup_buffer = read_procfs_file(process_smaps_rollup_file_path, NULL);
+    if (process_smaps_rollup_buffer == NULL) {
         return -1;
     }
 
     /* locate Rss / Pss / Private_* string in /proc/pid/smaps_rollup file */
-    while (fgets(line, sizeof(line), process_smaps_rollup_file) != NULL) {
+    while (procfs_getline(line, sizeof(line), &process_smaps_rollup_buffer) != NULL) {
         if (strstr(line, "Rss:") != NULL) {
             /* skip ':' char */
             toggle_str = strchr(line, ':') + 1;
@@ -309,8 +431,6 @@ int get_memory_usage(pid_t pid, long int *process_rss, long int *process_pss, lo
         }
     }
 
-    fclose(process_smaps_rollup_file);
-
     /* if neither of process_rss, process_pss and process_uss is not equal to -1, that means we have acquired process rss, pss and uss values. otherwise, return -1 as error */
     if (success_flag == 1) {
         /* calculate uss */
@@ -322,9 +442,44 @@ int get_memory_usage(pid_t pid, long int *process_rss, long int *process_pss, lo
     }
 }
 
+int get_statm_rss(pid_t pid, long int *process_rss) {
+    char *process_statm_buffer;
+    process_statm_buffer = NULL;
+
+    char process_statm_file_path[PATH_MAX];
+    int ret_snprintf;
+    int ret_sscanf;
+
+    long int resident_pages;
+
+    *process_rss = -1;
+
+    /* construct process statm file path based on pid */
+    ret_snprintf = snprintf(process_statm_file_path, sizeof(process_statm_file_path), "/proc/%d/statm", pid);
+    if (ret_snprintf < 0) {
+        return -1;
+    }
+
+    process_statm_buffer = read_procfs_file(process_statm_file_path, NULL);
+    if (process_statm_buffer == NULL) {
+        return -1;
+    }
+
+    /* statm is read from mm counters without walking page tables, the 2nd field is resident pages */
+    ret_sscanf = sscanf(process_statm_buffer, "%*s %ld", &resident_pages);
+
+    if (ret_sscanf < 1 || ret_sscanf == EOF) {
+        return -1;
+    }
+
+    *process_rss = resident_pages * (sysconf(_SC_PAGESIZE) / 1024);
+
+    return 0;
+}
+
 int get_page_tables_usage(pid_t pid, long int *process_page_tables_size) {
-    FILE *process_status_file;
-    process_status_file = NULL;
+    char *process_status_buffer;
+    process_status_buffer = NULL;
 
     char process_status_file_path[PATH_MAX];
     int ret_snprintf;
@@ -340,13 +495,13 @@ int get_page_tables_usage(pid_t pid, long int *process_page_tables_size) {
         return -1;
     }
 
-    process_status_file = fopen(process_status_file_path, "r");
-    if (process_status_file == NULL) {
+    process_status_buffer = read_procfs_file(process_status_file_path, NULL);
+    if (process_status_buffer == NULL) {
         return -1;
     }
 
     /* locate VmPTE string in /proc/pid/status file */
-    while (fgets(line, sizeof(line), process_status_file) != NULL) {
+    while (procfs_getline(line, sizeof(line), &process_status_buffer) != NULL) {
         if (strstr(line, "VmPTE:") != NULL) {
             /* skip ':' char */
             toggle_str = strchr(line, ':') + 1;
@@ -364,8 +519,6 @@ int get_page_tables_usage(pid_t pid, long int *process_page_tables_size) {
         }
     }
 
-    fclose(process_status_file);
-
     /* if process_page_tables_size is not equal to -1, that means we have acquired page tables size value. otherwise, return -1 as error */
     if (*process_page_tables_size != -1) {
         return 0;
@@ -374,49 +527,162 @@ int get_page_tables_usage(pid_t pid, long int *process_page_tables_size) {
     }
 }
 
-void get_process_tree(pid_t pid) {
+static struct ancestor_cache_entry *find_cached_ancestor(pid_t pid, unsigned long long start_time) {
+    int i;
+
+    for (i = 0; i < ancestor_cache_count; ++i) {
+        if (ancestor_cache[i].ancestor.pid == pid && ancestor_cache[i].start_time == start_time) {
+            return &ancestor_cache[i];
+        }
+    }
+
+    return NULL;
+}
+
+int collect_process_tree(pid_t pid, struct ancestor *ancestors, int max_count) {
     pid_t ppid;
     ppid = -1;
 
     pid_t tmp_pid;
-    int oom_score;
-    int oom_score_adj;
-    long int process_rss;
-    long int process_pss;
-    long int process_uss;
     char exe_name[BUFSIZ];
+    unsigned long long start_time;
+    struct ancestor *ancestor;
+    struct ancestor_cache_entry *cached;
+    long int age;
 
-    int ret_get_ppid;
+    struct ancestor_cache_entry entries[PROCESS_TREE_MAX_DEPTH];
+    pid_t tree_pids[PROCESS_TREE_MAX_DEPTH];
+    int tree_refresh[PROCESS_TREE_MAX_DEPTH];
+    int tree_depth = 0;
+    int count = 0;
+
+    int ret_get_process_stat;
 
     tmp_pid = pid;
 
-    while (ppid != 0) {
-        ret_get_ppid = get_ppid(tmp_pid, &ppid, exe_name);
-        if (ret_get_ppid < 0) {
+    /* ancestors beyond max_count are not collected */
+    while (ppid != 0 && count < max_count) {
+        /* one stat read identifies the process, a reused PID has another start time */
+        ret_get_process_stat = get_process_stat(tmp_pid, &ppid, exe_name, sizeof(exe_name), &start_time);
+        if (ret_get_process_stat < 0) {
             fprintf(stderr, "WARNING: failed to get parent PID of the PID %d\n", tmp_pid);
-            return;
+            break;
+        }
+
+        ancestor = &ancestors[count];
+
+        cached = find_cached_ancestor(tmp_pid, start_time);
+        if (cached != NULL) {
+            ++process_tree_cache_stats.hits;
+            *ancestor = cached->ancestor;
+            age = cached->age + 1;
+        } else {
+            ++process_tree_cache_stats.misses;
+            age = process_tree_refresh_cycles;
+        }
+
+        ancestor->pid = tmp_pid;
+        snprintf(ancestor->exe_name, sizeof(ancestor->exe_name), "%.*s", PROCESS_NAME_SIZE - 1, exe_name);
+
+        /* the memory figures of the ancestors are read on a slower cadence, the target is read in every walk */
+        if (count == 0 || age >= process_tree_refresh_cycles) {
+            ++process_tree_cache_stats.refreshes;
+            age = 0;
+
+            /* -1 marks the values which are not available */
+            ancestor->oom_score = -1;
+            ancestor->oom_score_adj = -1;
+            ancestor->process_rss = -1;
+            ancestor->process_pss = -1;
+            ancestor->process_uss = -1;
+
+            get_oom_score(tmp_pid, &ancestor->oom_score, &ancestor->oom_score_adj);
+            get_memory_usage(tmp_pid, &ancestor->process_rss, &ancestor->process_pss, &ancestor->process_uss);
         }
 
-        get_oom_score(tmp_pid, &oom_score, &oom_score_adj);
-        get_memory_usage(tmp_pid, &process_rss, &process_pss, &process_uss);
+        if (tree_depth < PROCESS_TREE_MAX_DEPTH) {
+            entries[tree_depth].ancestor = *ancestor;
+            entries[tree_depth].start_time = start_time;
+            entries[tree_depth].age = age;
 
-        /* print process tree in reverse order */
-        printf("%d %s - OOM score: %d - OOM adjustment score: %d - RSS: %ld kB - PSS: %ld kB - USS: %ld kB\n", tmp_pid, exe_name, oom_score, oom_score_adj, process_rss, process_pss, process_uss);
+            tree_pids[tree_depth] = tmp_pid;
+            tree_refresh[tree_depth] = count == 0 || age + 1 >= process_tree_refresh_cycles;
+            ++tree_depth;
+        }
 
+        ++count;
         tmp_pid = ppid;
     }
+
+    memcpy(ancestor_cache, entries, tree_depth * sizeof(struct ancestor_cache_entry));
+    ancestor_cache_count = tree_depth;
+
+    pthread_mutex_lock(&process_tree_mutex);
+    memcpy(process_tree_pids, tree_pids, tree_depth * sizeof(pid_t));
+    memcpy(process_tree_refresh, tree_refresh, tree_depth * sizeof(int));
+    process_tree_depth = tree_depth;
+    pthread_mutex_unlock(&process_tree_mutex);
+
+    return count;
 }
 
-void get_memory_mapping(pid_t pid) {
-    FILE *process_memory_mapping_file;
-    process_memory_mapping_file = NULL;
+void set_process_tree_refresh(long int refresh_cycles) {
+    process_tree_refresh_cycles = refresh_cycles > 0 ? refresh_cycles : 1;
+}
 
-    char process_memory_mapping_file_path[PATH_MAX];
+void get_process_tree_cache_stats(struct process_tree_cache_stats *stats) {
+    *stats = process_tree_cache_stats;
+}
 
-    int ret_sscanf;
-    int ret_snprintf;
+static void add_process_batch_file(struct procfs_batch *batch, pid_t pid, char *name) {
+    char path[PATH_MAX];
 
-    char line[BUFSIZ];
+    if (snprintf(path, sizeof(path), "/proc/%d/%s", pid, name) < 0) {
+        return;
+    }
+
+    procfs_batch_add(batch, path);
+}
+
+void add_process_batch_files(struct procfs_batch *batch, pid_t pid) {
+    char path[PATH_MAX];
+    int i;
+
+    /* in the order they are consumed: memory, page tables, OOM score, tree and mappings */
+    add_process_batch_file(batch, pid, "smaps_rollup");
+    add_process_batch_file(batch, pid, "status");
+    add_process_batch_file(batch, pid, "oom_score");
+    add_process_batch_file(batch, pid, "oom_score_adj");
+
+    /* the ancestor chain of the previous cycle, a changed chain falls back to blocking reads */
+    pthread_mutex_lock(&process_tree_mutex);
+    if (process_tree_depth == 0 || process_tree_pids[0] != pid) {
+        add_process_batch_file(batch, pid, "stat");
+    } else {
+        /* a cached ancestor only needs its stat until its memory figures are due */
+        for (i = 0; i < process_tree_depth; ++i) {
+            add_process_batch_file(batch, process_tree_pids[i], "stat");
+            if (!process_tree_refresh[i]) {
+                continue;
+            }
+
+            add_process_batch_file(batch, process_tree_pids[i], "oom_score");
+            add_process_batch_file(batch, process_tree_pids[i], "oom_score_adj");
+            add_process_batch_file(batch, process_tree_pids[i], "smaps_rollup");
+        }
+    }
+    pthread_mutex_unlock(&process_tree_mutex);
+
+    /* socket inodes of the network connection section */
+    if (snprintf(path, sizeof(path), "/proc/%d/fd", pid) >= 0) {
+        procfs_batch_add_links(batch, path);
+    }
+
+    add_process_batch_file(batch, pid, "maps");
+}
+
+int parse_memory_mapping(char *line, struct mapping *mapping) {
+    int ret_sscanf;
 
     /* define reading format of /proc/pid/maps file */
     char *format = "%lx-%lx %4s %lx %5s %ld %s";
@@ -431,160 +697,308 @@ void get_memory_mapping(pid_t pid) {
      * 6th: mapping file inode (ld)
      * 7th: mapping file pathname (s)
      */
-    long int start_address;
-    long int end_address;
-    char permission_bits[5];
-    long int offset;
-    char dev[6];
-    long int file_inode;
 
-    char file_pathname[PATH_MAX];
+    /* it is possible that pathname field is empty, set file_pathname as an empty string first as placeholder */
+    mapping->file_pathname[0] = '\0';
+
+    /* read fields from each mapping */
+    ret_sscanf = sscanf(line, format, &mapping->start_address, &mapping->end_address, mapping->permission_bits, &mapping->offset, mapping->dev, &mapping->file_inode, mapping->file_pathname);
+    if (ret_sscanf < 6 || ret_sscanf == EOF) {
+        return -1;
+    }
 
-    /* define memory usage footprint for each mapping */
-    long int size;
+    return 0;
+}
+
+/* append a path to the arena of the list, the arena only grows like the array of the mappings */
+static int add_mapping_path(struct mapping_list *mapping_list, const char *path, size_t path_length) {
+    char *new_paths;
+    size_t new_capacity;
+
+    if (mapping_list->paths_length + path_length + 1 > mapping_list->paths_capacity) {
+        new_capacity = mapping_list->paths_capacity > 0 ? mapping_list->paths_capacity * 2 : MAPPING_PATHS_INITIAL_CAPACITY;
+        while (new_capacity < mapping_list->paths_length + path_length + 1) {
+            new_capacity *= 2;
+        }
+
+        new_paths = (char *)realloc(mapping_list->paths, new_capacity);
+        if (new_paths == NULL) {
+            return -1;
+        }
+
+        mapping_list->paths = new_paths;
+        mapping_list->paths_capacity = new_capacity;
+    }
+
+    memcpy(mapping_list->paths + mapping_list->paths_length, path, path_length + 1);
+    mapping_list->paths_length += path_length + 1;
+
+    return 0;
+}
+
+int collect_memory_mappings(pid_t pid, struct mapping_list *mapping_list) {
+    char *process_memory_mapping_buffer;
+    process_memory_mapping_buffer = NULL;
+
+    char process_memory_mapping_file_path[PATH_MAX];
+
+    int ret_snprintf;
+
+    char line[BUFSIZ];
+
+    struct mapping mapping;
+    struct mapping_entry *entry;
+    struct mapping_entry *new_mappings;
+    size_t new_capacity;
+    size_t path_length;
+
+    mapping_list->count = 0;
+    mapping_list->paths_length = 0;
 
     /* construct process memory mapping file path based on pid */
     ret_snprintf = snprintf(process_memory_mapping_file_path, sizeof(process_memory_mapping_file_path), "/proc/%d/maps", pid);
     if (ret_snprintf < 0) {
         fprintf(stderr, "ERROR: failed to construct the PID %d memory mapping file name\n", pid);
-        return;
+        return -1;
     }
 
-    process_memory_mapping_file = fopen(process_memory_mapping_file_path, "r");
-    if (process_memory_mapping_file == NULL) {
+    process_memory_mapping_buffer = read_procfs_file(process_memory_mapping_file_path, NULL);
+    if (process_memory_mapping_buffer == NULL) {
         fprintf(stderr, "ERROR: failed to open the PID %d memory mapping file: %s\n", pid, process_memory_mapping_file_path);
-        return;
+        return -1;
+    }
+
+    while (procfs_getline(line, sizeof(line), &process_memory_mapping_buffer) != NULL) {
+        if (parse_memory_mapping(line, &mapping) < 0) {
+            continue;
+        }
+
+        /* the array only grows, the next collections reuse it */
+        if (mapping_list->count == mapping_list->capacity) {
+            new_capacity = mapping_list->capacity > 0 ? mapping_list->capacity * 2 : MAPPING_LIST_INITIAL_CAPACITY;
+            new_mappings = (struct mapping_entry *)realloc(mapping_list->mappings, new_capacity * sizeof(struct mapping_entry));
+            if (new_mappings == NULL) {
+                fprintf(stderr, "ERROR: failed to allocate memory for the PID %d memory mappings\n", pid);
+                return -1;
+            }
+
+            mapping_list->mappings = new_mappings;
+            mapping_list->capacity = new_capacity;
+        }
+
+        entry = &mapping_list->mappings[mapping_list->count];
+        path_length = strlen(mapping.file_pathname);
+        entry->path_offset = mapping_list->paths_length;
+        entry->path_length = path_length;
+
+        if (add_mapping_path(mapping_list, mapping.file_pathname, path_length) < 0) {
+            fprintf(stderr, "ERROR: failed to allocate memory for the PID %d memory mapping paths\n", pid);
+            return -1;
+        }
+
+        entry->start_address = mapping.start_address;
+        entry->end_address = mapping.end_address;
+        memcpy(entry->permission_bits, mapping.permission_bits, sizeof(entry->permission_bits));
+        memcpy(entry->dev, mapping.dev, sizeof(entry->dev));
+        entry->offset = mapping.offset;
+        entry->file_inode = mapping.file_inode;
+
+        ++mapping_list->count;
+    }
+
+    return 0;
+}
+
+const char *get_mapping_path(const struct mapping_list *mapping_list, const struct mapping_entry *entry) {
+    return mapping_list->paths + entry->path_offset;
+}
+
+void free_mapping_list(struct mapping_list *mapping_list) {
+    free(mapping_list->mappings);
+    mapping_list->mappings = NULL;
+    mapping_list->count = 0;
+    mapping_list->capacity = 0;
+
+    free(mapping_list->paths);
+    mapping_list->paths = NULL;
+    mapping_list->paths_length = 0;
+    mapping_list->paths_capacity = 0;
+}
+
+/* sum the socket memory of one socket inode found in a table, returns the number of matching sockets without skmem */
+static int add_socket_memory(pid_t pid, long int socket_inode, struct netstat *netstat_list, long int *socket_memory) {
+    struct netstat *head;
+    int missing = 0;
+
+    for (head = netstat_list; head != NULL; head = head->next_ptr) {
+        if (head->socket_inode != socket_inode) {
+            continue;
+        }
+
+        if (get_socket_memory(pid, head) == 0) {
+            *socket_memory += get_socket_charged_memory(&head->skmem);
+        } else {
+            ++missing;
+        }
     }
 
-    /* print header */
-    fprintf(stdout, "%-16s  %-15s     %-5s %-6s %-12s %s\n", "START ADDRESS", "SIZE", "PERM", "DEV", "INODE", "FILE PATH");
-    fflush(stdout);
+    return missing;
+}
 
-    while (fgets(line, sizeof(line), process_memory_mapping_file) != NULL) {
-        /* it is possible that pathname field is empty, set file_pathname as an empty string first as placeholder */
-        file_pathname[0] = '\0';
+int get_socket_memory_usage(pid_t pid, long int *process_socket_memory) {
+    char *process_fd_buffer;
+    char process_fd_path[PATH_MAX];
+    char line[BUFSIZ];
+    struct netstat *netstat_lists[NETNS_PROTOCOL_COUNT];
+    char *protocols[NETNS_PROTOCOL_COUNT] = {"tcp", "udp", "tcp6", "udp6"};
+    long int socket_inode;
+    long int socket_memory = 0;
+    int missing = 0;
+    int i;
+
+    *process_socket_memory = -1;
+
+    /* construct process file descriptors holding path based on pid */
+    if (snprintf(process_fd_path, sizeof(process_fd_path), "/proc/%d/fd", pid) < 0) {
+        return -1;
+    }
+
+    /* the tables are parsed once per cycle and shared with the network connection section */
+    for (i = 0; i < NETNS_PROTOCOL_COUNT; ++i) {
+        if (get_netns_netstat(pid, protocols[i], &netstat_lists[i]) < 0) {
+            netstat_lists[i] = NULL;
+        }
+    }
 
-        /* read fields from each mapping */
-        ret_sscanf = sscanf(line, format, &start_address, &end_address, permission_bits, &offset, dev, &file_inode, file_pathname);
-        if (ret_sscanf < 6 || ret_sscanf == EOF) {
+    /* after the tables, outside of a batch they are read into the same buffer */
+    process_fd_buffer = read_procfs_links(process_fd_path, NULL);
+    if (process_fd_buffer == NULL) {
+        return -1;
+    }
+
+    /* only the sockets of the pid are queried, the cost scales with its socket count */
+    while (procfs_getline(line, sizeof(line), &process_fd_buffer) != NULL) {
+        if (sscanf(line, "%*s socket:[%ld]", &socket_inode) < 1 || socket_inode <= 0) {
             continue;
         }
 
-        /* calculate virtual memory usage */
-        size = end_address - start_address;
+        for (i = 0; i < NETNS_PROTOCOL_COUNT; ++i) {
+            missing += add_socket_memory(pid, socket_inode, netstat_lists[i], &socket_memory);
+        }
+    }
 
-        /* print memory mappings */
-        fprintf(stdout, "%016lx  %-15ld kB  %-5s %-6s %-12ld %s\n", start_address, size / 1024, permission_bits, dev, file_inode, file_pathname);
-        fflush(stdout);
+    /* a partial sum would understate the usage */
+    if (missing > 0) {
+        return -1;
     }
 
-    fclose(process_memory_mapping_file);
+    *process_socket_memory = socket_memory / 1024;
+
+    return 0;
 }
 
-void get_network_connection(pid_t pid) {
-    DIR *process_fd_dir;
+int get_socket_count(pid_t pid, long int *socket_count) {
+    char *process_fd_buffer;
     char process_fd_path[PATH_MAX];
-    struct dirent *entry;
-    char fd_file_symlink_path[PATH_MAX];
-    char fd_file_path[PATH_MAX];
+    char *target;
+
+    *socket_count = -1;
+
+    /* construct process file descriptors holding path based on pid */
+    if (snprintf(process_fd_path, sizeof(process_fd_path), "/proc/%d/fd", pid) < 0) {
+        return -1;
+    }
+
+    process_fd_buffer = read_procfs_links(process_fd_path, NULL);
+    if (process_fd_buffer == NULL) {
+        return -1;
+    }
+
+    /* only the link targets are counted, the network tables are not read */
+    *socket_count = 0;
+    for (target = process_fd_buffer; (target = strstr(target, " socket:[")) != NULL; ++target) {
+        ++*socket_count;
+    }
+
+    return 0;
+}
+
+int collect_network_connections(pid_t pid, struct socket_list *socket_list) {
+    char *process_fd_buffer;
+    process_fd_buffer = NULL;
+    char process_fd_path[PATH_MAX];
+    char line[BUFSIZ];
 
-    int ret_readlink;
     int ret_snprintf;
     int ret_sscanf;
 
     long int socket_inode = -1;
 
+    socket_list->count = 0;
+
     /* construct process file descriptors holding path based on pid */
     ret_snprintf = snprintf(process_fd_path, sizeof(process_fd_path), "/proc/%d/fd", pid);
     if (ret_snprintf < 0) {
         fprintf(stderr, "ERROR: failed to construct the PID %d memory mapping file name\n", pid);
-        return;
+        return -1;
     }
 
-    /* read /proc/pid/fd directory */
-    process_fd_dir = opendir(process_fd_path);
-    if (process_fd_dir == NULL) {
-        return;
-    }
+    /* load tcp and udp netstat data from the network namespace of the pid */
+    struct netstat *tcp_netstat;
+    struct netstat *udp_netstat;
+    struct netstat *tcp6_netstat;
+    struct netstat *udp6_netstat;
 
-    /* load tcp and udp netstat data */
-    struct netstat *tcp_netstat = load_netstat("tcp");
-    if (tcp_netstat == NULL) {
+    if (get_netns_netstat(pid, "tcp", &tcp_netstat) < 0) {
         fprintf(stderr, "ERROR: failed to load IPv4 TCP network connections stats\n");
-        return;
+        return -1;
     }
 
-    struct netstat *udp_netstat = load_netstat("udp");
-    if (udp_netstat == NULL) {
+    if (get_netns_netstat(pid, "udp", &udp_netstat) < 0) {
         fprintf(stderr, "ERROR: failed to load IPv4 UDP network connections stats\n");
-        return;
+        return -1;
     }
 
-    struct netstat *tcp6_netstat = load_netstat("tcp6");
-    if (tcp6_netstat == NULL) {
+    if (get_netns_netstat(pid, "tcp6", &tcp6_netstat) < 0) {
         fprintf(stderr, "WARNING: failed to load IPv6 TCP network connections stats\n");
     }
 
-    struct netstat *udp6_netstat = load_netstat("udp6");
-    if (udp6_netstat == NULL) {
+    if (get_netns_netstat(pid, "udp6", &udp6_netstat) < 0) {
         fprintf(stderr, "WRANING: failed to load IPv6 UDP network connections stats\n");
     }
 
-    /* print header */
-    fprintf(stdout, "%-6s%-13s%-45s%-8s%-45s%-8s%-10s%-10s\n", "PROT", "STATE", "L.ADDR", "L.PORT", "R.ADDR", "R.PORT", "TX QUEUE", "RX QUEUE");
-    fflush(stdout);
-
-    while ((entry = readdir(process_fd_dir)) != NULL) {
-        /* skip . and .. */
-        if (entry->d_name[0] == '.') {
-            continue;
-        }
-
-        /* construct file descriptor symlink file path */
-        ret_snprintf = snprintf(fd_file_symlink_path, sizeof(fd_file_symlink_path), "/proc/%d/fd/%s", pid, entry->d_name);
-        if (ret_snprintf < 0) {
-            continue;
-        }
-
-        /* acquire real path */
-        ret_readlink = readlink(fd_file_symlink_path, fd_file_path, sizeof(fd_file_path));
-        if (ret_readlink < 0) {
-            continue;
-        }
-
-        /* readlink() does not append null byte in the end of buffer */
-        fd_file_path[ret_readlink] = '\0';
+    /* read /proc/pid/fd symlinks as "<fd> <target>" lines, outside of a batch the tables are read into the same buffer */
+    process_fd_buffer = read_procfs_links(process_fd_path, NULL);
+    if (process_fd_buffer == NULL) {
+        return -1;
+    }
 
+    while (procfs_getline(line, sizeof(line), &process_fd_buffer) != NULL) {
         /* acquire socket inode */
-        ret_sscanf = sscanf(fd_file_path, "socket:[%ld]", &socket_inode);
+        ret_sscanf = sscanf(line, "%*s socket:[%ld]", &socket_inode);
         if (ret_sscanf < 1 || ret_sscanf == EOF) {
             continue;
         }
 
         /* we only process network connection details if socket_inode > 0 */
         if (socket_inode > 0) {
-            /* process IPv4 TCP connection information */
-            get_connection_stats(socket_inode, tcp_netstat);
-
-            /* process IPv4 UDP connection information */
-            get_connection_stats(socket_inode, udp_netstat);
+            /* process IPv4 TCP and UDP connection information */
+            if (collect_connection_stats(pid, socket_inode, tcp_netstat, socket_list) < 0 || collect_connection_stats(pid, socket_inode, udp_netstat, socket_list) < 0) {
+                return -1;
+            }
 
             /* we only process IPv6 connection information if IPv6 is enabled */
-            if (tcp6_netstat != NULL) {
-                get_connection_stats(socket_inode, tcp6_netstat);
+            if (tcp6_netstat != NULL && collect_connection_stats(pid, socket_inode, tcp6_netstat, socket_list) < 0) {
+                return -1;
             }
 
-            if (udp6_netstat != NULL) {
-                get_connection_stats(socket_inode, udp6_netstat);
+            if (udp6_netstat != NULL && collect_connection_stats(pid, socket_inode, udp6_netstat, socket_list) < 0) {
+                return -1;
             }
         }
     }
 
-    /* free linked list */
-    free_netstat(tcp_netstat);
-    free_netstat(udp_netstat);
-    free_netstat(tcp6_netstat);
-    free_netstat(udp6_netstat);
+    /* the linked lists are owned by the network namespace cache */
 
-    closedir(process_fd_dir);
+    return 0;
 }
@@ -3,6 +3,20 @@
 
 #include <limits.h>
 #include <sys/types.h>
+#include "procfs.h"
+
+#define PROCESS_TREE_MAX_DEPTH 64
+#define PROCESS_TREE_DEFAULT_REFRESH 10 /* walks between reads of the memory figures of a cached ancestor */
+#define PROCESS_DISCOVERY_BUFFER_SIZE 32768 /* bytes of /proc directory entries read by each getdents64() */
+#define PROCESS_NAME_SIZE 64 /* the parenthesized comm of /proc/pid/stat, the kernel truncates it to 15 characters */
+#define MAPPING_LIST_INITIAL_CAPACITY 64
+#define MAPPING_PATHS_INITIAL_CAPACITY 4096 /* bytes of the path arena of a mapping_list */
+
+/* an executable is identified by its file, the same file may be reached through many paths */
+struct exe_identity {
+    dev_t dev;
+    ino_t inode;
+};
 
 struct meminfo {
     int process_oom_score;
@@ -12,18 +26,83 @@ struct meminfo {
     long int process_pss; /* unit: kB */
     long int process_uss; /* unit: kB */
     long int process_page_tables_size; /* unit: kB */
+    long int process_socket_memory; /* unit: kB, -1 if it is not available */
+};
+
+/* one line of /proc/pid/maps */
+struct mapping {
+    unsigned long start_address;
+    unsigned long end_address;
+    char permission_bits[5];
+    unsigned long offset;
+    char dev[6];
+    long int file_inode;
+    char file_pathname[PATH_MAX];
+};
+
+/* one mapping of a mapping_list, its path is kept in the path arena of the list instead of a PATH_MAX array */
+struct mapping_entry {
+    unsigned long start_address;
+    unsigned long end_address;
+    char permission_bits[5];
+    char dev[6];
+    unsigned long offset;
+    long int file_inode;
+    size_t path_offset; /* the NUL-terminated path starts at paths + path_offset, see get_mapping_path() */
+    size_t path_length;
+};
+
+/* mappings of the last collection, the arrays are kept and reused by the next collections */
+struct mapping_list {
+    struct mapping_entry *mappings;
+    size_t count;
+    size_t capacity;
+    char *paths; /* the paths of the mappings one after another */
+    size_t paths_length;
+    size_t paths_capacity;
 };
 
+/* one process of the ancestor chain, the values which are not available are -1 */
+struct ancestor {
+    pid_t pid;
+    char exe_name[PROCESS_NAME_SIZE];
+    int oom_score;
+    int oom_score_adj;
+    long int process_rss; /* unit: kB */
+    long int process_pss; /* unit: kB */
+    long int process_uss; /* unit: kB */
+};
+
+/* ancestor chain cache counters since the start */
+struct process_tree_cache_stats {
+    unsigned long hits; /* ancestors whose PID and start time match the last walk */
+    unsigned long misses;
+    unsigned long refreshes; /* ancestors whose OOM score and memory figures were read */
+};
+
+struct socket_list;
+
 extern int check_pid(pid_t pid);
 extern int get_ppid(pid_t pid, int *ppid, char *exe_name);
 extern char *get_exe_path_name(pid_t pid);
-extern int compare_pid_exe(pid_t pid, char *exe_name);
+extern int get_exe_identity(char *exe_name, struct exe_identity *identity);
+extern int compare_pid_exe(pid_t pid, struct exe_identity *identity);
+extern pid_t find_pid_by_exe(struct exe_identity *identity);
 extern int get_oom_score(pid_t pid, int *oom_score, int *oom_score_adj);
 extern int get_memory_usage(pid_t pid, long int *process_rss, long int *process_pss, long int *process_uss);
+extern int get_statm_rss(pid_t pid, long int *process_rss);
 extern int get_page_tables_usage(pid_t pid, long int *process_page_tables_size);
 extern int get_system_memory(long int *total_memory);
-extern void get_process_tree(pid_t pid);
-extern void get_memory_mapping(pid_t pid);
-extern void get_network_connection(pid_t pid);
+extern int collect_process_tree(pid_t pid, struct ancestor *ancestors, int max_count);
+extern void set_process_tree_refresh(long int refresh_cycles);
+extern void get_process_tree_cache_stats(struct process_tree_cache_stats *stats);
+extern void add_process_batch_files(struct procfs_batch *batch, pid_t pid);
+extern int parse_memory_mapping(char *line, struct mapping *mapping);
+extern int collect_memory_mappings(pid_t pid, struct mapping_list *mapping_list);
+extern const char *get_mapping_path(const struct mapping_list *mapping_list, const struct mapping_entry *entry);
+extern void free_mapping_list(struct mapping_list *mapping_list);
+extern int get_socket_memory_usage(pid_t pid, long int *process_socket_memory);
+extern int get_socket_count(pid_t pid, long int *socket_count);
+extern int collect_network_connections(pid_t pid, struct socket_list *socket_list);
 
 #endif /* PROCESS_H */
@@ -0,0 +1,861 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include "procfs.h"
+#include "utils.h"
+
+/* user_data of a request: slot in the upper 32 bits, then the segment index and the operation */
+#define PROCFS_OP_OPEN 0
+#define PROCFS_OP_READ 1
+#define PROCFS_OP_CLOSE 2
+#define PROCFS_OP_BITS 2
+#define PROCFS_SLOT_SHIFT 32
+
+/* mmap'ed submission and completion queues of the io_uring instance */
+struct procfs_uring {
+    int ring_fd;
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int *sq_ring_mask;
+    unsigned int *sq_array;
+    unsigned int sq_entries;
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int *cq_ring_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    int fixed_buffers; /* 1 if the file buffers are registered */
+};
+
+static struct procfs_uring uring = {.ring_fd = -1};
+
+/* batches are submitted by the capture thread only, the registered buffers change when a batch buffer grows */
+static struct procfs_batch procfs_batches[PROCFS_BATCH_COUNT];
+static int buffers_changed = 1;
+
+/* the batch looked up by read_procfs_file() and the buffer of files read outside of a batch, per thread */
+static _Thread_local struct procfs_batch *active_batch = NULL;
+static _Thread_local struct procfs_file scratch_file;
+
+/* files read outside of the batch are passed to the recorder of the thread, e.g. to archive them */
+static _Thread_local procfs_recorder active_recorder = NULL;
+
+/* files read from the live /proc because they were missing from the batch in use, per thread */
+static _Thread_local unsigned long live_reads = 0;
+
+/* set while replaying an archive, files missing from the batch are not read from the live /proc */
+static int procfs_offline = 0;
+
+static size_t get_procfs_segments(struct procfs_file *file) {
+    return file->capacity / PROCFS_SEGMENT_SIZE;
+}
+
+static int grow_procfs_buffer(struct procfs_file *file, size_t segments) {
+    char *new_buffer;
+    int *new_segment_lengths;
+
+    new_buffer = (char *)realloc(file->buffer, segments * PROCFS_SEGMENT_SIZE + 1);
+    if (new_buffer == NULL) {
+        return -1;
+    }
+
+    file->buffer = new_buffer;
+
+    new_segment_lengths = (int *)realloc(file->segment_lengths, segments * sizeof(int));
+    if (new_segment_lengths == NULL) {
+        return -1;
+    }
+
+    file->segment_lengths = new_segment_lengths;
+    file->capacity = segments * PROCFS_SEGMENT_SIZE + 1;
+
+    return 0;
+}
+
+/* read a whole procfs file with open/read/close, procfs reports no file size so the buffer grows until EOF. *grown is set to 1 if the buffer is reallocated */
+static int read_file_blocking(struct procfs_file *file, unsigned long *syscalls, int *grown) {
+    int fd;
+    ssize_t ret_read;
+
+    file->length = 0;
+    file->error = 0;
+
+    if (file->capacity == 0) {
+        if (grow_procfs_buffer(file, PROCFS_INITIAL_SEGMENTS) < 0) {
+            file->error = ENOMEM;
+            return -1;
+        }
+
+        *grown = 1;
+    }
+
+    fd = open(file->path, O_RDONLY | O_CLOEXEC);
+    ++*syscalls;
+    if (fd < 0) {
+        file->error = errno;
+        return -1;
+    }
+
+    while (1) {
+        if (file->length + 1 == file->capacity) {
+            if (grow_procfs_buffer(file, get_procfs_segments(file) * 2) < 0) {
+                file->error = ENOMEM;
+                break;
+            }
+
+            *grown = 1;
+        }
+
+        ret_read = read(fd, file->buffer + file->length, file->capacity - file->length - 1);
+        ++*syscalls;
+
+        if (ret_read < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            file->error = errno;
+            break;
+        }
+
+        if (ret_read == 0) {
+            break;
+        }
+
+        file->length += ret_read;
+    }
+
+    file->buffer[file->length] = '\0';
+
+    close(fd);
+    ++*syscalls;
+
+    return file->error == 0 ? 0 : -1;
+}
+
+/* capture a directory of symlinks as "<name> <target>" lines, *grown is set to 1 if the buffer is reallocated */
+static int read_links_blocking(struct procfs_file *file, unsigned long *syscalls, int *grown) {
+    DIR *links_dir;
+    struct dirent *entry;
+    char link_path[PATH_MAX];
+    char link_target[PATH_MAX];
+    size_t line_length;
+    ssize_t ret_readlink;
+    int ret_snprintf;
+
+    file->length = 0;
+    file->error = 0;
+
+    if (file->capacity == 0) {
+        if (grow_procfs_buffer(file, PROCFS_INITIAL_SEGMENTS) < 0) {
+            file->error = ENOMEM;
+            return -1;
+        }
+
+        *grown = 1;
+    }
+
+    file->buffer[0] = '\0';
+
+    links_dir = opendir(file->path);
+    ++*syscalls;
+    if (links_dir == NULL) {
+        file->error = errno;
+        return -1;
+    }
+
+    while ((entry = readdir(links_dir)) != NULL) {
+        /* skip . and .. */
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        ret_snprintf = snprintf(link_path, sizeof(link_path), "%s/%s", file->path, entry->d_name);
+        if (ret_snprintf < 0 || (size_t)ret_snprintf >= sizeof(link_path)) {
+            continue;
+        }
+
+        ret_readlink = readlink(link_path, link_target, sizeof(link_target) - 1);
+        ++*syscalls;
+        if (ret_readlink < 0) {
+            continue;
+        }
+
+        /* readlink() does not append null byte in the end of buffer */
+        link_target[ret_readlink] = '\0';
+
+        line_length = strlen(entry->d_name) + 1 + ret_readlink + 1;
+
+        while (file->length + line_length + 1 > file->capacity) {
+            if (grow_procfs_buffer(file, get_procfs_segments(file) * 2) < 0) {
+                file->error = ENOMEM;
+                closedir(links_dir);
+                return -1;
+            }
+
+            *grown = 1;
+        }
+
+        file->length += sprintf(file->buffer + file->length, "%s %s\n", entry->d_name, link_target);
+    }
+
+    closedir(links_dir);
+    ++*syscalls;
+
+    return 0;
+}
+
+static void free_uring() {
+    if (uring.sqes != NULL) {
+        munmap(uring.sqes, uring.sqes_size);
+    }
+
+    if (uring.cq_ring != NULL && uring.cq_ring != uring.sq_ring) {
+        munmap(uring.cq_ring, uring.cq_ring_size);
+    }
+
+    if (uring.sq_ring != NULL) {
+        munmap(uring.sq_ring, uring.sq_ring_size);
+    }
+
+    if (uring.ring_fd >= 0) {
+        close(uring.ring_fd);
+    }
+
+    memset(&uring, 0, sizeof(uring));
+    uring.ring_fd = -1;
+}
+
+static int setup_uring() {
+    struct io_uring_params params;
+    int direct_fds[PROCFS_BATCH_MAX_FILES];
+    int i;
+
+    memset(&params, 0, sizeof(params));
+
+    uring.ring_fd = syscall(__NR_io_uring_setup, PROCFS_URING_ENTRIES, &params);
+    if (uring.ring_fd < 0) {
+        uring.ring_fd = -1;
+        return -1;
+    }
+
+    uring.sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    uring.cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    /* both rings share one mapping on kernels with IORING_FEAT_SINGLE_MMAP */
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (uring.cq_ring_size > uring.sq_ring_size) {
+            uring.sq_ring_size = uring.cq_ring_size;
+        }
+        uring.cq_ring_size = uring.sq_ring_size;
+    }
+
+    uring.sq_ring = mmap(NULL, uring.sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring.ring_fd, IORING_OFF_SQ_RING);
+    if (uring.sq_ring == MAP_FAILED) {
+        uring.sq_ring = NULL;
+        goto handle_error;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        uring.cq_ring = uring.sq_ring;
+    } else {
+        uring.cq_ring = mmap(NULL, uring.cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring.ring_fd, IORING_OFF_CQ_RING);
+        if (uring.cq_ring == MAP_FAILED) {
+            uring.cq_ring = NULL;
+            goto handle_error;
+        }
+    }
+
+    uring.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    uring.sqes = (struct io_uring_sqe *)mmap(NULL, uring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring.ring_fd, IORING_OFF_SQES);
+    if (uring.sqes == MAP_FAILED) {
+        uring.sqes = NULL;
+        goto handle_error;
+    }
+
+    uring.sq_head = (unsigned int *)((char *)uring.sq_ring + params.sq_off.head);
+    uring.sq_tail = (unsigned int *)((char *)uring.sq_ring + params.sq_off.tail);
+    uring.sq_ring_mask = (unsigned int *)((char *)uring.sq_ring + params.sq_off.ring_mask);
+    uring.sq_array = (unsigned int *)((char *)uring.sq_ring + params.sq_off.array);
+    uring.sq_entries = params.sq_entries;
+    uring.cq_head = (unsigned int *)((char *)uring.cq_ring + params.cq_off.head);
+    uring.cq_tail = (unsigned int *)((char *)uring.cq_ring + params.cq_off.tail);
+    uring.cq_ring_mask = (unsigned int *)((char *)uring.cq_ring + params.cq_off.ring_mask);
+    uring.cqes = (struct io_uring_cqe *)((char *)uring.cq_ring + params.cq_off.cqes);
+
+    /* a sparse table of direct descriptors, files are opened into slot i and never get a regular fd */
+    for (i = 0; i < PROCFS_BATCH_MAX_FILES; ++i) {
+        direct_fds[i] = -1;
+    }
+
+    if (syscall(__NR_io_uring_register, uring.ring_fd, IORING_REGISTER_FILES, direct_fds, PROCFS_BATCH_MAX_FILES) < 0) {
+        goto handle_error;
+    }
+
+    return 0;
+
+/* error handling routine */
+handle_error:
+    free_uring();
+    return -1;
+}
+
+/* register the buffers of all batches for IORING_OP_READ_FIXED, plain reads are used if registration is not permitted */
+static void register_uring_buffers(unsigned long *syscalls) {
+    struct iovec iovecs[PROCFS_BATCH_COUNT * PROCFS_BATCH_MAX_FILES];
+    struct procfs_file *file;
+    int buffer_count = 0;
+    int i;
+    size_t slot;
+
+    if (!buffers_changed) {
+        return;
+    }
+
+    if (uring.fixed_buffers) {
+        syscall(__NR_io_uring_register, uring.ring_fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+        ++*syscalls;
+        uring.fixed_buffers = 0;
+    }
+
+    for (i = 0; i < PROCFS_BATCH_COUNT; ++i) {
+        for (slot = 0; slot < procfs_batches[i].allocated; ++slot) {
+            file = &procfs_batches[i].files[slot];
+            file->buffer_index = buffer_count;
+            iovecs[buffer_count].iov_base = file->buffer;
+            iovecs[buffer_count].iov_len = file->capacity;
+            ++buffer_count;
+        }
+    }
+
+    if (buffer_count > 0 && syscall(__NR_io_uring_register, uring.ring_fd, IORING_REGISTER_BUFFERS, iovecs, buffer_count) == 0) {
+        uring.fixed_buffers = 1;
+    }
+    ++*syscalls;
+
+    buffers_changed = 0;
+}
+
+static struct io_uring_sqe *get_uring_sqe(unsigned int *tail) {
+    unsigned int index = *tail & *uring.sq_ring_mask;
+    struct io_uring_sqe *sqe = &uring.sqes[index];
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    uring.sq_array[index] = index;
+    ++*tail;
+
+    return sqe;
+}
+
+/* queue open -> read segment * N -> close chains with one io_uring_enter() per full submission queue and reap the completions */
+static int submit_uring_files(struct procfs_batch *batch, size_t *slots, size_t slot_count, unsigned long *syscalls, int *unsupported) {
+    struct io_uring_sqe *sqe;
+    struct io_uring_cqe *cqe;
+    struct procfs_file *file;
+    unsigned int tail;
+    unsigned int head;
+    unsigned int queued;
+    unsigned int completed;
+    size_t segments;
+    size_t segment;
+    size_t slot;
+    size_t i = 0;
+    int op;
+    long ret_enter;
+
+    while (i < slot_count) {
+        tail = *uring.sq_tail;
+        queued = 0;
+
+        /* a chain cannot span two submissions, so only whole chains are queued */
+        while (i < slot_count) {
+            slot = slots[i];
+            file = &batch->files[slot];
+            segments = get_procfs_segments(file);
+
+            if (queued + segments + 2 > uring.sq_entries) {
+                break;
+            }
+
+            file->length = 0;
+            file->error = 0;
+
+            sqe = get_uring_sqe(&tail);
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (unsigned long)file->path;
+            sqe->open_flags = O_RDONLY; /* O_CLOEXEC is rejected for direct descriptors */
+            sqe->file_index = slot + 1;
+            sqe->flags = IOSQE_IO_LINK;
+            sqe->user_data = ((unsigned long long)slot << PROCFS_SLOT_SHIFT) | PROCFS_OP_OPEN;
+
+            /* sequential reads from the file position, a short read breaks a normal link so hard links are used */
+            for (segment = 0; segment < segments; ++segment) {
+                file->segment_lengths[segment] = 0;
+
+                sqe = get_uring_sqe(&tail);
+                sqe->opcode = uring.fixed_buffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+                sqe->fd = slot;
+                sqe->addr = (unsigned long)(file->buffer + segment * PROCFS_SEGMENT_SIZE);
+                sqe->len = PROCFS_SEGMENT_SIZE;
+                sqe->off = (unsigned long long)-1;
+                sqe->buf_index = uring.fixed_buffers ? file->buffer_index : 0;
+                sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+                sqe->user_data = ((unsigned long long)slot << PROCFS_SLOT_SHIFT) | (segment << PROCFS_OP_BITS) | PROCFS_OP_READ;
+            }
+
+            sqe = get_uring_sqe(&tail);
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->file_index = slot + 1;
+            sqe->user_data = ((unsigned long long)slot << PROCFS_SLOT_SHIFT) | PROCFS_OP_CLOSE;
+
+            queued += segments + 2;
+            ++i;
+        }
+
+        if (queued == 0) {
+            return -1;
+        }
+
+        __atomic_store_n(uring.sq_tail, tail, __ATOMIC_RELEASE);
+
+        completed = 0;
+
+        while (completed < queued) {
+            ret_enter = syscall(__NR_io_uring_enter, uring.ring_fd, completed == 0 ? queued : 0, queued - completed, IORING_ENTER_GETEVENTS, NULL, 0);
+            ++*syscalls;
+
+            if (ret_enter < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                return -1;
+            }
+
+            head = *uring.cq_head;
+
+            while (head != __atomic_load_n(uring.cq_tail, __ATOMIC_ACQUIRE)) {
+                cqe = &uring.cqes[head & *uring.cq_ring_mask];
+                slot = cqe->user_data >> PROCFS_SLOT_SHIFT;
+                segment = (cqe->user_data & 0xffffffffULL) >> PROCFS_OP_BITS;
+                op = cqe->user_data & ((1 << PROCFS_OP_BITS) - 1);
+                file = &batch->files[slot];
+
+                if (op == PROCFS_OP_OPEN && cqe->res < 0) {
+                    file->error = -cqe->res;
+
+                    /* opening into a direct descriptor needs Linux 5.15 */
+                    if (cqe->res == -EINVAL) {
+                        *unsupported = 1;
+                    }
+                } else if (op == PROCFS_OP_READ) {
+                    if (cqe->res >= 0) {
+                        file->segment_lengths[segment] = cqe->res;
+                    } else if (cqe->res != -ECANCELED && file->error == 0) {
+                        file->error = -cqe->res;
+                    }
+                }
+
+                ++head;
+                ++completed;
+            }
+
+            __atomic_store_n(uring.cq_head, head, __ATOMIC_RELEASE);
+        }
+    }
+
+    return 0;
+}
+
+/* move the segments together, returns 1 if EOF is reached within the buffer */
+static int compact_procfs_segments(struct procfs_file *file) {
+    size_t segments = get_procfs_segments(file);
+    size_t segment;
+
+    file->length = 0;
+
+    for (segment = 0; segment < segments; ++segment) {
+        if (file->segment_lengths[segment] == 0) {
+            file->buffer[file->length] = '\0';
+            return 1;
+        }
+
+        memmove(file->buffer + file->length, file->buffer + segment * PROCFS_SEGMENT_SIZE, file->segment_lengths[segment]);
+        file->length += file->segment_lengths[segment];
+    }
+
+    file->buffer[file->length] = '\0';
+
+    return 0;
+}
+
+static int submit_uring_batch(struct procfs_batch *batch, unsigned long *syscalls) {
+    size_t slots[PROCFS_BATCH_MAX_FILES];
+    size_t slot_count = 0;
+    size_t retry_count;
+    size_t i;
+    int unsupported = 0;
+    struct procfs_file *file;
+
+    for (i = 0; i < batch->count; ++i) {
+        file = &batch->files[i];
+        if (file->type != PROCFS_FILE_REGULAR) {
+            continue;
+        }
+
+        /* a chain cannot span two submissions, a file which has outgrown one is read with blocking syscalls */
+        if (get_procfs_segments(file) + 2 > uring.sq_entries) {
+            read_file_blocking(file, syscalls, &buffers_changed);
+            continue;
+        }
+
+        slots[slot_count++] = i;
+    }
+
+    while (slot_count > 0) {
+        register_uring_buffers(syscalls);
+
+        if (submit_uring_files(batch, slots, slot_count, syscalls, &unsupported) < 0 || unsupported) {
+            return -1;
+        }
+
+        /* a file without EOF in its buffer is read again with twice the segments */
+        retry_count = 0;
+
+        for (i = 0; i < slot_count; ++i) {
+            file = &batch->files[slots[i]];
+
+            if (file->error != 0 || compact_procfs_segments(file)) {
+                continue;
+            }
+
+            if (get_procfs_segments(file) * 2 + 2 > uring.sq_entries) {
+                read_file_blocking(file, syscalls, &buffers_changed);
+                continue;
+            }
+
+            if (grow_procfs_buffer(file, get_procfs_segments(file) * 2) < 0) {
+                file->error = ENOMEM;
+                continue;
+            }
+
+            buffers_changed = 1;
+            slots[retry_count++] = slots[i];
+        }
+
+        slot_count = retry_count;
+    }
+
+    return 0;
+}
+
+int procfs_init(int use_io_uring) {
+    if (!use_io_uring) {
+        return 0;
+    }
+
+    if (setup_uring() < 0) {
+        fprintf(stderr, "WARNING: io_uring is not available, procfs files are read with blocking syscalls: %s\n", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+static void free_procfs_file(struct procfs_file *file) {
+    free(file->buffer);
+    free(file->segment_lengths);
+    file->buffer = NULL;
+    file->segment_lengths = NULL;
+    file->capacity = 0;
+}
+
+void procfs_cleanup() {
+    size_t slot;
+    int i;
+
+    free_uring();
+
+    for (i = 0; i < PROCFS_BATCH_COUNT; ++i) {
+        for (slot = 0; slot < procfs_batches[i].allocated; ++slot) {
+            free_procfs_file(&procfs_batches[i].files[slot]);
+        }
+
+        procfs_batches[i].allocated = 0;
+        procfs_batches[i].count = 0;
+    }
+
+    procfs_thread_cleanup();
+}
+
+void procfs_thread_cleanup() {
+    free_procfs_file(&scratch_file);
+    active_batch = NULL;
+}
+
+struct procfs_batch *procfs_get_batch(int index) {
+    if (index < 0 || index >= PROCFS_BATCH_COUNT) {
+        return NULL;
+    }
+
+    return &procfs_batches[index];
+}
+
+void procfs_batch_begin(struct procfs_batch *batch) {
+    batch->count = 0;
+    batch->hint = 0;
+}
+
+static struct procfs_file *add_batch_file(struct procfs_batch *batch, char *path, enum procfs_file_type type) {
+    struct procfs_file *file;
+    size_t i;
+
+    /* a file is read only once per batch */
+    for (i = 0; i < batch->count; ++i) {
+        if (strcmp(batch->files[i].path, path) == 0) {
+            return &batch->files[i];
+        }
+    }
+
+    /* files that cannot be added are read with blocking syscalls when they are looked up */
+    if (batch->count == PROCFS_BATCH_MAX_FILES || strlen(path) >= PROCFS_PATH_SIZE) {
+        return NULL;
+    }
+
+    file = &batch->files[batch->count];
+
+    if (batch->count == batch->allocated) {
+        if (grow_procfs_buffer(file, PROCFS_INITIAL_SEGMENTS) < 0) {
+            return NULL;
+        }
+
+        buffers_changed = 1;
+        ++batch->allocated;
+    }
+
+    strcpy(file->path, path);
+    file->type = type;
+    file->length = 0;
+    file->error = 0;
+
+    ++batch->count;
+
+    return file;
+}
+
+int procfs_batch_add(struct procfs_batch *batch, char *path) {
+    return add_batch_file(batch, path, PROCFS_FILE_REGULAR) == NULL ? -1 : 0;
+}
+
+int procfs_batch_add_links(struct procfs_batch *batch, char *path) {
+    return add_batch_file(batch, path, PROCFS_FILE_LINKS) == NULL ? -1 : 0;
+}
+
+int procfs_batch_load(struct procfs_batch *batch, char *path, enum procfs_file_type type, char *data, size_t length, int error) {
+    struct procfs_file *file;
+    size_t segments;
+
+    file = add_batch_file(batch, path, type);
+    if (file == NULL) {
+        return -1;
+    }
+
+    segments = length / PROCFS_SEGMENT_SIZE + 1;
+    if (segments > get_procfs_segments(file)) {
+        if (grow_procfs_buffer(file, segments) < 0) {
+            return -1;
+        }
+
+        buffers_changed = 1;
+    }
+
+    if (length > 0) {
+        memcpy(file->buffer, data, length);
+    }
+
+    file->buffer[length] = '\0';
+    file->length = length;
+    file->error = error;
+
+    return 0;
+}
+
+int procfs_batch_submit(struct procfs_batch *batch, struct procfs_stats *stats) {
+    struct timespec start_time;
+    size_t i;
+
+    memset(stats, 0, sizeof(struct procfs_stats));
+    stats->files = batch->count;
+
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    if (uring.ring_fd >= 0) {
+        if (submit_uring_batch(batch, &stats->syscalls) == 0) {
+            stats->io_uring = 1;
+        } else {
+            fprintf(stderr, "WARNING: io_uring batch failed, procfs files are read with blocking syscalls from now on\n");
+            free_uring();
+        }
+    }
+
+    /* blocking fallback path, symlinks have no io_uring operation and are always read here. the buffers are only registered again if one has grown */
+    for (i = 0; i < batch->count; ++i) {
+        if (batch->files[i].type == PROCFS_FILE_LINKS) {
+            read_links_blocking(&batch->files[i], &stats->syscalls, &buffers_changed);
+        } else if (!stats->io_uring) {
+            read_file_blocking(&batch->files[i], &stats->syscalls, &buffers_changed);
+        }
+    }
+
+    stats->latency = get_elapsed_microseconds(&start_time);
+
+    batch->hint = 0;
+
+    return 0;
+}
+
+void procfs_set_recorder(procfs_recorder recorder) {
+    active_recorder = recorder;
+}
+
+void procfs_set_offline(int offline) {
+    procfs_offline = offline;
+}
+
+int procfs_is_offline() {
+    return procfs_offline;
+}
+
+unsigned long procfs_get_live_reads() {
+    return live_reads;
+}
+
+void procfs_batch_use(struct procfs_batch *batch) {
+    active_batch = batch;
+
+    if (batch != NULL) {
+        batch->hint = 0;
+    }
+}
+
+static struct procfs_file *lookup_batch_file(char *path, enum procfs_file_type type) {
+    struct procfs_file *file = NULL;
+    size_t i;
+
+    if (active_batch == NULL) {
+        return NULL;
+    }
+
+    if (active_batch->hint < active_batch->count && strcmp(active_batch->files[active_batch->hint].path, path) == 0) {
+        file = &active_batch->files[active_batch->hint];
+    } else {
+        for (i = 0; i < active_batch->count; ++i) {
+            if (strcmp(active_batch->files[i].path, path) == 0) {
+                file = &active_batch->files[i];
+                break;
+            }
+        }
+    }
+
+    if (file == NULL || file->type != type) {
+        return NULL;
+    }
+
+    active_batch->hint = file - active_batch->files + 1;
+
+    return file;
+}
+
+static char *read_procfs(char *path, size_t *length, enum procfs_file_type type) {
+    struct procfs_file *file;
+    unsigned long syscalls = 0;
+    int scratch_grown = 0; /* the scratch buffer is not registered with io_uring */
+
+    file = lookup_batch_file(path, type);
+
+    /* not part of the batch, read it now */
+    if (file == NULL) {
+        if (strlen(path) >= sizeof(scratch_file.path)) {
+            errno = ENAMETOOLONG;
+            return NULL;
+        }
+
+        strcpy(scratch_file.path, path);
+        scratch_file.type = type;
+
+        if (active_batch != NULL && !procfs_offline) {
+            ++live_reads;
+        }
+
+        if (procfs_offline) {
+            scratch_file.length = 0;
+            scratch_file.error = ENOENT;
+        } else if (type == PROCFS_FILE_LINKS) {
+            read_links_blocking(&scratch_file, &syscalls, &scratch_grown);
+        } else {
+            read_file_blocking(&scratch_file, &syscalls, &scratch_grown);
+        }
+
+        file = &scratch_file;
+
+        if (active_recorder != NULL) {
+            active_recorder(file);
+        }
+    }
+
+    if (file->error != 0) {
+        errno = file->error;
+        return NULL;
+    }
+
+    if (length != NULL) {
+        *length = file->length;
+    }
+
+    return file->buffer;
+}
+
+char *read_procfs_file(char *path, size_t *length) {
+    return read_procfs(path, length, PROCFS_FILE_REGULAR);
+}
+
+char *read_procfs_links(char *path, size_t *length) {
+    return read_procfs(path, length, PROCFS_FILE_LINKS);
+}
+
+char *procfs_getline(char *line, size_t size, char **cursor) {
+    size_t line_length = 0;
+
+    if (**cursor == '\0' || size == 0) {
+        return NULL;
+    }
+
+    /* copy one line including '\n' like fgets(), a long line is returned in pieces */
+    while (**cursor != '\0' && line_length + 1 < size) {
+        line[line_length++] = **cursor;
+        ++*cursor;
+
+        if (line[line_length - 1] == '\n') {
+            break;
+        }
+    }
+
+    line[line_length] = '\0';
+
+    return line;
+}
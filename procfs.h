@@ -0,0 +1,66 @@
+#ifndef PROCFS_H
+#define PROCFS_H
+
+#include <limits.h>
+#include <stddef.h>
+
+#define PROCFS_SEGMENT_SIZE 4096 /* seq_file based procfs files return at most about a page per read */
+#define PROCFS_INITIAL_SEGMENTS 2 /* initial capacity of a file buffer, it grows on demand */
+#define PROCFS_BATCH_MAX_FILES 256
+#define PROCFS_BATCH_COUNT 2 /* one batch is captured while the other one is rendered */
+#define PROCFS_PATH_SIZE 256
+#define PROCFS_URING_ENTRIES 1024 /* a file needs its segments + 2 entries, larger files are read with blocking syscalls */
+
+enum procfs_file_type {
+    PROCFS_FILE_REGULAR,
+    PROCFS_FILE_LINKS /* a directory of symlinks, e.g. /proc/pid/fd, captured as "<name> <target>" lines */
+};
+
+/* one procfs file read by a batch, the buffer is kept and reused in the next cycles */
+struct procfs_file {
+    char path[PROCFS_PATH_SIZE];
+    enum procfs_file_type type;
+    char *buffer; /* null-terminated file content */
+    size_t capacity; /* segments * PROCFS_SEGMENT_SIZE + 1 */
+    int *segment_lengths; /* bytes returned by each segment read of an io_uring batch */
+    int buffer_index; /* index of the registered buffer */
+    size_t length;
+    int error; /* errno of the failed read, 0 on success */
+};
+
+struct procfs_stats {
+    int io_uring; /* 1 if the batch is read with io_uring, 0 with blocking syscalls */
+    size_t files;
+    unsigned long syscalls;
+    long latency; /* unit: microsecond */
+};
+
+/* files captured together in one cycle */
+struct procfs_batch {
+    struct procfs_file files[PROCFS_BATCH_MAX_FILES];
+    size_t count;
+    size_t allocated; /* slots with a buffer, they are kept across cycles */
+    size_t hint; /* the next slot to look up, files are usually consumed in the order they are added */
+};
+
+typedef void (*procfs_recorder)(struct procfs_file *file);
+
+extern int procfs_init(int use_io_uring);
+extern void procfs_cleanup();
+extern void procfs_thread_cleanup();
+extern struct procfs_batch *procfs_get_batch(int index);
+extern void procfs_batch_begin(struct procfs_batch *batch);
+extern int procfs_batch_add(struct procfs_batch *batch, char *path);
+extern int procfs_batch_add_links(struct procfs_batch *batch, char *path);
+extern int procfs_batch_load(struct procfs_batch *batch, char *path, enum procfs_file_type type, char *data, size_t length, int error);
+extern int procfs_batch_submit(struct procfs_batch *batch, struct procfs_stats *stats);
+extern void procfs_batch_use(struct procfs_batch *batch);
+extern void procfs_set_recorder(procfs_recorder recorder);
+extern void procfs_set_offline(int offline);
+extern int procfs_is_offline();
+extern unsigned long procfs_get_live_reads();
+extern char *read_procfs_file(char *path, size_t *length);
+extern char *read_procfs_links(char *path, size_t *length);
+extern char *procfs_getline(char *line, size_t size, char **cursor);
+
+#endif /* PROCFS_H */
@@ -0,0 +1,733 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <arpa/inet.h>
+#include "archive.h"
+#include "growth.h"
+#include "network.h"
+#include "pagemap.h"
+#include "report.h"
+#include "shmstats.h"
+#include "threads.h"
+#include "topmem.h"
+#include "trend.h"
+#include "trigger.h"
+#include "utils.h"
+#include "writer.h"
+
+/* captured reports wait in a FIFO until the render thread prints them */
+static struct report report_slots[REPORT_SLOT_COUNT];
+static int report_slot_busy[REPORT_SLOT_COUNT];
+static int report_queue[REPORT_SLOT_COUNT];
+static int report_queue_head = 0;
+static int report_queue_count = 0;
+
+static pthread_mutex_t report_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t report_queued_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t report_free_cond = PTHREAD_COND_INITIALIZER;
+
+static pthread_t render_thread;
+static int render_thread_started = 0;
+static int render_thread_stopping = 0;
+static struct report_config render_config;
+
+/* records of the collectors, kept across reports so that their arrays are reused */
+static struct ancestor render_ancestors[PROCESS_TREE_MAX_DEPTH];
+static struct mapping_list render_mappings;
+static struct socket_list render_sockets;
+static struct mapping_summary render_mapping_groups;
+static struct thread_census render_threads;
+
+/*
+ * the sections which read live state while rendering, after the capture window has closed: sock_diag socket memory,
+ * the cgroup members, the statm scan of the host, the task files, pagemap and the files missing from the batch
+ */
+struct live_section {
+    double start; /* CLOCK_MONOTONIC seconds */
+    unsigned long procfs_live_reads;
+};
+
+static double live_read_first; /* CLOCK_MONOTONIC seconds, 0 if nothing has been read live in this report */
+static double live_read_last;
+static char live_section_names[256];
+
+static long get_capture_offset(struct report *report, double time) {
+    return (long)((time - report->capture_time) * 1000000);
+}
+
+static void begin_live_section(struct live_section *section) {
+    section->start = get_monotonic_time();
+    section->procfs_live_reads = procfs_get_live_reads();
+}
+
+/* mark a section which has read live state with its read window, always_live for the sections which never use the batch */
+static void end_live_section(struct report *report, struct live_section *section, char *name, int always_live) {
+    size_t length = strlen(live_section_names);
+    double end;
+
+    if (procfs_is_offline() || (!always_live && procfs_get_live_reads() == section->procfs_live_reads)) {
+        return;
+    }
+
+    end = get_monotonic_time();
+    if (live_read_first == 0) {
+        live_read_first = section->start;
+    }
+    live_read_last = end;
+
+    fprintf(report_output, "Live Read Window: %ld - %ld us after the capture\n", get_capture_offset(report, section->start), get_capture_offset(report, end));
+    snprintf(live_section_names + length, sizeof(live_section_names) - length, "%s%s", length > 0 ? ", " : "", name);
+}
+
+static void render_process_tree(pid_t pid) {
+    struct ancestor *ancestor;
+    int count;
+    int i;
+
+    count = collect_process_tree(pid, render_ancestors, PROCESS_TREE_MAX_DEPTH);
+
+    /* print process tree in reverse order */
+    for (i = 0; i < count; ++i) {
+        ancestor = &render_ancestors[i];
+        fprintf(report_output, "%d %s - OOM score: %d - OOM adjustment score: %d - RSS: %ld kB - PSS: %ld kB - USS: %ld kB\n", ancestor->pid, ancestor->exe_name, ancestor->oom_score, ancestor->oom_score_adj, ancestor->process_rss, ancestor->process_pss, ancestor->process_uss);
+    }
+    fflush(report_output);
+}
+
+static void render_memory_mappings(pid_t pid) {
+    struct mapping_entry *mapping;
+    size_t i;
+
+    if (collect_memory_mappings(pid, &render_mappings) < 0) {
+        return;
+    }
+
+    /* print header */
+    fprintf(report_output, "%-16s  %-15s     %-5s %-6s %-12s %s\n", "START ADDRESS", "SIZE", "PERM", "DEV", "INODE", "FILE PATH");
+
+    for (i = 0; i < render_mappings.count; ++i) {
+        mapping = &render_mappings.mappings[i];
+
+        /* print memory mappings with their virtual memory usage */
+        fprintf(report_output, "%016lx  %-15lu kB  %-5s %-6s %-12ld %s\n", mapping->start_address, (mapping->end_address - mapping->start_address) / 1024, mapping->permission_bits, mapping->dev, mapping->file_inode, get_mapping_path(&render_mappings, mapping));
+    }
+    fflush(report_output);
+}
+
+static void render_mapping_summary(pid_t pid) {
+    struct mapping_group *group;
+    size_t i;
+
+    /* smaps is in the batch if the top growing mappings are tracked, it adds RSS to each group */
+    if (collect_mapping_summary(pid, render_config.top_growing, &render_mapping_groups) < 0) {
+        return;
+    }
+
+    fprintf(report_output, "Mappings: %zu - Groups: %zu\n", render_mapping_groups.mapping_count, render_mapping_groups.count);
+
+    /* print header */
+    fprintf(report_output, "%-8s %-9s %-15s     %-15s     %-5s %-6s %-12s %s\n", "TYPE", "COUNT", "SIZE", "RSS", "PERM", "DEV", "INODE", "FILE PATH");
+
+    for (i = 0; i < render_mapping_groups.count; ++i) {
+        group = &render_mapping_groups.groups[i];
+
+        fprintf(report_output, "%-8s %-9zu %-15lu kB  ", get_mapping_object_type_name(group->type), group->count, group->size / 1024);
+
+        if (group->rss >= 0) {
+            fprintf(report_output, "%-15ld kB  ", group->rss);
+        } else {
+            fprintf(report_output, "%-15s     ", "n/a");
+        }
+
+        fprintf(report_output, "%-5s %-6s %-12ld %s\n", group->permission_bits, group->dev, group->file_inode, group->file_pathname);
+    }
+    fflush(report_output);
+}
+
+static void render_thread_census(pid_t pid) {
+    struct thread_group *group;
+    size_t i;
+
+    if (collect_thread_census(pid, render_config.threads_budget, &render_threads) < 0) {
+        return;
+    }
+
+    fprintf(report_output, "Threads: %zu", render_threads.thread_count);
+    if (render_threads.growth_available) {
+        fprintf(report_output, " - Growth: %+.1f/s\n", render_threads.growth_rate);
+    } else {
+        fprintf(report_output, " - Growth: n/a\n");
+    }
+
+    fprintf(report_output, "Sampled Threads: %zu - Stride: %zu - Unknown Stack Pointers: %zu\n", render_threads.sampled, render_threads.stride, render_threads.unknown_stacks);
+    fprintf(report_output, "Thread Stacks: %zu - Stack Size: %lu kB\n", render_threads.stacks, render_threads.stack_size / 1024);
+
+    /* only known if every thread is sampled, a thread without a stack pointer may still own one of them */
+    if (render_threads.stride == 1) {
+        fprintf(report_output, "Stacks without a Thread: %zu - Stack Size: %lu kB\n", render_threads.unowned_stacks, render_threads.unowned_stack_size / 1024);
+    }
+
+    /* print header, THREADS is estimated from the samples */
+    fprintf(report_output, "%-16s %-9s %-9s %-9s %s\n", "COMM", "THREADS", "SAMPLED", "STACKS", "STACK SIZE");
+
+    for (i = 0; i < render_threads.group_count && i < THREAD_CENSUS_MAX_GROUPS; ++i) {
+        group = &render_threads.groups[i];
+
+        fprintf(report_output, "%-16s %-9zu %-9zu %-9zu %lu kB\n", group->comm, render_threads.sampled > 0 ? group->sampled * render_threads.thread_count / render_threads.sampled : 0, group->sampled, group->stacks, group->stack_size / 1024);
+    }
+
+    if (render_threads.group_count > THREAD_CENSUS_MAX_GROUPS) {
+        fprintf(report_output, "... %zu more thread group(s) are not listed\n", render_threads.group_count - THREAD_CENSUS_MAX_GROUPS);
+    }
+    fflush(report_output);
+}
+
+static void render_network_connections(pid_t pid) {
+    struct socket_record *socket;
+    char local_address_string[INET6_ADDRSTRLEN];
+    char remote_address_string[INET6_ADDRSTRLEN];
+    size_t i;
+
+    if (collect_network_connections(pid, &render_sockets) < 0) {
+        return;
+    }
+
+    /* print header */
+    fprintf(report_output, "%-6s%-13s%-45s%-8s%-45s%-8s%-10s%-10s%-12s%-12s%-12s%-12s\n", "PROT", "STATE", "L.ADDR", "L.PORT", "R.ADDR", "R.PORT", "TX QUEUE", "RX QUEUE", "SK RMEM", "SK WMEM Q", "SK FWD", "SK CHARGED");
+
+    for (i = 0; i < render_sockets.count; ++i) {
+        socket = &render_sockets.sockets[i];
+
+        /* addresses are only formatted for the sockets of the process */
+        if (inet_ntop(socket->family, socket->local_address, local_address_string, sizeof(local_address_string)) == NULL || inet_ntop(socket->family, socket->remote_address, remote_address_string, sizeof(remote_address_string)) == NULL) {
+            continue;
+        }
+
+        /* print network connection stats */
+        fprintf(report_output, "%-6s%-13s%-45s%-8d%-45s%-8d%-10ld%-10ld", socket->protocol, get_socket_state_name(socket->socket_state), local_address_string, socket->local_port, remote_address_string, socket->remote_port, socket->tx_queue, socket->rx_queue);
+
+        if (socket->skmem_status == 1) {
+            fprintf(report_output, "%-12ld%-12ld%-12ld%-12ld\n", socket->skmem.rmem_alloc, socket->skmem.wmem_queued, socket->skmem.fwd_alloc, get_socket_charged_memory(&socket->skmem));
+        } else {
+            fprintf(report_output, "%-12s%-12s%-12s%-12s\n", "n/a", "n/a", "n/a", "n/a");
+        }
+    }
+    fflush(report_output);
+}
+
+static void render_memory_sections(struct report *report, long *summary_length) {
+    struct meminfo *memory_data = &report->memory_data;
+    pid_t pid = report->pid;
+    struct netstat_parse_stats netstat_parse_stats;
+    struct process_tree_cache_stats process_tree_cache_stats;
+    struct live_section section;
+
+    int ret_get_memory_usage;
+    int ret_get_page_tables_usage;
+    int ret_get_oom_score;
+
+    live_read_first = 0;
+    live_read_last = 0;
+    live_section_names[0] = '\0';
+
+    begin_live_section(&section);
+
+    ret_get_memory_usage = get_memory_usage(pid, &memory_data->process_rss, &memory_data->process_pss, &memory_data->process_uss);
+    if (ret_get_memory_usage < 0) {
+        fprintf(stderr, "ERROR: failed to get process memory usage information\n\n");
+        return;
+    }
+
+    /* get process page tables usage */
+    ret_get_page_tables_usage = get_page_tables_usage(pid, &memory_data->process_page_tables_size);
+    if (ret_get_page_tables_usage < 0) {
+        fprintf(stderr, "ERROR: failed to get process page tables usage information\n\n");
+        return;
+    }
+
+    /* print process memory and page tables usage information */
+    fprintf(report_output, "%s\n", PROCESS_MEMORY_INFO_BANNER);
+    fflush(report_output);
+
+    fprintf(report_output, "Total System Memory: %ld kB\n", memory_data->total_memory);
+    fprintf(report_output, "Process RSS Memory Usage: %ld kB\n", memory_data->process_rss);
+    fprintf(report_output, "Process PSS Memory Usage: %ld kB\n", memory_data->process_pss);
+    fprintf(report_output, "Process USS Memory Usage: %ld kB\n", memory_data->process_uss);
+    fprintf(report_output, "Process Page Tables Usage: %ld kB\n", memory_data->process_page_tables_size);
+
+    /* kernel socket buffers are charged to the cgroup of the process but are not part of its RSS */
+    if (get_socket_memory_usage(pid, &memory_data->process_socket_memory) < 0) {
+        fprintf(report_output, "Process Socket Memory Usage: n/a\n");
+    } else {
+        fprintf(report_output, "Process Socket Memory Usage: %ld kB (live)\n", memory_data->process_socket_memory);
+    }
+    fflush(report_output);
+
+    ret_get_oom_score = get_oom_score(pid, &memory_data->process_oom_score, &memory_data->process_oom_score_adj);
+    if (ret_get_oom_score < 0) {
+        fprintf(stderr, "WARNING: failed to get process OOM score\n");
+    } else {
+        fprintf(report_output, "Process OOM Score: %d\n", memory_data->process_oom_score);
+        fprintf(report_output, "Process OOM Score Adjustment Value: %d\n", memory_data->process_oom_score_adj);
+        fflush(report_output);
+    }
+
+    /* socket memory is queried through sock_diag, it is not part of the batch */
+    end_live_section(report, &section, "memory", 1);
+
+    fprintf(report_output, "\n");
+    fflush(report_output);
+
+    /* the basic and memory sections are kept when the output falls behind */
+    *summary_length = ftell(report_output);
+
+    /* print the anonymous memory dump taken when this report crossed the threshold */
+    if (report->dump_data.status != 0) {
+        fprintf(report_output, "%s\n", PROCESS_MEMORY_DUMP_INFO_BANNER);
+
+        if (report->dump_data.status > 0) {
+            fprintf(report_output, "Dump File: %s\n", report->dump_data.path);
+            fprintf(report_output, "Dumped Mappings: %zu - Dumped: %lu kB - Written: %lu kB - Zero: %lu kB - Unreadable: %lu kB - Dump Time: %ld us\n", report->dump_data.vma_count, report->dump_data.bytes_read / 1024, report->dump_data.bytes_written / 1024, report->dump_data.zero_bytes / 1024, report->dump_data.unreadable_bytes / 1024, report->dump_data.latency);
+        } else {
+            fprintf(report_output, "Dump File: %s (failed)\n", report->dump_data.path);
+        }
+
+        fprintf(report_output, "\n");
+        fflush(report_output);
+    }
+
+    /* print NUMA node memory information, numa_maps is parsed from the batch unless the per-node threshold has parsed it */
+    if (render_config.numa && (report->sections & TRIGGER_SECTION_NUMA)) {
+        fprintf(report_output, "%s\n", PROCESS_NUMA_MEMORY_INFO_BANNER);
+        fflush(report_output);
+
+        begin_live_section(&section);
+        if (report->numa_data.loaded || get_numa_memory(pid, &report->numa_data) == 0) {
+            get_numa_memory_report(&report->numa_data);
+        } else {
+            fprintf(stderr, "ERROR: failed to get NUMA memory information of PID %d\n", pid);
+        }
+        end_live_section(report, &section, "numa", 0);
+
+        fprintf(report_output, "\n");
+        fflush(report_output);
+    }
+
+    /* print cgroup memory information, the members are read at render time */
+    if (render_config.cgroup && (report->sections & TRIGGER_SECTION_CGROUP)) {
+        fprintf(report_output, "%s\n", CGROUP_MEMORY_INFO_BANNER);
+        fflush(report_output);
+
+        begin_live_section(&section);
+        get_cgroup_memory_report(&report->cgroup_data);
+        end_live_section(report, &section, "cgroup", 1);
+
+        fprintf(report_output, "\n");
+        fflush(report_output);
+    }
+
+    /* print system-wide reclaim activity, the deltas are calculated by the capture thread */
+    if (render_config.vmstat && (report->sections & TRIGGER_SECTION_VMSTAT)) {
+        fprintf(report_output, "%s\n", SYSTEM_MEMORY_ACTIVITY_INFO_BANNER);
+        fflush(report_output);
+
+        get_vmstat_activity_report(&report->vmstat_data);
+
+        fprintf(report_output, "\n");
+        fflush(report_output);
+    }
+
+    /* print system-wide top memory consumers, /proc/pid/statm of every process is scanned at render time */
+    if (render_config.top_consumers && (report->sections & TRIGGER_SECTION_CONSUMERS)) {
+        fprintf(report_output, "%s\n", SYSTEM_TOP_CONSUMERS_INFO_BANNER);
+        fflush(report_output);
+
+        begin_live_section(&section);
+        get_top_memory_consumers(render_config.top_consumers_count);
+        end_live_section(report, &section, "consumers", 1);
+
+        fprintf(report_output, "\n");
+        fflush(report_output);
+    }
+
+    /* print process tree information */
+    if (report->sections & TRIGGER_SECTION_TREE) {
+        fprintf(report_output, "%s\n", PROCESS_TREE_INFO_BANNER);
+        fflush(report_output);
+
+        begin_live_section(&section);
+        render_process_tree(pid);
+        end_live_section(report, &section, "tree", 0);
+
+        fprintf(report_output, "\n");
+        fflush(report_output);
+    }
+
+    /* print thread information, the task directory and the per-thread files are read at render time */
+    if (render_config.threads && (report->sections & TRIGGER_SECTION_THREADS)) {
+        fprintf(report_output, "%s\n", PROCESS_THREAD_INFO_BANNER);
+        fflush(report_output);
+
+        begin_live_section(&section);
+        render_thread_census(pid);
+        end_live_section(report, &section, "threads", 1);
+
+        fprintf(report_output, "\n");
+        fflush(report_output);
+    }
+
+    /* print process memory mapping information */
+    if (render_config.mapping_mode != MAPPING_REPORT_SUMMARY && (report->sections & TRIGGER_SECTION_MAPPINGS)) {
+        fprintf(report_output, "%s\n", PROCESS_MEMORY_MAPPING_INFO_BANNER);
+        fflush(report_output);
+
+        begin_live_section(&section);
+        render_memory_mappings(pid);
+        end_live_section(report, &section, "mappings", 0);
+
+        fprintf(report_output, "\n");
+        fflush(report_output);
+    }
+
+    /* print process memory mapping summary information */
+    if (render_config.mapping_mode != MAPPING_REPORT_FULL && (report->sections & TRIGGER_SECTION_MAPPINGS)) {
+        fprintf(report_output, "%s\n", PROCESS_MEMORY_MAPPING_SUMMARY_INFO_BANNER);
+        fflush(report_output);
+
+        begin_live_section(&section);
+        render_mapping_summary(pid);
+        end_live_section(report, &section, "mapping summary", 0);
+
+        fprintf(report_output, "\n");
+        fflush(report_output);
+    }
+
+    /* print process top growing memory mapping information */
+    if (render_config.top_growing && (report->sections & TRIGGER_SECTION_GROWING)) {
+        fprintf(report_output, "%s\n", PROCESS_TOP_GROWING_MAPPING_INFO_BANNER);
+        fflush(report_output);
+
+        begin_live_section(&section);
+        get_top_growing_mappings(pid, render_config.top_growing_count, report->capture_time);
+        end_live_section(report, &section, "growing", 0);
+
+        fprintf(report_output, "\n");
+        fflush(report_output);
+    }
+
+    /* print process pagemap information, the sampled scan reads /proc/pid/pagemap at render time */
+    if (render_config.pagemap && (report->sections & TRIGGER_SECTION_PAGEMAP)) {
+        fprintf(report_output, "%s\n", PROCESS_PAGEMAP_INFO_BANNER);
+        fflush(report_output);
+
+        begin_live_section(&section);
+        get_pagemap_usage(pid, render_config.pagemap_stride, render_config.pagemap_budget);
+        end_live_section(report, &section, "pagemap", 1);
+
+        fprintf(report_output, "\n");
+        fflush(report_output);
+    }
+
+    /* print process network connection information */
+    if (report->sections & TRIGGER_SECTION_NETWORK) {
+        fprintf(report_output, "%s\n", PROCESS_NETWORK_CONNECTION_INFO_BANNER);
+        fflush(report_output);
+
+        begin_live_section(&section);
+        render_network_connections(pid);
+        end_live_section(report, &section, "network", 1);
+
+        fprintf(report_output, "\n");
+        fflush(report_output);
+    }
+
+    /* the capture window of the basic information section does not cover these reads */
+    if (live_read_first != 0) {
+        fprintf(report_output, "Render Read Window: %ld - %ld us after the capture - Live Sections: %s\n\n", get_capture_offset(report, live_read_first), get_capture_offset(report, live_read_last), live_section_names);
+        fflush(report_output);
+    }
+
+    /* print procfs batch statistics */
+    if (render_config.io_stats) {
+        get_netstat_parse_stats(&netstat_parse_stats);
+        get_process_tree_cache_stats(&process_tree_cache_stats);
+
+        fprintf(report_output, "Procfs Batch: %s - Files: %zu - Syscalls: %lu - Latency: %ld us\n", report->procfs_stats.io_uring ? "io_uring" : "blocking", report->procfs_stats.files, report->procfs_stats.syscalls, report->procfs_stats.latency);
+        fprintf(report_output, "Network Table Lines: %lu - Reused: %lu(%lu%%)\n", netstat_parse_stats.lines, netstat_parse_stats.reused_lines, netstat_parse_stats.lines > 0 ? netstat_parse_stats.reused_lines * 100 / netstat_parse_stats.lines : 0);
+        fprintf(report_output, "Process Tree Cache: Hits: %lu - Misses: %lu - Memory Refreshes: %lu\n\n", process_tree_cache_stats.hits, process_tree_cache_stats.misses, process_tree_cache_stats.refreshes);
+        fflush(report_output);
+    }
+
+    fprintf(report_output, "\n");
+    fflush(report_output);
+}
+
+static void render_full_report(struct report *report, long *summary_length) {
+    /* procfs reads are served from the captured batch, network tables of the previous report are outdated */
+    procfs_batch_use(report->batch);
+    netns_cache_next_cycle();
+
+    render_memory_sections(report, summary_length);
+
+    procfs_batch_use(NULL);
+}
+
+static void render_report(struct report *report) {
+    char *output_buffer = NULL;
+    size_t output_length = 0;
+    long summary_length = -1;
+    int pressure_node;
+
+    /* the report is rendered into a buffer, which is handed over to the output writer */
+    report_output = open_memstream(&output_buffer, &output_length);
+    if (report_output == NULL) {
+        fprintf(stderr, "WARNING: failed to allocate the report buffer, the report is written directly: %s\n", strerror(errno));
+        report_output = stdout;
+    }
+
+    /* files read while rendering are archived together with the batch */
+    if (is_archive_open()) {
+        archive_begin_cycle();
+    }
+
+    /* print timestamp */
+    print_report_time(report->report_time);
+
+    /* print process basic information */
+    fprintf(report_output, "%s\n", PROCESS_BASIC_INFO_BANNER);
+    fprintf(report_output, "PID: %d\n", report->pid);
+    fprintf(report_output, "Executable Absolute Path: %s\n", report->exename);
+    fprintf(report_output, "Capture Window: %ld us\n", report->capture_window);
+    fprintf(report_output, "Scheduling Latency: %ld us\n", report->sched_latency);
+    if (report->trigger_rule >= 0) {
+        fprintf(report_output, "Triggered By: %s\n", get_trigger_rule_text(report->trigger_rule));
+    }
+    fprintf(report_output, "\n");
+    fflush(report_output);
+
+    if (report->status == REPORT_BELOW_THRESHOLD && render_config.cgroup) {
+        fprintf(report_output, "Cgroup memory usage(%ld kB of %ld kB) is not equal to or greater than input memory pressure threshold\n\n", report->cgroup_data.current, report->cgroup_data.limit);
+        fflush(report_output);
+    } else if (report->status == REPORT_BELOW_THRESHOLD && report->numa_data.loaded && get_numa_pressure(&report->numa_data, &pressure_node) >= 0) {
+        fprintf(report_output, "Process memory usage on NUMA node %d(%ld kB of %ld kB) is not equal to or greater than input memory pressure threshold\n\n", pressure_node, report->numa_data.nodes[pressure_node].process_total, report->numa_data.nodes[pressure_node].total);
+        fflush(report_output);
+    } else if (report->status == REPORT_BELOW_THRESHOLD && get_trigger_rule_count() > 0) {
+        fprintf(report_output, "Process memory usage does not reach input memory pressure threshold or meet any trigger rule\n\n");
+        fflush(report_output);
+    } else if (report->status == REPORT_BELOW_THRESHOLD) {
+        fprintf(report_output, "Process memory usage is not equal to or greater than input memory pressure threshold\n\n");
+        fflush(report_output);
+    }
+
+    if (report->status == REPORT_FULL) {
+        render_full_report(report, &summary_length);
+    }
+
+    if (is_archive_open()) {
+        archive_end_cycle(report);
+    }
+
+    publish_shm_stats(report);
+    update_trend_store(report);
+
+    if (report_output == stdout) {
+        return;
+    }
+
+    fclose(report_output);
+    report_output = NULL;
+
+    if (summary_length < 0) {
+        summary_length = output_length;
+    }
+
+    write_report_output(output_buffer, output_length, summary_length);
+}
+
+static void release_report(struct report *report) {
+    pthread_mutex_lock(&report_mutex);
+    report_slot_busy[report - report_slots] = 0;
+    pthread_cond_signal(&report_free_cond);
+    pthread_mutex_unlock(&report_mutex);
+}
+
+static void *render_reports(void *arg) {
+    struct report *report;
+    int nice_value;
+
+    /* suppress "unused parameter" warning  */
+    (void)arg;
+
+    /* lower the priority of this thread only, capturing runs on the default priority */
+    errno = 0;
+    nice_value = getpriority(PRIO_PROCESS, 0);
+    if (errno == 0) {
+        nice_value += REPORT_RENDER_NICE;
+        if (nice_value > 19) {
+            nice_value = 19;
+        }
+
+        if (setpriority(PRIO_PROCESS, syscall(SYS_gettid), nice_value) < 0) {
+            fprintf(stderr, "WARNING: failed to lower the render thread priority: %s\n", strerror(errno));
+        }
+    }
+
+    while (1) {
+        pthread_mutex_lock(&report_mutex);
+
+        while (report_queue_count == 0 && !render_thread_stopping) {
+            pthread_cond_wait(&report_queued_cond, &report_mutex);
+        }
+
+        /* pending reports are still rendered when stopping */
+        if (report_queue_count == 0) {
+            pthread_mutex_unlock(&report_mutex);
+            break;
+        }
+
+        report = &report_slots[report_queue[report_queue_head]];
+        report_queue_head = (report_queue_head + 1) % REPORT_SLOT_COUNT;
+        --report_queue_count;
+
+        pthread_mutex_unlock(&report_mutex);
+
+        render_report(report);
+        release_report(report);
+    }
+
+    procfs_thread_cleanup();
+
+    return NULL;
+}
+
+void start_report_renderer(struct report_config *config) {
+    pthread_attr_t render_attr;
+    struct sched_param render_param;
+    sigset_t block_set;
+    sigset_t old_set;
+    int ret_pthread_create;
+    int i;
+
+    render_config = *config;
+
+    /* rendered reports are written to stdout by their own thread */
+    start_output_writer(config->output_policy);
+
+    for (i = 0; i < REPORT_SLOT_COUNT; ++i) {
+        report_slots[i].batch = procfs_get_batch(i);
+    }
+
+    /* SIGINT is left to the capture thread, so that it interrupts sleep() between cycles */
+    sigemptyset(&block_set);
+    sigaddset(&block_set, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &block_set, &old_set);
+
+    /* the render thread never inherits a real-time policy of the capture thread */
+    memset(&render_param, 0, sizeof(render_param));
+    pthread_attr_init(&render_attr);
+    pthread_attr_setinheritsched(&render_attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&render_attr, SCHED_OTHER);
+    pthread_attr_setschedparam(&render_attr, &render_param);
+
+    ret_pthread_create = pthread_create(&render_thread, &render_attr, render_reports, NULL);
+
+    pthread_attr_destroy(&render_attr);
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+
+    if (ret_pthread_create != 0) {
+        fprintf(stderr, "WARNING: failed to start the render thread, reports are rendered by the capture thread: %s\n", strerror(ret_pthread_create));
+        return;
+    }
+
+    render_thread_started = 1;
+}
+
+struct report *acquire_report() {
+    struct report *report = NULL;
+    int i;
+
+    pthread_mutex_lock(&report_mutex);
+
+    /* a slow sink applies back pressure to capturing instead of queueing reports without limit */
+    while (report == NULL) {
+        for (i = 0; i < REPORT_SLOT_COUNT; ++i) {
+            if (!report_slot_busy[i]) {
+                report_slot_busy[i] = 1;
+                report = &report_slots[i];
+                break;
+            }
+        }
+
+        if (report == NULL) {
+            pthread_cond_wait(&report_free_cond, &report_mutex);
+        }
+    }
+
+    pthread_mutex_unlock(&report_mutex);
+
+    procfs_batch_begin(report->batch);
+
+    report->status = REPORT_BASIC;
+    report->statm_rss = 0;
+    report->capture_window = 0;
+    report->sched_latency = 0;
+    report->capture_time = 0;
+    memset(&report->memory_data, 0, sizeof(struct meminfo));
+    memset(&report->cgroup_data, 0, sizeof(struct cgroup_memory));
+    report->numa_data.loaded = 0;
+    report->dump_data.status = 0;
+    report->trigger_rule = -1;
+    report->sections = TRIGGER_SECTION_ALL;
+    memset(&report->procfs_stats, 0, sizeof(struct procfs_stats));
+
+    return report;
+}
+
+void submit_report(struct report *report) {
+    if (!render_thread_started) {
+        render_report(report);
+        release_report(report);
+        return;
+    }
+
+    pthread_mutex_lock(&report_mutex);
+    report_queue[(report_queue_head + report_queue_count) % REPORT_SLOT_COUNT] = report - report_slots;
+    ++report_queue_count;
+    pthread_cond_signal(&report_queued_cond);
+    pthread_mutex_unlock(&report_mutex);
+}
+
+void stop_report_renderer() {
+    if (!render_thread_started) {
+        stop_output_writer();
+        free_mapping_list(&render_mappings);
+        free_socket_list(&render_sockets);
+        free_mapping_summary(&render_mapping_groups);
+        free_thread_census(&render_threads);
+        return;
+    }
+
+    pthread_mutex_lock(&report_mutex);
+    render_thread_stopping = 1;
+    pthread_cond_signal(&report_queued_cond);
+    pthread_mutex_unlock(&report_mutex);
+
+    pthread_join(render_thread, NULL);
+
+    render_thread_started = 0;
+
+    /* the queued reports are written before the writer exits */
+    stop_output_writer();
+
+    free_mapping_list(&render_mappings);
+    free_socket_list(&render_sockets);
+    free_mapping_summary(&render_mapping_groups);
+    free_thread_census(&render_threads);
+}
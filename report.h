@@ -0,0 +1,92 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <limits.h>
+#include <time.h>
+#include <sys/types.h>
+#include "cgroup.h"
+#include "dump.h"
+#include "mapsummary.h"
+#include "numa.h"
+#include "process.h"
+#include "procfs.h"
+#include "vmstat.h"
+#include "writer.h"
+
+#define REPORT_SLOT_COUNT PROCFS_BATCH_COUNT /* each slot owns one procfs batch */
+#define REPORT_RENDER_NICE 10 /* the render thread runs this much nicer than the capture thread */
+
+#define PROCESS_BASIC_INFO_BANNER "##### PROCESS BASIC INFORMATION #####"
+#define PROCESS_MEMORY_INFO_BANNER "##### PROCESS MEMORY INFORMATION #####"
+#define PROCESS_TREE_INFO_BANNER "##### PROCESS TREE INFORMATION #####"
+#define PROCESS_THREAD_INFO_BANNER "##### PROCESS THREAD INFORMATION #####"
+#define PROCESS_MEMORY_MAPPING_INFO_BANNER "##### PROCESS MEMORY MAPPING INFORMATION #####"
+#define PROCESS_MEMORY_MAPPING_SUMMARY_INFO_BANNER "##### PROCESS MEMORY MAPPING SUMMARY INFORMATION #####"
+#define PROCESS_TOP_GROWING_MAPPING_INFO_BANNER "##### PROCESS TOP GROWING MEMORY MAPPING INFORMATION #####"
+#define PROCESS_PAGEMAP_INFO_BANNER "##### PROCESS PAGEMAP INFORMATION #####"
+#define PROCESS_NETWORK_CONNECTION_INFO_BANNER "##### PROCESS NETWORK CONNECTION INFORMATION #####"
+#define PROCESS_NUMA_MEMORY_INFO_BANNER "##### PROCESS NUMA MEMORY INFORMATION #####"
+#define PROCESS_MEMORY_DUMP_INFO_BANNER "##### PROCESS ANONYMOUS MEMORY DUMP INFORMATION #####"
+#define CGROUP_MEMORY_INFO_BANNER "##### CGROUP MEMORY INFORMATION #####"
+#define SYSTEM_MEMORY_ACTIVITY_INFO_BANNER "##### SYSTEM MEMORY RECLAIM ACTIVITY INFORMATION #####"
+#define SYSTEM_TOP_CONSUMERS_INFO_BANNER "##### SYSTEM TOP MEMORY CONSUMERS INFORMATION #####"
+
+enum report_status {
+    REPORT_BASIC, /* basic information only, collection failed before the memory pressure check */
+    REPORT_BELOW_THRESHOLD, /* process memory usage is below the memory pressure threshold */
+    REPORT_FULL /* all sections are rendered from the captured batch */
+};
+
+/* memory mapping sections of a full report */
+enum mapping_report_mode {
+    MAPPING_REPORT_FULL, /* one line per mapping */
+    MAPPING_REPORT_SUMMARY, /* mappings grouped by backing object and permissions */
+    MAPPING_REPORT_BOTH
+};
+
+/* report sections selected on the command line */
+struct report_config {
+    enum mapping_report_mode mapping_mode;
+    int top_growing;
+    long int top_growing_count;
+    int pagemap;
+    long int pagemap_stride;
+    long int pagemap_budget;
+    int io_stats;
+    int cgroup;
+    int numa;
+    int top_consumers;
+    long int top_consumers_count;
+    int vmstat;
+    int threads;
+    long int threads_budget;
+    enum writer_policy output_policy;
+};
+
+/* data captured in one cycle, rendered later by the render thread */
+struct report {
+    time_t report_time;
+    pid_t pid;
+    char exename[PATH_MAX];
+    enum report_status status;
+    struct meminfo memory_data;
+    long int statm_rss; /* unit: kB, RSS of the fast tier */
+    long capture_window; /* unit: microsecond */
+    long sched_latency; /* unit: microsecond, actual minus intended wakeup time of the cycle */
+    double capture_time; /* CLOCK_MONOTONIC seconds at the end of the capture */
+    struct cgroup_memory cgroup_data; /* cgroup mode only */
+    struct numa_memory numa_data; /* loaded by the capture thread if the threshold is evaluated per node */
+    struct vmstat_activity vmstat_data; /* loaded by the capture thread in every cycle if it is reported */
+    struct dump_result dump_data; /* the dump taken by the capture thread when the threshold was crossed */
+    int trigger_rule; /* index of the first trigger rule which was met, -1 if none */
+    unsigned int sections; /* heavy sections to render, a mask of enum trigger_section */
+    struct procfs_batch *batch;
+    struct procfs_stats procfs_stats;
+};
+
+extern void start_report_renderer(struct report_config *config);
+extern struct report *acquire_report();
+extern void submit_report(struct report *report);
+extern void stop_report_renderer();
+
+#endif /* REPORT_H */
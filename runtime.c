@@ -0,0 +1,152 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "runtime.h"
+
+static int set_io_priority(int io_class, int level) {
+    return syscall(SYS_ioprio_set, RUNTIME_IOPRIO_WHO_PROCESS, 0, (io_class << RUNTIME_IOPRIO_CLASS_SHIFT) | level);
+}
+
+int set_sched_fifo(int priority) {
+    struct sched_param param;
+
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+
+    /* only the calling thread is changed, the render thread is created with its own policy */
+    if (sched_setscheduler(0, SCHED_FIFO, &param) < 0) {
+        fprintf(stderr, "ERROR: failed to set SCHED_FIFO priority %d: %s\n", priority, strerror(errno));
+        return -1;
+    }
+
+    if (set_io_priority(RUNTIME_IOPRIO_CLASS_RT, RUNTIME_IOPRIO_RT_LEVEL) < 0) {
+        fprintf(stderr, "WARNING: failed to set real-time I/O priority: %s\n", strerror(errno));
+    }
+
+    return 0;
+}
+
+int set_nice(int nice_value) {
+    if (setpriority(PRIO_PROCESS, 0, nice_value) < 0) {
+        fprintf(stderr, "ERROR: failed to set nice value %d: %s\n", nice_value, strerror(errno));
+        return -1;
+    }
+
+    /* the same mapping the kernel uses for the best-effort level of a task without I/O priority */
+    if (set_io_priority(RUNTIME_IOPRIO_CLASS_BE, (nice_value + 20) / 5) < 0) {
+        fprintf(stderr, "WARNING: failed to set best-effort I/O priority: %s\n", strerror(errno));
+    }
+
+    return 0;
+}
+
+/* cpu_list is a comma separated list of CPUs and CPU ranges, e.g. "0,2-3" */
+int set_cpu_affinity(char *cpu_list) {
+    cpu_set_t cpu_set;
+    char *cursor = cpu_list;
+    char *end;
+    long first_cpu;
+    long last_cpu;
+    long cpu;
+
+    CPU_ZERO(&cpu_set);
+
+    while (*cursor != '\0') {
+        errno = 0;
+        first_cpu = strtol(cursor, &end, 10);
+        if (errno != 0 || end == cursor || first_cpu < 0) {
+            return -1;
+        }
+
+        last_cpu = first_cpu;
+        cursor = end;
+
+        if (*cursor == '-') {
+            ++cursor;
+
+            errno = 0;
+            last_cpu = strtol(cursor, &end, 10);
+            if (errno != 0 || end == cursor || last_cpu < first_cpu) {
+                return -1;
+            }
+
+            cursor = end;
+        }
+
+        if (last_cpu >= CPU_SETSIZE) {
+            return -1;
+        }
+
+        for (cpu = first_cpu; cpu <= last_cpu; ++cpu) {
+            CPU_SET(cpu, &cpu_set);
+        }
+
+        if (*cursor == ',') {
+            ++cursor;
+        } else if (*cursor != '\0') {
+            return -1;
+        }
+    }
+
+    if (CPU_COUNT(&cpu_set) == 0) {
+        return -1;
+    }
+
+    /* threads created afterwards inherit the affinity */
+    if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) < 0) {
+        fprintf(stderr, "ERROR: failed to set CPU affinity %s: %s\n", cpu_list, strerror(errno));
+        return -2;
+    }
+
+    return 0;
+}
+
+int protect_from_oom() {
+    FILE *oom_score_adj_file;
+
+    oom_score_adj_file = fopen("/proc/self/oom_score_adj", "w");
+    if (oom_score_adj_file == NULL) {
+        fprintf(stderr, "ERROR: failed to open /proc/self/oom_score_adj: %s\n", strerror(errno));
+        return -1;
+    }
+
+    /* lowering the value needs CAP_SYS_RESOURCE, the error shows up when the file is flushed */
+    if (fprintf(oom_score_adj_file, "%d\n", RUNTIME_OOM_SCORE_ADJ_MIN) < 0 || fclose(oom_score_adj_file) != 0) {
+        fprintf(stderr, "ERROR: failed to set OOM score adjustment value %d: %s\n", RUNTIME_OOM_SCORE_ADJ_MIN, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+/* sleep until the intended wakeup time of the next cycle, returns how late the wakeup is(unit: microsecond), or -1 if interrupted */
+long sleep_until_next_cycle(struct timespec *next_wakeup, long interval) {
+    struct timespec now;
+    long latency;
+    int ret_clock_nanosleep;
+
+    /* cycles are scheduled on absolute deadlines, so a late wakeup does not shift the following cycles */
+    next_wakeup->tv_sec += interval;
+
+    ret_clock_nanosleep = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, next_wakeup, NULL);
+    if (ret_clock_nanosleep != 0) {
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    latency = (now.tv_sec - next_wakeup->tv_sec) * 1000000L + (now.tv_nsec - next_wakeup->tv_nsec) / 1000L;
+
+    /* a cycle that took longer than the interval starts the schedule over instead of running back to back */
+    if (latency >= interval * 1000000L) {
+        *next_wakeup = now;
+    }
+
+    return latency;
+}
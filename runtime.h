@@ -0,0 +1,21 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <time.h>
+
+/* ioprio_set(2) has no glibc wrapper, the values are from linux/ioprio.h */
+#define RUNTIME_IOPRIO_WHO_PROCESS 1
+#define RUNTIME_IOPRIO_CLASS_SHIFT 13
+#define RUNTIME_IOPRIO_CLASS_RT 1
+#define RUNTIME_IOPRIO_CLASS_BE 2
+#define RUNTIME_IOPRIO_RT_LEVEL 4 /* the middle of the real-time class, other real-time I/O can still preempt memdoor */
+
+#define RUNTIME_OOM_SCORE_ADJ_MIN -1000
+
+extern int set_sched_fifo(int priority);
+extern int set_nice(int nice_value);
+extern int set_cpu_affinity(char *cpu_list);
+extern int protect_from_oom();
+extern long sleep_until_next_cycle(struct timespec *next_wakeup, long interval);
+
+#endif /* RUNTIME_H */
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "report.h"
+#include "shmstats.h"
+
+static struct shm_stats *shm_segment = NULL;
+static char shm_name[NAME_MAX];
+
+int open_shm_stats(char *name) {
+    int shm_fd;
+
+    if (name[0] != '/' || strlen(name) >= sizeof(shm_name) || strchr(name + 1, '/') != NULL) {
+        fprintf(stderr, "ERROR: shared-memory name must start with / and contain no other /: %s\n", name);
+        return -1;
+    }
+
+    /* readers only need read permission */
+    shm_fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (shm_fd < 0) {
+        fprintf(stderr, "ERROR: failed to open the shared-memory segment %s: %s\n", name, strerror(errno));
+        return -1;
+    }
+
+    if (ftruncate(shm_fd, sizeof(struct shm_stats)) < 0) {
+        fprintf(stderr, "ERROR: failed to resize the shared-memory segment %s: %s\n", name, strerror(errno));
+        close(shm_fd);
+        shm_unlink(name);
+        return -1;
+    }
+
+    shm_segment = (struct shm_stats *)mmap(NULL, sizeof(struct shm_stats), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    close(shm_fd);
+
+    if (shm_segment == MAP_FAILED) {
+        fprintf(stderr, "ERROR: failed to map the shared-memory segment %s: %s\n", name, strerror(errno));
+        shm_segment = NULL;
+        shm_unlink(name);
+        return -1;
+    }
+
+    strcpy(shm_name, name);
+
+    /* the layout is published last, a reader of a reused segment sees either the old or the new layout */
+    __atomic_store_n(&shm_segment->magic, 0, __ATOMIC_RELEASE);
+    memset(&shm_segment->payload, 0, sizeof(shm_segment->payload));
+    shm_segment->version = SHM_STATS_VERSION;
+    shm_segment->size = sizeof(struct shm_stats);
+    shm_segment->writer_pid = getpid();
+    __atomic_store_n(&shm_segment->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&shm_segment->magic, SHM_STATS_MAGIC, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/* called by the render thread, the only writer of the segment */
+void publish_shm_stats(struct report *report) {
+    struct shm_stats_payload *payload;
+    uint64_t sequence;
+
+    if (shm_segment == NULL) {
+        return;
+    }
+
+    payload = &shm_segment->payload;
+    sequence = __atomic_load_n(&shm_segment->sequence, __ATOMIC_RELAXED);
+
+    /* an odd sequence tells readers to retry, the fence keeps the payload stores after it */
+    __atomic_store_n(&shm_segment->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    ++payload->update_count;
+    payload->report_time = report->report_time;
+    payload->pid = report->pid;
+    payload->status = report->status;
+    payload->total_memory = report->memory_data.total_memory;
+    payload->statm_rss = report->statm_rss;
+    payload->capture_window = report->capture_window;
+    payload->sched_latency = report->sched_latency;
+
+    /* the memory fields keep the values of the last full report */
+    if (report->status == REPORT_FULL) {
+        payload->memory_report_time = report->report_time;
+        payload->process_rss = report->memory_data.process_rss;
+        payload->process_pss = report->memory_data.process_pss;
+        payload->process_uss = report->memory_data.process_uss;
+        payload->process_page_tables_size = report->memory_data.process_page_tables_size;
+        payload->process_oom_score = report->memory_data.process_oom_score;
+        payload->process_oom_score_adj = report->memory_data.process_oom_score_adj;
+    }
+
+    __atomic_store_n(&shm_segment->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+void close_shm_stats() {
+    if (shm_segment == NULL) {
+        return;
+    }
+
+    /* mapped readers keep the last values, new readers no longer find the segment */
+    munmap(shm_segment, sizeof(struct shm_stats));
+    shm_segment = NULL;
+
+    shm_unlink(shm_name);
+}
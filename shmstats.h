@@ -0,0 +1,70 @@
+#ifndef SHMSTATS_H
+#define SHMSTATS_H
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * layout of the shared-memory stats segment, readers mmap() /dev/shm/<name> read-only and use read_shm_stats()
+ * fields are only appended to the payload, a reader checks the version and that size covers the fields it uses
+ */
+#define SHM_STATS_MAGIC 0x4d444d53 /* "MDMS" */
+#define SHM_STATS_VERSION 1
+
+struct shm_stats_payload {
+    uint64_t update_count; /* number of published reports */
+    int64_t report_time; /* unix time of the latest report */
+    int64_t memory_report_time; /* unix time of the latest report with memory sections, 0 if none yet */
+    int32_t pid;
+    int32_t status; /* enum report_status of the latest report */
+    int64_t total_memory; /* unit: kB */
+    int64_t statm_rss; /* unit: kB, 0 if the memory pressure threshold is not used */
+    int64_t capture_window; /* unit: microsecond */
+    int64_t sched_latency; /* unit: microsecond */
+    /* from the latest report with memory sections */
+    int64_t process_rss; /* unit: kB */
+    int64_t process_pss; /* unit: kB */
+    int64_t process_uss; /* unit: kB */
+    int64_t process_page_tables_size; /* unit: kB */
+    int32_t process_oom_score;
+    int32_t process_oom_score_adj;
+};
+
+struct shm_stats {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size; /* sizeof(struct shm_stats) of the writer */
+    int32_t writer_pid; /* PID of memdoor */
+    uint64_t sequence; /* seqlock, odd while the payload is being updated */
+    struct shm_stats_payload payload;
+};
+
+/* copy a consistent snapshot of the payload without syscalls, returns -1 if the segment has another layout */
+static inline int read_shm_stats(const struct shm_stats *segment, struct shm_stats_payload *payload) {
+    uint64_t sequence;
+
+    if (segment->magic != SHM_STATS_MAGIC || segment->version != SHM_STATS_VERSION || segment->size < sizeof(struct shm_stats)) {
+        return -1;
+    }
+
+    do {
+        sequence = __atomic_load_n(&segment->sequence, __ATOMIC_ACQUIRE);
+        if (sequence & 1) {
+            continue;
+        }
+
+        memcpy(payload, (const void *)&segment->payload, sizeof(struct shm_stats_payload));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((sequence & 1) || sequence != __atomic_load_n(&segment->sequence, __ATOMIC_RELAXED));
+
+    return 0;
+}
+
+/* writer side, used by memdoor */
+struct report;
+
+extern int open_shm_stats(char *name);
+extern void publish_shm_stats(struct report *report);
+extern void close_shm_stats();
+
+#endif /* SHMSTATS_H */
@@ -0,0 +1,225 @@
+/*
+ * compare the /proc/net line parser with the sscanf parser it replaced: generated IPv4 and IPv6 tables in upper and
+ * lower case hex, with some lines broken by a non-hex byte, are parsed with each hex decoder forced. the binary fields
+ * of every line must match the sscanf parser, and the vectorized decoders must accept and reject the same lines as
+ * the scalar one. network.c is included so that its static decoders and line parser can be reached
+ */
+#include "network.c"
+
+#define CHECK_DEFAULT_LINES 1000000
+
+/* bytes around the hex ranges and with the 0x20 or the sign bit set, none of them is a hex digit */
+static const char invalid_hex[] = {'/', ':', '@', 'G', '`', 'g', ' ', 'x', 'X', 'P', 'p', (char)0x80, (char)0xb0, (char)0xc1, (char)0xe6, (char)0xff};
+
+static uint64_t check_seed = 0x2545f4914f6cdd1dULL;
+
+/* xorshift64*, the tables are reproducible from the seed */
+static uint64_t check_random(void) {
+    check_seed ^= check_seed >> 12;
+    check_seed ^= check_seed << 25;
+    check_seed ^= check_seed >> 27;
+
+    return check_seed * 0x2545f4914f6cdd1dULL;
+}
+
+/* print value with width hex digits, each letter in random case */
+static char *put_hex(char *cursor, uint32_t value, int width) {
+    static const char upper[] = "0123456789ABCDEF";
+    static const char lower[] = "0123456789abcdef";
+    uint64_t cases = check_random();
+    int i;
+
+    for (i = width - 1; i >= 0; --i) {
+        *cursor++ = ((cases >> i) & 1) ? lower[(value >> (4 * (width - 1 - i))) & 0xf] : upper[(value >> (4 * (width - 1 - i))) & 0xf];
+    }
+
+    return cursor;
+}
+
+static char *put_address(char *cursor, int ipv6) {
+    int i;
+
+    for (i = 0; i < (ipv6 ? 4 : 1); ++i) {
+        cursor = put_hex(cursor, (uint32_t)check_random(), 8);
+    }
+    *cursor++ = ':';
+
+    return put_hex(cursor, (uint32_t)check_random() & 0xffff, 4);
+}
+
+/* one table line in the layout of /proc/net/tcp{,6}, returns its length */
+static size_t generate_netstat_line(char *line, unsigned long slot, int ipv6, int *broken) {
+    char *cursor = line;
+    char *hex_start;
+    char *hex_end;
+    uint64_t value;
+
+    cursor += sprintf(cursor, "%4lu: ", slot);
+    hex_start = cursor;
+    cursor = put_address(cursor, ipv6);
+    *cursor++ = ' ';
+    cursor = put_address(cursor, ipv6);
+    *cursor++ = ' ';
+    cursor = put_hex(cursor, 1 + check_random() % 11, 2);
+    *cursor++ = ' ';
+    cursor = put_hex(cursor, (uint32_t)check_random(), 8);
+    *cursor++ = ':';
+    cursor = put_hex(cursor, (uint32_t)check_random(), 8);
+    hex_end = cursor;
+    value = check_random();
+    cursor += sprintf(cursor, " 00:00000000 00000000 %5lu %8lu %lu 1 0000000000000000 100 0 0 10 0\n", (unsigned long)(value % 65536), (unsigned long)((value >> 16) % 1000), (unsigned long)(value >> 32));
+
+    /* one line in 16 gets a non-hex byte in one of its hex columns */
+    value = check_random();
+    *broken = value % 16 == 0;
+    if (*broken) {
+        value >>= 4;
+        hex_start[value % (size_t)(hex_end - hex_start)] = invalid_hex[(value >> 16) % sizeof(invalid_hex)];
+    }
+
+    return cursor - line;
+}
+
+static int parse_address_sscanf(const char *hex, int ipv6, unsigned char *address) {
+    unsigned int words[4];
+
+    if (ipv6) {
+        if (sscanf(hex, "%08X%08X%08X%08X", &words[0], &words[1], &words[2], &words[3]) < 4) {
+            return -1;
+        }
+        memcpy(address, words, 16);
+    } else {
+        if (sscanf(hex, "%X", &words[0]) < 1) {
+            return -1;
+        }
+        memcpy(address, &words[0], 4);
+    }
+
+    return 0;
+}
+
+/* the sscanf parser of load_netstat() before parse_netstat_line(), the reference of the binary fields */
+static int parse_netstat_line_sscanf(const char *line, int ipv6, struct netstat *node) {
+    const char *format = "%d: %64[0-9A-Fa-f]:%X %64[0-9A-Fa-f]:%X %X %lX:%lX %X:%lX %lX %d %d %ld %*s";
+    int index;
+    char local_address[128];
+    unsigned int local_port;
+    char remote_address[128];
+    unsigned int remote_port;
+    unsigned int socket_state;
+    unsigned long tx_queue;
+    unsigned long rx_queue;
+    unsigned int timer_active;
+    unsigned long time_length;
+    unsigned long retry;
+    int uid;
+    int timeout;
+    long int socket_inode;
+
+    if (sscanf(line, format, &index, local_address, &local_port, remote_address, &remote_port, &socket_state, &tx_queue, &rx_queue, &timer_active, &time_length, &retry, &uid, &timeout, &socket_inode) < 14) {
+        return -1;
+    }
+
+    if (parse_address_sscanf(local_address, ipv6, node->local_address) < 0 || parse_address_sscanf(remote_address, ipv6, node->remote_address) < 0) {
+        return -1;
+    }
+
+    node->family = ipv6 ? AF_INET6 : AF_INET;
+    node->socket_state = (int)socket_state;
+    node->socket_inode = socket_inode;
+    node->local_port = (int)local_port;
+    node->remote_port = (int)remote_port;
+    node->tx_queue = (long int)tx_queue;
+    node->rx_queue = (long int)rx_queue;
+
+    return 0;
+}
+
+static int same_netstat(const struct netstat *a, const struct netstat *b) {
+    return a->family == b->family && a->socket_state == b->socket_state && a->socket_inode == b->socket_inode &&
+        memcmp(a->local_address, b->local_address, sizeof(a->local_address)) == 0 && a->local_port == b->local_port &&
+        memcmp(a->remote_address, b->remote_address, sizeof(a->remote_address)) == 0 && a->remote_port == b->remote_port &&
+        a->tx_queue == b->tx_queue && a->rx_queue == b->rx_queue;
+}
+
+/*
+ * parse one generated table with every available decoder, returns the number of mismatches. a broken line may be
+ * accepted by the lenient sscanf parser, e.g. " 0x" in a hex column, so only its rejection is compared between decoders
+ */
+static unsigned long check_table(unsigned long line_count, int ipv6) {
+    static const enum hex_decoder decoders[] = {HEX_DECODER_SCALAR, HEX_DECODER_SSE2, HEX_DECODER_AVX2};
+    static const char *decoder_names[] = {"scalar", "sse2", "avx2"};
+    char line[512];
+    struct netstat expected;
+    struct netstat parsed;
+    const char *entry;
+    size_t length;
+    unsigned long rejected = 0;
+    unsigned long mismatches = 0;
+    unsigned long slot;
+    int expected_result;
+    int scalar_result = 0;
+    int broken;
+    int result;
+    int d;
+
+    for (slot = 0; slot < line_count; ++slot) {
+        length = generate_netstat_line(line, slot, ipv6, &broken);
+        entry = skip_netstat_slot(line);
+
+        memset(&expected, 0, sizeof(expected));
+        expected_result = parse_netstat_line_sscanf(line, ipv6, &expected);
+
+        for (d = 0; d < (int)(sizeof(decoders) / sizeof(decoders[0])); ++d) {
+#if defined(__SSE2__)
+            if (decoders[d] == HEX_DECODER_AVX2 && !__builtin_cpu_supports("avx2")) {
+                continue;
+            }
+#else
+            if (decoders[d] != HEX_DECODER_SCALAR) {
+                continue;
+            }
+#endif
+
+            memset(&parsed, 0, sizeof(parsed));
+            hex_decoder = decoders[d];
+            result = parse_netstat_line(entry, line + length, ipv6, &parsed);
+            if (decoders[d] == HEX_DECODER_SCALAR) {
+                scalar_result = result;
+                rejected += result < 0;
+            }
+
+            /* an accepted line must be accepted by the sscanf parser with the same fields */
+            if ((result == 0 && (expected_result < 0 || !same_netstat(&parsed, &expected))) || (!broken && result != expected_result) || result != scalar_result) {
+                if (mismatches < 10) {
+                    fprintf(stderr, "%s: %s differs from sscanf (%d, %d): %.*s", ipv6 ? "ipv6" : "ipv4", decoder_names[d], result, expected_result, (int)length, line);
+                }
+                ++mismatches;
+            }
+        }
+    }
+
+    printf("%s: %lu lines, %lu rejected, %lu mismatches\n", ipv6 ? "ipv6" : "ipv4", line_count, rejected, mismatches);
+
+    return mismatches;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long line_count = CHECK_DEFAULT_LINES;
+    unsigned long mismatches;
+
+    if (argc > 1) {
+        line_count = strtoul(argv[1], NULL, 10);
+    }
+
+#if defined(__SSE2__)
+    printf("decoders: scalar sse2%s\n", __builtin_cpu_supports("avx2") ? " avx2" : "");
+#else
+    printf("decoders: scalar\n");
+#endif
+
+    mismatches = check_table(line_count, 0);
+    mismatches += check_table(line_count, 1);
+
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
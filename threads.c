@@ -0,0 +1,385 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "process.h"
+#include "procfs.h"
+#include "threads.h"
+#include "utils.h"
+
+/* make room for one more element of a census array, the arrays only grow */
+static int reserve_census_array(void **array, size_t *capacity, size_t count, size_t element_size) {
+    void *new_array;
+    size_t new_capacity;
+
+    if (count < *capacity) {
+        return 0;
+    }
+
+    new_capacity = *capacity > 0 ? *capacity * 2 : 64;
+    new_array = realloc(*array, new_capacity * element_size);
+    if (new_array == NULL) {
+        return -1;
+    }
+
+    *array = new_array;
+    *capacity = new_capacity;
+
+    return 0;
+}
+
+/* list the thread IDs with large getdents64() batches, the directory stays open for the per-thread files */
+static int list_thread_ids(pid_t pid, struct thread_census *census, int *task_fd) {
+    char dirent_buffer[PROCESS_DISCOVERY_BUFFER_SIZE];
+    char task_path[PATH_MAX];
+    struct linux_dirent64 *dirent;
+    long dirent_length;
+    long offset;
+
+    census->thread_count = 0;
+
+    if (snprintf(task_path, sizeof(task_path), "/proc/%d/task", pid) < 0) {
+        return -1;
+    }
+
+    *task_fd = open(task_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (*task_fd < 0) {
+        return -1;
+    }
+
+    while ((dirent_length = syscall(SYS_getdents64, *task_fd, dirent_buffer, sizeof(dirent_buffer))) > 0) {
+        for (offset = 0; offset < dirent_length; offset += dirent->d_reclen) {
+            dirent = (struct linux_dirent64 *)(dirent_buffer + offset);
+
+            /* skip . and .. */
+            if (dirent->d_name[0] < '1' || dirent->d_name[0] > '9') {
+                continue;
+            }
+
+            if (reserve_census_array((void **)&census->tids, &census->tid_capacity, census->thread_count, sizeof(pid_t)) < 0) {
+                close(*task_fd);
+                return -1;
+            }
+
+            census->tids[census->thread_count++] = strtol(dirent->d_name, NULL, 10);
+        }
+    }
+
+    return 0;
+}
+
+/* read a small file of /proc/pid/task/tid, returns its length or -1 if the thread has exited */
+static ssize_t read_thread_file(int task_fd, pid_t tid, char *name, char *buffer, size_t size) {
+    char path[64];
+    ssize_t length;
+    int fd;
+
+    snprintf(path, sizeof(path), "%d/%s", tid, name);
+
+    fd = openat(task_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    length = read(fd, buffer, size - 1);
+    close(fd);
+
+    if (length <= 0) {
+        return -1;
+    }
+
+    buffer[length] = '\0';
+
+    return length;
+}
+
+/*
+ * /proc/pid/task/tid/syscall ends with the stack pointer and the program counter of a blocked thread, e.g.
+ * "202 0x7f... 0x80 0x0 0x0 0x0 0x0 0x7f3a2bffe9b0 0x7f3a2c691d61" or "-1 0x7f3a2bffe9b0 0x7f3a2c691d61",
+ * it is "running" if the thread is on a CPU. reading it needs the same permissions as ptrace
+ */
+static int get_thread_stack_pointer(int task_fd, pid_t tid, unsigned long *stack_pointer) {
+    char buffer[256];
+    char *field;
+    char *previous_field = NULL;
+    char *last_field = NULL;
+    char *saveptr;
+
+    if (read_thread_file(task_fd, tid, "syscall", buffer, sizeof(buffer)) < 0 || strncmp(buffer, "running", 7) == 0) {
+        return -1;
+    }
+
+    for (field = strtok_r(buffer, " \n", &saveptr); field != NULL; field = strtok_r(NULL, " \n", &saveptr)) {
+        previous_field = last_field;
+        last_field = field;
+    }
+
+    if (previous_field == NULL) {
+        return -1;
+    }
+
+    *stack_pointer = strtoul(previous_field, NULL, 0);
+
+    return *stack_pointer != 0 ? 0 : -1;
+}
+
+/* private anonymous mappings and [stack], sorted by address as /proc/pid/maps is */
+static int load_stack_intervals(pid_t pid, struct thread_census *census) {
+    char maps_path[PATH_MAX];
+    char *maps_buffer;
+    char line[BUFSIZ];
+    struct mapping mapping;
+    struct stack_interval *interval;
+    unsigned long guard_start = 0;
+    unsigned long guard_end = 0;
+
+    census->interval_count = 0;
+
+    if (snprintf(maps_path, sizeof(maps_path), "/proc/%d/maps", pid) < 0) {
+        return -1;
+    }
+
+    maps_buffer = read_procfs_file(maps_path, NULL);
+    if (maps_buffer == NULL) {
+        return -1;
+    }
+
+    while (procfs_getline(line, sizeof(line), &maps_buffer) != NULL) {
+        if (parse_memory_mapping(line, &mapping) < 0) {
+            continue;
+        }
+
+        /* the guard of a thread stack is a PROT_NONE anonymous mapping right below it */
+        if (strcmp(mapping.permission_bits, "---p") == 0 && mapping.file_pathname[0] == '\0') {
+            guard_start = mapping.start_address;
+            guard_end = mapping.end_address;
+            continue;
+        }
+
+        if (strcmp(mapping.permission_bits, "rw-p") == 0 && (mapping.file_pathname[0] == '\0' || strcmp(mapping.file_pathname, "[stack]") == 0)) {
+            if (reserve_census_array((void **)&census->intervals, &census->interval_capacity, census->interval_count, sizeof(struct stack_interval)) < 0) {
+                return -1;
+            }
+
+            interval = &census->intervals[census->interval_count++];
+            interval->start_address = mapping.start_address;
+            interval->end_address = mapping.end_address;
+            interval->guard_size = guard_end == mapping.start_address ? guard_end - guard_start : 0;
+            interval->owned = 0;
+        }
+
+        guard_start = 0;
+        guard_end = 0;
+    }
+
+    return 0;
+}
+
+/* binary search of the mapping which contains the stack pointer */
+static long find_stack_interval(struct thread_census *census, unsigned long stack_pointer) {
+    size_t low = 0;
+    size_t high = census->interval_count;
+    size_t middle;
+
+    while (low < high) {
+        middle = low + (high - low) / 2;
+
+        if (stack_pointer < census->intervals[middle].start_address) {
+            high = middle;
+        } else if (stack_pointer >= census->intervals[middle].end_address) {
+            low = middle + 1;
+        } else {
+            return (long)middle;
+        }
+    }
+
+    return -1;
+}
+
+static int compare_thread_sample_comm(const void *a, const void *b) {
+    return strcmp(((const struct thread_sample *)a)->comm, ((const struct thread_sample *)b)->comm);
+}
+
+static int compare_thread_group_size(const void *a, const void *b) {
+    const struct thread_group *group_a = (const struct thread_group *)a;
+    const struct thread_group *group_b = (const struct thread_group *)b;
+
+    if (group_a->sampled < group_b->sampled) {
+        return 1;
+    } else if (group_a->sampled > group_b->sampled) {
+        return -1;
+    }
+
+    return strcmp(group_a->comm, group_b->comm);
+}
+
+/* group the sampled threads by comm, sorting is cheaper than hashing for a bounded number of samples */
+static int group_thread_samples(struct thread_census *census) {
+    struct thread_sample *sample;
+    struct thread_group *group = NULL;
+    struct stack_interval *interval;
+    size_t i;
+
+    census->group_count = 0;
+
+    qsort(census->samples, census->sampled, sizeof(struct thread_sample), compare_thread_sample_comm);
+
+    for (i = 0; i < census->sampled; ++i) {
+        sample = &census->samples[i];
+
+        if (group == NULL || strcmp(group->comm, sample->comm) != 0) {
+            if (reserve_census_array((void **)&census->groups, &census->group_capacity, census->group_count, sizeof(struct thread_group)) < 0) {
+                return -1;
+            }
+
+            group = &census->groups[census->group_count++];
+            strcpy(group->comm, sample->comm);
+            group->sampled = 0;
+            group->stacks = 0;
+            group->stack_size = 0;
+        }
+
+        ++group->sampled;
+
+        if (sample->stack_index >= 0) {
+            interval = &census->intervals[sample->stack_index];
+            ++group->stacks;
+            group->stack_size += interval->end_address - interval->start_address + interval->guard_size;
+            ++census->stacks;
+            census->stack_size += interval->end_address - interval->start_address + interval->guard_size;
+        }
+    }
+
+    qsort(census->groups, census->group_count, sizeof(struct thread_group), compare_thread_group_size);
+
+    return 0;
+}
+
+int collect_thread_census(pid_t pid, size_t budget, struct thread_census *census) {
+    struct thread_sample *sample;
+    unsigned long stack_pointer;
+    double current_time;
+    ssize_t comm_length;
+    long stack_index;
+    size_t window;
+    size_t i;
+    int task_fd;
+
+    census->sampled = 0;
+    census->unknown_stacks = 0;
+    census->stacks = 0;
+    census->stack_size = 0;
+    census->unowned_stacks = 0;
+    census->unowned_stack_size = 0;
+    census->group_count = 0;
+
+    /* the threads of a replayed process are not archived */
+    if (procfs_is_offline()) {
+        return -1;
+    }
+
+    if (list_thread_ids(pid, census, &task_fd) < 0) {
+        fprintf(stderr, "ERROR: failed to list the threads of PID %d: %s\n", pid, strerror(errno));
+        return -1;
+    }
+
+    current_time = get_monotonic_time();
+
+    census->growth_available = census->previous_time > 0 && current_time > census->previous_time;
+    if (census->growth_available) {
+        census->growth_rate = ((double)census->thread_count - (double)census->previous_count) / (current_time - census->previous_time);
+    }
+
+    census->previous_count = census->thread_count;
+    census->previous_time = current_time;
+
+    if (load_stack_intervals(pid, census) < 0) {
+        fprintf(stderr, "WARNING: failed to get the memory mappings of PID %d, thread stacks are not attributed\n", pid);
+        census->interval_count = 0;
+    }
+
+    /*
+     * the per-thread files cost 6 syscalls per thread, only a sample of a large process is read. one random
+     * thread of each window is taken, a fixed offset would alias with pools that name their threads in turn
+     */
+    census->stride = budget > 0 && census->thread_count > budget ? (census->thread_count + budget - 1) / budget : 1;
+
+    if (census->sample_state == 0) {
+        census->sample_state = (uint64_t)(current_time * 1000000) | 1;
+    }
+
+    for (window = 0; window < census->thread_count; window += census->stride) {
+        i = window;
+        if (census->stride > 1) {
+            census->sample_state ^= census->sample_state << 13;
+            census->sample_state ^= census->sample_state >> 7;
+            census->sample_state ^= census->sample_state << 17;
+
+            i += census->sample_state % (census->thread_count - window < census->stride ? census->thread_count - window : census->stride);
+        }
+
+        if (reserve_census_array((void **)&census->samples, &census->sample_capacity, census->sampled, sizeof(struct thread_sample)) < 0) {
+            close(task_fd);
+            fprintf(stderr, "ERROR: failed to allocate memory for the PID %d thread census\n", pid);
+            return -1;
+        }
+
+        sample = &census->samples[census->sampled];
+
+        /* a thread may exit during the census */
+        comm_length = read_thread_file(task_fd, census->tids[i], "comm", sample->comm, sizeof(sample->comm));
+        if (comm_length < 0) {
+            continue;
+        }
+
+        if (sample->comm[comm_length - 1] == '\n') {
+            sample->comm[comm_length - 1] = '\0';
+        }
+
+        sample->stack_index = -1;
+
+        if (get_thread_stack_pointer(task_fd, census->tids[i], &stack_pointer) < 0) {
+            ++census->unknown_stacks;
+        } else {
+            stack_index = find_stack_interval(census, stack_pointer);
+            if (stack_index >= 0 && !census->intervals[stack_index].owned) {
+                census->intervals[stack_index].owned = 1;
+                sample->stack_index = stack_index;
+            }
+        }
+
+        ++census->sampled;
+    }
+
+    close(task_fd);
+
+    if (group_thread_samples(census) < 0) {
+        fprintf(stderr, "ERROR: failed to allocate memory for the PID %d thread census\n", pid);
+        return -1;
+    }
+
+    /* a stack with a guard and no thread is e.g. cached by glibc after its thread has exited */
+    if (census->stride == 1) {
+        for (i = 0; i < census->interval_count; ++i) {
+            if (census->intervals[i].guard_size > 0 && !census->intervals[i].owned) {
+                ++census->unowned_stacks;
+                census->unowned_stack_size += census->intervals[i].end_address - census->intervals[i].start_address + census->intervals[i].guard_size;
+            }
+        }
+    }
+
+    return 0;
+}
+
+void free_thread_census(struct thread_census *census) {
+    free(census->groups);
+    free(census->tids);
+    free(census->samples);
+    free(census->intervals);
+    memset(census, 0, sizeof(struct thread_census));
+}
@@ -0,0 +1,66 @@
+#ifndef THREADS_H
+#define THREADS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define THREAD_COMM_SIZE 16 /* TASK_COMM_LEN of the kernel */
+#define THREAD_CENSUS_DEFAULT_BUDGET 4096 /* threads whose comm and stack pointer are read in each census */
+#define THREAD_CENSUS_MAX_GROUPS 16 /* thread groups listed in a report */
+
+/* threads with the same comm, the counts are the sampled threads */
+struct thread_group {
+    char comm[THREAD_COMM_SIZE];
+    size_t sampled;
+    size_t stacks; /* stack mappings attributed to the sampled threads */
+    unsigned long stack_size; /* unit: byte, stack mappings including their guard pages */
+};
+
+/* a private anonymous mapping which may be the stack of a thread, with the PROT_NONE guard mapping below it */
+struct stack_interval {
+    unsigned long start_address;
+    unsigned long end_address;
+    unsigned long guard_size; /* unit: byte, 0 if there is no guard mapping */
+    int owned; /* 1 if the stack pointer of a sampled thread is in the mapping */
+};
+
+/* one sampled thread, grouped by comm once all samples are read */
+struct thread_sample {
+    char comm[THREAD_COMM_SIZE];
+    long stack_index; /* index into the stack intervals, -1 if the stack pointer is unknown or not in a stack mapping */
+};
+
+/* threads of the last census, the arrays are kept and reused by the next censuses */
+struct thread_census {
+    size_t thread_count;
+    int growth_available; /* 1 if there is a previous census to compare with */
+    double growth_rate; /* unit: threads per second */
+    size_t sampled;
+    size_t stride; /* one thread in every window of stride threads is sampled */
+    size_t unknown_stacks; /* sampled threads without a stack pointer, e.g. running or not permitted */
+    size_t stacks; /* stack mappings attributed to the sampled threads */
+    unsigned long stack_size; /* unit: byte, including guard pages */
+    size_t unowned_stacks; /* stack-like mappings with a guard and no thread, only counted if every thread is sampled */
+    unsigned long unowned_stack_size; /* unit: byte, including guard pages */
+    struct thread_group *groups; /* sorted by sampled threads, most first */
+    size_t group_count;
+    size_t group_capacity;
+
+    /* scratch arrays and the previous census */
+    pid_t *tids;
+    size_t tid_capacity;
+    struct thread_sample *samples;
+    size_t sample_capacity;
+    struct stack_interval *intervals;
+    size_t interval_count;
+    size_t interval_capacity;
+    size_t previous_count;
+    double previous_time;
+    uint64_t sample_state; /* xorshift state of the sampling */
+};
+
+extern int collect_thread_census(pid_t pid, size_t budget, struct thread_census *census);
+extern void free_thread_census(struct thread_census *census);
+
+#endif /* THREADS_H */
@@ -0,0 +1,379 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "procfs.h"
+#include "topmem.h"
+#include "utils.h"
+
+/* PIDs listed from /proc and the RSS read by the scan threads, indexed alike */
+static pid_t *scan_pids = NULL;
+static long int *scan_rss = NULL;
+static size_t scan_capacity = 0;
+static size_t scan_count = 0;
+static size_t scan_next = 0; /* next unclaimed chunk, shared by the scan threads */
+
+/* RSS of every process in the previous scan sorted by PID, to show how the top consumers changed */
+static struct topmem_entry *previous_entries = NULL;
+static size_t previous_count = 0;
+
+static int scan_proc_fd = -1;
+static long scan_page_size_kb;
+
+/* each scan thread keeps its own top consumers in a bounded min-heap, the smallest RSS is at the root */
+struct topmem_heap {
+    struct topmem_entry entries[TOPMEM_MAX_COUNT];
+    long count;
+    long limit;
+};
+
+static void push_heap_entry(struct topmem_heap *heap, pid_t pid, long int rss) {
+    struct topmem_entry entry;
+    long i;
+    long child;
+
+    if (heap->count == heap->limit) {
+        if (rss <= heap->entries[0].rss) {
+            return;
+        }
+
+        /* replace the root and sift it down */
+        entry.pid = pid;
+        entry.rss = rss;
+        i = 0;
+
+        while ((child = i * 2 + 1) < heap->count) {
+            if (child + 1 < heap->count && heap->entries[child + 1].rss < heap->entries[child].rss) {
+                ++child;
+            }
+
+            if (entry.rss <= heap->entries[child].rss) {
+                break;
+            }
+
+            heap->entries[i] = heap->entries[child];
+            i = child;
+        }
+
+        heap->entries[i] = entry;
+        return;
+    }
+
+    /* append and sift up */
+    i = heap->count++;
+
+    while (i > 0 && heap->entries[(i - 1) / 2].rss > rss) {
+        heap->entries[i] = heap->entries[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+
+    heap->entries[i].pid = pid;
+    heap->entries[i].rss = rss;
+}
+
+static long int read_statm_rss(pid_t pid) {
+    char path[32];
+    char buffer[128];
+    long int resident_pages;
+    char *cursor;
+    ssize_t length;
+    int fd;
+
+    snprintf(path, sizeof(path), "%d/statm", pid);
+
+    /* the process may exit at any time during the scan */
+    fd = openat(scan_proc_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    length = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+
+    if (length <= 0) {
+        return -1;
+    }
+
+    buffer[length] = '\0';
+
+    /* the 2nd field is resident pages */
+    cursor = strchr(buffer, ' ');
+    if (cursor == NULL) {
+        return -1;
+    }
+
+    resident_pages = strtol(cursor + 1, NULL, 10);
+
+    return resident_pages * scan_page_size_kb;
+}
+
+static void *scan_statm(void *arg) {
+    struct topmem_heap *heap = (struct topmem_heap *)arg;
+    size_t start;
+    size_t end;
+    size_t i;
+
+    while (1) {
+        start = __atomic_fetch_add(&scan_next, TOPMEM_CHUNK_SIZE, __ATOMIC_RELAXED);
+        if (start >= scan_count) {
+            break;
+        }
+
+        end = start + TOPMEM_CHUNK_SIZE < scan_count ? start + TOPMEM_CHUNK_SIZE : scan_count;
+
+        for (i = start; i < end; ++i) {
+            scan_rss[i] = read_statm_rss(scan_pids[i]);
+
+            /* kernel threads have no memory of their own */
+            if (scan_rss[i] > 0) {
+                push_heap_entry(heap, scan_pids[i], scan_rss[i]);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* list the PIDs in /proc with large getdents64() batches */
+static int list_pids() {
+    char dirent_buffer[32768];
+    struct linux_dirent64 *dirent;
+    long dirent_length;
+    long offset;
+    size_t new_capacity;
+    void *new_buffer;
+
+    scan_count = 0;
+
+    if (lseek(scan_proc_fd, 0, SEEK_SET) < 0) {
+        return -1;
+    }
+
+    while ((dirent_length = syscall(SYS_getdents64, scan_proc_fd, dirent_buffer, sizeof(dirent_buffer))) > 0) {
+        for (offset = 0; offset < dirent_length; offset += dirent->d_reclen) {
+            dirent = (struct linux_dirent64 *)(dirent_buffer + offset);
+
+            /* only process directories are named with digits */
+            if (dirent->d_name[0] < '1' || dirent->d_name[0] > '9') {
+                continue;
+            }
+
+            if (scan_count == scan_capacity) {
+                new_capacity = scan_capacity == 0 ? 4096 : scan_capacity * 2;
+
+                /* the capacity only grows once both arrays hold it, a failed scan leaves them usable for the next one */
+                new_buffer = realloc(scan_pids, new_capacity * sizeof(pid_t));
+                if (new_buffer == NULL) {
+                    return -1;
+                }
+                scan_pids = (pid_t *)new_buffer;
+
+                new_buffer = realloc(scan_rss, new_capacity * sizeof(long int));
+                if (new_buffer == NULL) {
+                    return -1;
+                }
+                scan_rss = (long int *)new_buffer;
+
+                scan_capacity = new_capacity;
+            }
+
+            scan_pids[scan_count++] = strtol(dirent->d_name, NULL, 10);
+        }
+    }
+
+    return dirent_length < 0 ? -1 : 0;
+}
+
+static int get_scan_thread_count() {
+    cpu_set_t cpu_set;
+    int cpu_count;
+
+    /* the CPUs of --cpu-affinity if it is specified */
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+        cpu_count = CPU_COUNT(&cpu_set);
+    } else {
+        cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    if (cpu_count < 1) {
+        return 1;
+    }
+
+    return cpu_count < TOPMEM_MAX_THREADS ? cpu_count : TOPMEM_MAX_THREADS;
+}
+
+static int compare_entry_rss(const void *a, const void *b) {
+    long int rss_a = ((const struct topmem_entry *)a)->rss;
+    long int rss_b = ((const struct topmem_entry *)b)->rss;
+
+    return rss_a < rss_b ? 1 : (rss_a > rss_b ? -1 : 0);
+}
+
+static int compare_entry_pid(const void *a, const void *b) {
+    return ((const struct topmem_entry *)a)->pid - ((const struct topmem_entry *)b)->pid;
+}
+
+/* keep the RSS of this scan for the next one */
+static void save_previous_entries() {
+    void *new_buffer;
+    size_t i;
+
+    new_buffer = realloc(previous_entries, (scan_count > 0 ? scan_count : 1) * sizeof(struct topmem_entry));
+    if (new_buffer == NULL) {
+        previous_count = 0;
+        return;
+    }
+    previous_entries = (struct topmem_entry *)new_buffer;
+    previous_count = 0;
+
+    for (i = 0; i < scan_count; ++i) {
+        if (scan_rss[i] > 0) {
+            previous_entries[previous_count].pid = scan_pids[i];
+            previous_entries[previous_count].rss = scan_rss[i];
+            ++previous_count;
+        }
+    }
+
+    /* getdents64() lists /proc in PID order, sorting is cheap when it is already sorted */
+    qsort(previous_entries, previous_count, sizeof(struct topmem_entry), compare_entry_pid);
+}
+
+static void print_process_comm(pid_t pid) {
+    char comm_path[PATH_MAX];
+    char *comm_buffer;
+
+    snprintf(comm_path, sizeof(comm_path), "/proc/%d/comm", pid);
+
+    comm_buffer = read_procfs_file(comm_path, NULL);
+    if (comm_buffer == NULL) {
+        fprintf(report_output, "n/a\n");
+        return;
+    }
+
+    fprintf(report_output, "%s", comm_buffer);
+    if (comm_buffer[0] == '\0' || comm_buffer[strlen(comm_buffer) - 1] != '\n') {
+        fprintf(report_output, "\n");
+    }
+}
+
+void get_top_memory_consumers(long top_count) {
+    static struct topmem_heap heaps[TOPMEM_MAX_THREADS];
+    struct topmem_entry top_entries[TOPMEM_MAX_THREADS * TOPMEM_MAX_COUNT];
+    struct topmem_entry *previous_entry;
+    pthread_t scan_threads[TOPMEM_MAX_THREADS];
+    struct timespec scan_start_time;
+    sigset_t block_set;
+    sigset_t old_set;
+    long scan_latency;
+    long top_entry_count = 0;
+    int thread_count;
+    int started_count = 1;
+    int i;
+    long j;
+
+    clock_gettime(CLOCK_MONOTONIC, &scan_start_time);
+
+    if (scan_proc_fd < 0) {
+        scan_proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (scan_proc_fd < 0) {
+            fprintf(stderr, "ERROR: failed to open /proc: %s\n", strerror(errno));
+            return;
+        }
+        scan_page_size_kb = sysconf(_SC_PAGESIZE) / 1024;
+    }
+
+    if (list_pids() < 0) {
+        fprintf(stderr, "ERROR: failed to list processes in /proc\n");
+        return;
+    }
+
+    thread_count = get_scan_thread_count();
+    scan_next = 0;
+
+    for (i = 0; i < thread_count; ++i) {
+        heaps[i].count = 0;
+        heaps[i].limit = top_count;
+    }
+
+    /* SIGINT is left to the capture thread */
+    sigemptyset(&block_set);
+    sigaddset(&block_set, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &block_set, &old_set);
+
+    /* the calling thread scans as well, a thread that fails to start only makes the scan slower */
+    for (i = 1; i < thread_count; ++i) {
+        if (pthread_create(&scan_threads[i], NULL, scan_statm, &heaps[i]) != 0) {
+            break;
+        }
+        ++started_count;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+
+    scan_statm(&heaps[0]);
+
+    for (i = 1; i < started_count; ++i) {
+        pthread_join(scan_threads[i], NULL);
+    }
+
+    scan_latency = get_elapsed_microseconds(&scan_start_time);
+
+    /* merge the heaps of all scan threads */
+    for (i = 0; i < started_count; ++i) {
+        for (j = 0; j < heaps[i].count; ++j) {
+            top_entries[top_entry_count++] = heaps[i].entries[j];
+        }
+    }
+
+    qsort(top_entries, top_entry_count, sizeof(struct topmem_entry), compare_entry_rss);
+    if (top_entry_count > top_count) {
+        top_entry_count = top_count;
+    }
+
+    fprintf(report_output, "Scanned Processes: %zu - Threads: %d - Scan Time: %ld us\n", scan_count, started_count, scan_latency);
+    fprintf(report_output, "%-8s %-14s %-14s %s\n", "PID", "RSS", "CHANGE", "COMMAND");
+    fflush(report_output);
+
+    for (j = 0; j < top_entry_count; ++j) {
+        previous_entry = bsearch(&top_entries[j], previous_entries, previous_count, sizeof(struct topmem_entry), compare_entry_pid);
+
+        /* a process missing from the previous scan is new, nothing is compared in the first scan */
+        if (previous_count == 0) {
+            fprintf(report_output, "%-8d %-11ld kB %-11s    ", top_entries[j].pid, top_entries[j].rss, "n/a");
+        } else if (previous_entry == NULL) {
+            fprintf(report_output, "%-8d %-11ld kB %-11s    ", top_entries[j].pid, top_entries[j].rss, "new");
+        } else {
+            fprintf(report_output, "%-8d %-11ld kB %+-11ld kB ", top_entries[j].pid, top_entries[j].rss, top_entries[j].rss - previous_entry->rss);
+        }
+
+        print_process_comm(top_entries[j].pid);
+    }
+    fflush(report_output);
+
+    save_previous_entries();
+}
+
+void free_top_memory_consumers() {
+    free(scan_pids);
+    free(scan_rss);
+    free(previous_entries);
+
+    scan_pids = NULL;
+    scan_rss = NULL;
+    previous_entries = NULL;
+    scan_capacity = 0;
+    scan_count = 0;
+    previous_count = 0;
+
+    if (scan_proc_fd >= 0) {
+        close(scan_proc_fd);
+        scan_proc_fd = -1;
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef TOPMEM_H
+#define TOPMEM_H
+
+#include <sys/types.h>
+
+#define TOPMEM_MAX_THREADS 8 /* scan threads, limited by the CPUs memdoor may run on */
+#define TOPMEM_CHUNK_SIZE 256 /* PIDs claimed by a scan thread at a time */
+#define TOPMEM_MAX_COUNT 100 /* upper limit of the top consumers count */
+
+/* RSS of one process found by the system-wide scan */
+struct topmem_entry {
+    pid_t pid;
+    long int rss; /* unit: kB */
+};
+
+extern void get_top_memory_consumers(long top_count);
+extern void free_top_memory_consumers();
+
+#endif /* TOPMEM_H */
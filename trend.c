@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include "trend.h"
+
+static const struct trend_tier_config trend_tiers[TREND_TIER_COUNT] = TREND_TIERS;
+static const char *trend_metric_names[TREND_METRIC_COUNT] = {"statm_rss", "rss", "pss", "uss", "page_tables", "oom_score"};
+
+static struct trend_row *trend_rows[TREND_TIER_COUNT];
+static int64_t trend_latest_slots[TREND_TIER_COUNT];
+static int trend_store_ready = 0;
+
+/* updated by the render thread, queried by any thread */
+static pthread_mutex_t trend_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+int init_trend_store() {
+    long i;
+    int tier;
+
+    for (tier = 0; tier < TREND_TIER_COUNT; ++tier) {
+        /* all rows are allocated up front, a week-long session uses the same memory as a short one */
+        trend_rows[tier] = (struct trend_row *)calloc(trend_tiers[tier].rows, sizeof(struct trend_row));
+        if (trend_rows[tier] == NULL) {
+            fprintf(stderr, "ERROR: failed to allocate the trend store\n");
+            free_trend_store();
+            return -1;
+        }
+
+        for (i = 0; i < trend_tiers[tier].rows; ++i) {
+            trend_rows[tier][i].slot = -1;
+        }
+
+        trend_latest_slots[tier] = -1;
+    }
+
+    trend_store_ready = 1;
+
+    return 0;
+}
+
+static void consolidate_sample(struct trend_row *row, int64_t slot, double samples[TREND_METRIC_COUNT], int present[TREND_METRIC_COUNT]) {
+    struct trend_value *value;
+    int metric;
+
+    /* a row that belongs to an older slot is overwritten, a sample older than the row is too old for the tier */
+    if (row->slot > slot) {
+        return;
+    }
+
+    if (row->slot < slot) {
+        memset(row->values, 0, sizeof(row->values));
+        row->slot = slot;
+    }
+
+    for (metric = 0; metric < TREND_METRIC_COUNT; ++metric) {
+        if (!present[metric]) {
+            continue;
+        }
+
+        value = &row->values[metric];
+
+        if (value->count == 0 || samples[metric] < value->min) {
+            value->min = samples[metric];
+        }
+
+        if (value->count == 0 || samples[metric] > value->max) {
+            value->max = samples[metric];
+        }
+
+        value->sum += samples[metric];
+        ++value->count;
+    }
+}
+
+void update_trend_store(struct report *report) {
+    double samples[TREND_METRIC_COUNT];
+    int present[TREND_METRIC_COUNT] = {0};
+    int64_t slot;
+    int tier;
+
+    if (!trend_store_ready) {
+        return;
+    }
+
+    /* the fast tier value is sampled in every cycle with a threshold, the others only with the memory sections */
+    if (report->statm_rss > 0) {
+        samples[TREND_STATM_RSS] = report->statm_rss;
+        present[TREND_STATM_RSS] = 1;
+    }
+
+    if (report->status == REPORT_FULL && report->memory_data.process_rss > 0) {
+        samples[TREND_RSS] = report->memory_data.process_rss;
+        samples[TREND_PSS] = report->memory_data.process_pss;
+        samples[TREND_USS] = report->memory_data.process_uss;
+        samples[TREND_PAGE_TABLES] = report->memory_data.process_page_tables_size;
+        present[TREND_RSS] = present[TREND_PSS] = present[TREND_USS] = present[TREND_PAGE_TABLES] = 1;
+
+        if (report->memory_data.process_oom_score >= 0) {
+            samples[TREND_OOM_SCORE] = report->memory_data.process_oom_score;
+            present[TREND_OOM_SCORE] = 1;
+        }
+    }
+
+    pthread_mutex_lock(&trend_mutex);
+
+    for (tier = 0; tier < TREND_TIER_COUNT; ++tier) {
+        slot = (int64_t)report->report_time / trend_tiers[tier].step;
+
+        consolidate_sample(&trend_rows[tier][slot % trend_tiers[tier].rows], slot, samples, present);
+
+        if (slot > trend_latest_slots[tier]) {
+            trend_latest_slots[tier] = slot;
+        }
+    }
+
+    pthread_mutex_unlock(&trend_mutex);
+}
+
+/* the finest tier that still covers start_time */
+static int select_trend_tier(time_t start_time) {
+    int64_t oldest_slot;
+    int tier;
+
+    for (tier = 0; tier < TREND_TIER_COUNT; ++tier) {
+        oldest_slot = trend_latest_slots[tier] - trend_tiers[tier].rows + 1;
+
+        if ((int64_t)start_time / trend_tiers[tier].step >= oldest_slot) {
+            return tier;
+        }
+    }
+
+    return TREND_TIER_COUNT - 1;
+}
+
+long query_trend(enum trend_metric metric, time_t start_time, time_t end_time, struct trend_point *points, long max_points) {
+    struct trend_row *row;
+    struct trend_value *value;
+    int64_t slot;
+    int64_t first_slot;
+    int64_t last_slot;
+    long point_count = 0;
+    long step;
+    int tier;
+
+    if (!trend_store_ready || metric < 0 || metric >= TREND_METRIC_COUNT) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&trend_mutex);
+
+    tier = select_trend_tier(start_time);
+    step = trend_tiers[tier].step;
+
+    /* only the slots still held by the ring of the tier */
+    first_slot = (int64_t)start_time / step;
+    if (first_slot < trend_latest_slots[tier] - trend_tiers[tier].rows + 1) {
+        first_slot = trend_latest_slots[tier] - trend_tiers[tier].rows + 1;
+    }
+
+    last_slot = (int64_t)end_time / step;
+    if (last_slot > trend_latest_slots[tier]) {
+        last_slot = trend_latest_slots[tier];
+    }
+
+    for (slot = first_slot; slot <= last_slot && point_count < max_points; ++slot) {
+        if (slot < 0) {
+            continue;
+        }
+
+        row = &trend_rows[tier][slot % trend_tiers[tier].rows];
+        value = &row->values[metric];
+
+        if (row->slot != slot || value->count == 0) {
+            continue;
+        }
+
+        points[point_count].time = (time_t)(slot * step);
+        points[point_count].step = step;
+        points[point_count].min = value->min;
+        points[point_count].max = value->max;
+        points[point_count].avg = value->sum / value->count;
+        points[point_count].count = value->count;
+        ++point_count;
+    }
+
+    pthread_mutex_unlock(&trend_mutex);
+
+    return point_count;
+}
+
+int dump_trend_store(char *path) {
+    FILE *dump_file;
+    struct trend_row *row;
+    struct trend_value *value;
+    int64_t slot;
+    int tier;
+    int metric;
+
+    if (!trend_store_ready) {
+        return -1;
+    }
+
+    dump_file = fopen(path, "w");
+    if (dump_file == NULL) {
+        fprintf(stderr, "ERROR: failed to open the trend file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    /* one CSV row per tier row, the columns of a metric without samples are left empty */
+    fprintf(dump_file, "step,time");
+    for (metric = 0; metric < TREND_METRIC_COUNT; ++metric) {
+        fprintf(dump_file, ",%s_min,%s_max,%s_avg", trend_metric_names[metric], trend_metric_names[metric], trend_metric_names[metric]);
+    }
+    fprintf(dump_file, "\n");
+
+    pthread_mutex_lock(&trend_mutex);
+
+    for (tier = 0; tier < TREND_TIER_COUNT; ++tier) {
+        for (slot = trend_latest_slots[tier] - trend_tiers[tier].rows + 1; slot <= trend_latest_slots[tier]; ++slot) {
+            if (slot < 0) {
+                continue;
+            }
+
+            row = &trend_rows[tier][slot % trend_tiers[tier].rows];
+            if (row->slot != slot) {
+                continue;
+            }
+
+            fprintf(dump_file, "%ld,%lld", trend_tiers[tier].step, (long long)(slot * trend_tiers[tier].step));
+
+            for (metric = 0; metric < TREND_METRIC_COUNT; ++metric) {
+                value = &row->values[metric];
+
+                if (value->count == 0) {
+                    fprintf(dump_file, ",,,");
+                } else {
+                    fprintf(dump_file, ",%.0f,%.0f,%.1f", value->min, value->max, value->sum / value->count);
+                }
+            }
+
+            fprintf(dump_file, "\n");
+        }
+    }
+
+    pthread_mutex_unlock(&trend_mutex);
+
+    if (fclose(dump_file) != 0) {
+        fprintf(stderr, "ERROR: failed to write the trend file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+void free_trend_store() {
+    int tier;
+
+    trend_store_ready = 0;
+
+    for (tier = 0; tier < TREND_TIER_COUNT; ++tier) {
+        free(trend_rows[tier]);
+        trend_rows[tier] = NULL;
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef TREND_H
+#define TREND_H
+
+#include <stdint.h>
+#include <time.h>
+#include "report.h"
+
+/*
+ * round-robin time series of the report values with fixed-size tiers, older samples are only kept downsampled
+ * a sample is consolidated into the row of its time slot in every tier on insert, so the memory use never grows
+ */
+#define TREND_TIER_COUNT 3
+#define TREND_TIERS {{1, 600}, {10, 2160}, {60, 10080}} /* {seconds per row, rows}: 10 minutes, 6 hours and 7 days */
+
+enum trend_metric {
+    TREND_STATM_RSS, /* unit: kB */
+    TREND_RSS, /* unit: kB */
+    TREND_PSS, /* unit: kB */
+    TREND_USS, /* unit: kB */
+    TREND_PAGE_TABLES, /* unit: kB */
+    TREND_OOM_SCORE,
+    TREND_METRIC_COUNT
+};
+
+struct trend_tier_config {
+    long step; /* unit: second */
+    long rows;
+};
+
+/* min/max/avg of the samples in one row, count is 0 if the metric has no sample */
+struct trend_value {
+    double min;
+    double max;
+    double sum;
+    long count;
+};
+
+struct trend_row {
+    int64_t slot; /* time / step of the row, -1 if the row is empty */
+    struct trend_value values[TREND_METRIC_COUNT];
+};
+
+/* one consolidated point returned by query_trend() */
+struct trend_point {
+    time_t time; /* start of the row */
+    long step; /* unit: second */
+    double min;
+    double max;
+    double avg;
+    long count;
+};
+
+extern int init_trend_store();
+extern void update_trend_store(struct report *report);
+extern long query_trend(enum trend_metric metric, time_t start_time, time_t end_time, struct trend_point *points, long max_points);
+extern int dump_trend_store(char *path);
+extern void free_trend_store();
+
+#endif /* TREND_H */
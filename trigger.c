@@ -0,0 +1,571 @@
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trigger.h"
+
+/* unit of the values of a metric, the operands of a rule are converted to it once at compile time */
+enum trigger_value_kind {
+    TRIGGER_VALUE_SIZE, /* kB, the suffixes K, M, G and T are binary */
+    TRIGGER_VALUE_COUNT, /* the suffixes k and m are decimal */
+    TRIGGER_VALUE_PERCENT,
+    TRIGGER_VALUE_RATE /* kB per second, a size with /s, /min or /h */
+};
+
+struct trigger_metric_info {
+    char *name;
+    enum trigger_value_kind kind;
+    unsigned int sources;
+    int base; /* metric a rate is derived from, -1 if the metric is read directly */
+};
+
+/* indexed by enum trigger_metric */
+static struct trigger_metric_info trigger_metric_infos[TRIGGER_METRIC_COUNT] = {
+    {"rss", TRIGGER_VALUE_SIZE, TRIGGER_SOURCE_STATM, -1},
+    {"rss_pct", TRIGGER_VALUE_PERCENT, TRIGGER_SOURCE_STATM, -1},
+    {"pss", TRIGGER_VALUE_SIZE, TRIGGER_SOURCE_SMAPS_ROLLUP, -1},
+    {"uss", TRIGGER_VALUE_SIZE, TRIGGER_SOURCE_SMAPS_ROLLUP, -1},
+    {"page_tables", TRIGGER_VALUE_SIZE, TRIGGER_SOURCE_STATUS, -1},
+    {"oom_score", TRIGGER_VALUE_COUNT, TRIGGER_SOURCE_OOM_SCORE, -1},
+    {"oom_score_adj", TRIGGER_VALUE_COUNT, TRIGGER_SOURCE_OOM_SCORE, -1},
+    {"sockets", TRIGGER_VALUE_COUNT, TRIGGER_SOURCE_FD, -1},
+    {"rss_rate", TRIGGER_VALUE_RATE, TRIGGER_SOURCE_STATM, TRIGGER_METRIC_RSS},
+    {"pss_rate", TRIGGER_VALUE_RATE, TRIGGER_SOURCE_SMAPS_ROLLUP, TRIGGER_METRIC_PSS},
+    {"uss_rate", TRIGGER_VALUE_RATE, TRIGGER_SOURCE_SMAPS_ROLLUP, TRIGGER_METRIC_USS},
+    {"page_tables_rate", TRIGGER_VALUE_RATE, TRIGGER_SOURCE_STATUS, TRIGGER_METRIC_PAGE_TABLES}
+};
+
+struct trigger_section_info {
+    char *name;
+    unsigned int section;
+};
+
+static struct trigger_section_info trigger_section_infos[] = {
+    {"tree", TRIGGER_SECTION_TREE},
+    {"threads", TRIGGER_SECTION_THREADS},
+    {"mappings", TRIGGER_SECTION_MAPPINGS},
+    {"growing", TRIGGER_SECTION_GROWING},
+    {"pagemap", TRIGGER_SECTION_PAGEMAP},
+    {"network", TRIGGER_SECTION_NETWORK},
+    {"numa", TRIGGER_SECTION_NUMA},
+    {"cgroup", TRIGGER_SECTION_CGROUP},
+    {"vmstat", TRIGGER_SECTION_VMSTAT},
+    {"consumers", TRIGGER_SECTION_CONSUMERS}
+};
+
+#define TRIGGER_SECTION_INFO_COUNT (sizeof(trigger_section_infos) / sizeof(trigger_section_infos[0]))
+
+/* cursor of the rule being compiled */
+struct trigger_parser {
+    char *text;
+    char *cursor;
+    struct trigger_rule *rule;
+};
+
+/* the rules are compiled at startup and only read afterwards */
+static struct trigger_rule trigger_rules[TRIGGER_MAX_RULES];
+static int trigger_rule_count = 0;
+static unsigned int trigger_sources = 0;
+
+/* values of the previous evaluation for the rates, used by the capture thread or the replay loop only */
+static double trigger_previous_values[TRIGGER_METRIC_COUNT];
+static double trigger_previous_time = 0;
+static pid_t trigger_previous_pid = 0;
+
+static void report_trigger_error(struct trigger_parser *parser, char *reason) {
+    fprintf(stderr, "ERROR: invalid trigger rule \"%s\": %s at \"%s\"\n", parser->text, reason, parser->cursor);
+}
+
+static void skip_trigger_spaces(struct trigger_parser *parser) {
+    while (isspace((unsigned char)*parser->cursor)) {
+        ++parser->cursor;
+    }
+}
+
+static int is_trigger_name_char(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+/* a word keyword must not be followed by a name character, "order" is not "or" */
+static int match_trigger_keyword(struct trigger_parser *parser, char *word, char *symbol) {
+    size_t length;
+
+    skip_trigger_spaces(parser);
+
+    length = strlen(symbol);
+    if (strncmp(parser->cursor, symbol, length) == 0) {
+        parser->cursor += length;
+        return 1;
+    }
+
+    length = strlen(word);
+    if (strncmp(parser->cursor, word, length) == 0 && !is_trigger_name_char(parser->cursor[length])) {
+        parser->cursor += length;
+        return 1;
+    }
+
+    return 0;
+}
+
+static int emit_trigger_instruction(struct trigger_parser *parser, enum trigger_opcode opcode, int metric, enum trigger_compare compare, double operand) {
+    struct trigger_instruction *instruction;
+
+    if (parser->rule->length >= TRIGGER_MAX_CODE) {
+        report_trigger_error(parser, "too many comparisons");
+        return -1;
+    }
+
+    instruction = &parser->rule->code[parser->rule->length++];
+    instruction->opcode = opcode;
+    instruction->metric = metric;
+    instruction->compare = compare;
+    instruction->operand = operand;
+
+    return 0;
+}
+
+static int parse_trigger_metric(struct trigger_parser *parser) {
+    char *name = parser->cursor;
+    size_t length = 0;
+    int i;
+
+    while (is_trigger_name_char(name[length])) {
+        ++length;
+    }
+
+    for (i = 0; i < TRIGGER_METRIC_COUNT; ++i) {
+        if (strlen(trigger_metric_infos[i].name) == length && strncmp(name, trigger_metric_infos[i].name, length) == 0) {
+            parser->cursor += length;
+            return i;
+        }
+    }
+
+    report_trigger_error(parser, "unknown metric");
+    return -1;
+}
+
+static int parse_trigger_compare(struct trigger_parser *parser, enum trigger_compare *compare) {
+    char *cursor = parser->cursor;
+
+    if (strncmp(cursor, ">=", 2) == 0) {
+        *compare = TRIGGER_COMPARE_GE;
+    } else if (strncmp(cursor, "<=", 2) == 0) {
+        *compare = TRIGGER_COMPARE_LE;
+    } else if (strncmp(cursor, "==", 2) == 0) {
+        *compare = TRIGGER_COMPARE_EQ;
+    } else if (strncmp(cursor, "!=", 2) == 0) {
+        *compare = TRIGGER_COMPARE_NE;
+    } else if (*cursor == '>') {
+        *compare = TRIGGER_COMPARE_GT;
+    } else if (*cursor == '<') {
+        *compare = TRIGGER_COMPARE_LT;
+    } else {
+        report_trigger_error(parser, "expected a comparison operator");
+        return -1;
+    }
+
+    parser->cursor += *compare == TRIGGER_COMPARE_GT || *compare == TRIGGER_COMPARE_LT ? 1 : 2;
+
+    return 0;
+}
+
+/* a size is in kB without suffix, e.g. 512, 64M, 2G or 2GB */
+static double parse_trigger_size_suffix(struct trigger_parser *parser) {
+    double multiplier;
+
+    switch (toupper((unsigned char)*parser->cursor)) {
+        case 'K':
+            multiplier = 1;
+            break;
+        case 'M':
+            multiplier = 1024;
+            break;
+        case 'G':
+            multiplier = 1024.0 * 1024;
+            break;
+        case 'T':
+            multiplier = 1024.0 * 1024 * 1024;
+            break;
+        default:
+            return 1;
+    }
+
+    ++parser->cursor;
+    if (toupper((unsigned char)*parser->cursor) == 'B') {
+        ++parser->cursor;
+    }
+
+    return multiplier;
+}
+
+static int parse_trigger_value(struct trigger_parser *parser, enum trigger_value_kind kind, double *value) {
+    char *number_end;
+
+    *value = strtod(parser->cursor, &number_end);
+    if (number_end == parser->cursor) {
+        report_trigger_error(parser, "expected a number");
+        return -1;
+    }
+    parser->cursor = number_end;
+
+    switch (kind) {
+        case TRIGGER_VALUE_SIZE:
+            *value *= parse_trigger_size_suffix(parser);
+            break;
+        case TRIGGER_VALUE_COUNT:
+            if (toupper((unsigned char)*parser->cursor) == 'K') {
+                *value *= 1000;
+                ++parser->cursor;
+            } else if (toupper((unsigned char)*parser->cursor) == 'M') {
+                *value *= 1000000;
+                ++parser->cursor;
+            }
+            break;
+        case TRIGGER_VALUE_PERCENT:
+            if (*parser->cursor == '%') {
+                ++parser->cursor;
+            }
+            break;
+        case TRIGGER_VALUE_RATE:
+            *value *= parse_trigger_size_suffix(parser);
+
+            /* per second without a time unit */
+            if (*parser->cursor == '/') {
+                ++parser->cursor;
+                if (strncmp(parser->cursor, "min", 3) == 0) {
+                    *value /= 60;
+                    parser->cursor += 3;
+                } else if (*parser->cursor == 'h') {
+                    *value /= 3600;
+                    ++parser->cursor;
+                } else if (*parser->cursor == 's') {
+                    ++parser->cursor;
+                } else {
+                    report_trigger_error(parser, "expected a time unit of s, min or h");
+                    return -1;
+                }
+            }
+            break;
+    }
+
+    if (is_trigger_name_char(*parser->cursor)) {
+        report_trigger_error(parser, "unknown unit");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int parse_trigger_or(struct trigger_parser *parser);
+
+/* comparison := '(' expression ')' | metric operator value */
+static int parse_trigger_comparison(struct trigger_parser *parser) {
+    enum trigger_compare compare;
+    double operand;
+    int metric;
+
+    skip_trigger_spaces(parser);
+
+    if (*parser->cursor == '(') {
+        ++parser->cursor;
+
+        if (parse_trigger_or(parser) < 0) {
+            return -1;
+        }
+
+        skip_trigger_spaces(parser);
+        if (*parser->cursor != ')') {
+            report_trigger_error(parser, "expected \")\"");
+            return -1;
+        }
+        ++parser->cursor;
+
+        return 0;
+    }
+
+    metric = parse_trigger_metric(parser);
+    if (metric < 0) {
+        return -1;
+    }
+
+    skip_trigger_spaces(parser);
+    if (parse_trigger_compare(parser, &compare) < 0) {
+        return -1;
+    }
+
+    skip_trigger_spaces(parser);
+    if (parse_trigger_value(parser, trigger_metric_infos[metric].kind, &operand) < 0) {
+        return -1;
+    }
+
+    return emit_trigger_instruction(parser, TRIGGER_OP_COMPARE, metric, compare, operand);
+}
+
+/* and-expression := comparison (('and' | '&&') comparison)* */
+static int parse_trigger_and(struct trigger_parser *parser) {
+    if (parse_trigger_comparison(parser) < 0) {
+        return -1;
+    }
+
+    while (match_trigger_keyword(parser, "and", "&&")) {
+        if (parse_trigger_comparison(parser) < 0 || emit_trigger_instruction(parser, TRIGGER_OP_AND, 0, 0, 0) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* expression := and-expression (('or' | '||') and-expression)* */
+static int parse_trigger_or(struct trigger_parser *parser) {
+    if (parse_trigger_and(parser) < 0) {
+        return -1;
+    }
+
+    while (match_trigger_keyword(parser, "or", "||")) {
+        if (parse_trigger_and(parser) < 0 || emit_trigger_instruction(parser, TRIGGER_OP_OR, 0, 0, 0) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* sections := name (',' name)* */
+static int parse_trigger_sections(struct trigger_parser *parser) {
+    size_t length;
+    size_t i;
+
+    do {
+        skip_trigger_spaces(parser);
+
+        for (length = 0; is_trigger_name_char(parser->cursor[length]); ++length) {
+        }
+
+        for (i = 0; i < TRIGGER_SECTION_INFO_COUNT; ++i) {
+            if (strlen(trigger_section_infos[i].name) == length && strncmp(parser->cursor, trigger_section_infos[i].name, length) == 0) {
+                break;
+            }
+        }
+
+        if (i == TRIGGER_SECTION_INFO_COUNT) {
+            report_trigger_error(parser, "unknown section");
+            return -1;
+        }
+
+        parser->rule->sections |= trigger_section_infos[i].section;
+        parser->cursor += length;
+        skip_trigger_spaces(parser);
+    } while (*parser->cursor++ == ',');
+
+    --parser->cursor;
+
+    return 0;
+}
+
+int add_trigger_rule(char *text) {
+    struct trigger_parser parser;
+    struct trigger_rule *rule;
+    int i;
+
+    if (trigger_rule_count >= TRIGGER_MAX_RULES) {
+        fprintf(stderr, "ERROR: at most %d trigger rules can be specified\n", TRIGGER_MAX_RULES);
+        return -1;
+    }
+
+    rule = &trigger_rules[trigger_rule_count];
+    rule->length = 0;
+    rule->sections = 0;
+
+    parser.text = text;
+    parser.cursor = text;
+    parser.rule = rule;
+
+    if (parse_trigger_or(&parser) < 0) {
+        return -1;
+    }
+
+    /* the rule renders all configured sections without a section list */
+    skip_trigger_spaces(&parser);
+    if (*parser.cursor == ':') {
+        ++parser.cursor;
+        if (parse_trigger_sections(&parser) < 0) {
+            return -1;
+        }
+    } else {
+        rule->sections = TRIGGER_SECTION_ALL;
+    }
+
+    skip_trigger_spaces(&parser);
+    if (*parser.cursor != '\0') {
+        report_trigger_error(&parser, "unexpected text");
+        return -1;
+    }
+
+    rule->text = text;
+
+    for (i = 0; i < rule->length; ++i) {
+        if (rule->code[i].opcode == TRIGGER_OP_COMPARE) {
+            trigger_sources |= trigger_metric_infos[rule->code[i].metric].sources;
+        }
+    }
+
+    ++trigger_rule_count;
+
+    return 0;
+}
+
+int get_trigger_rule_count() {
+    return trigger_rule_count;
+}
+
+char *get_trigger_rule_text(int index) {
+    if (index < 0 || index >= trigger_rule_count) {
+        return NULL;
+    }
+
+    return trigger_rules[index].text;
+}
+
+unsigned int get_trigger_sources() {
+    return trigger_sources;
+}
+
+/* only the files of the referenced metrics are read, the values are also kept in the memory data of the report */
+int load_trigger_metrics(pid_t pid, struct meminfo *memory_data, long int statm_rss, double capture_time, struct trigger_metrics *metrics) {
+    double *values = metrics->values;
+    long int process_rss;
+    long int socket_count;
+    int i;
+
+    for (i = 0; i < TRIGGER_METRIC_COUNT; ++i) {
+        values[i] = NAN;
+    }
+
+    if (trigger_sources & TRIGGER_SOURCE_STATM) {
+        if (statm_rss < 0) {
+            get_statm_rss(pid, &statm_rss);
+        }
+
+        if (statm_rss >= 0) {
+            values[TRIGGER_METRIC_RSS] = statm_rss;
+
+            if (memory_data->total_memory > 0) {
+                values[TRIGGER_METRIC_RSS_PCT] = (double)statm_rss / memory_data->total_memory * 100;
+            }
+        }
+    }
+
+    if ((trigger_sources & TRIGGER_SOURCE_SMAPS_ROLLUP) && get_memory_usage(pid, &process_rss, &memory_data->process_pss, &memory_data->process_uss) == 0) {
+        values[TRIGGER_METRIC_PSS] = memory_data->process_pss;
+        values[TRIGGER_METRIC_USS] = memory_data->process_uss;
+    }
+
+    if ((trigger_sources & TRIGGER_SOURCE_STATUS) && get_page_tables_usage(pid, &memory_data->process_page_tables_size) == 0) {
+        values[TRIGGER_METRIC_PAGE_TABLES] = memory_data->process_page_tables_size;
+    }
+
+    if ((trigger_sources & TRIGGER_SOURCE_OOM_SCORE) && get_oom_score(pid, &memory_data->process_oom_score, &memory_data->process_oom_score_adj) == 0) {
+        values[TRIGGER_METRIC_OOM_SCORE] = memory_data->process_oom_score;
+        values[TRIGGER_METRIC_OOM_SCORE_ADJ] = memory_data->process_oom_score_adj;
+    }
+
+    if ((trigger_sources & TRIGGER_SOURCE_FD) && get_socket_count(pid, &socket_count) == 0) {
+        values[TRIGGER_METRIC_SOCKETS] = socket_count;
+    }
+
+    /* the rates start with the second evaluation of the same process */
+    if (pid != trigger_previous_pid) {
+        trigger_previous_time = 0;
+    }
+
+    for (i = 0; i < TRIGGER_METRIC_COUNT; ++i) {
+        if (trigger_metric_infos[i].base >= 0 && trigger_previous_time > 0 && capture_time > trigger_previous_time) {
+            values[i] = (values[trigger_metric_infos[i].base] - trigger_previous_values[trigger_metric_infos[i].base]) / (capture_time - trigger_previous_time);
+        }
+    }
+
+    memcpy(trigger_previous_values, values, sizeof(trigger_previous_values));
+    trigger_previous_time = capture_time;
+    trigger_previous_pid = pid;
+
+    return 0;
+}
+
+/* a comparison with a missing value is false, including != */
+static int compare_trigger_metric(struct trigger_instruction *instruction, double value) {
+    if (isnan(value)) {
+        return 0;
+    }
+
+    switch (instruction->compare) {
+        case TRIGGER_COMPARE_GT:
+            return value > instruction->operand;
+        case TRIGGER_COMPARE_GE:
+            return value >= instruction->operand;
+        case TRIGGER_COMPARE_LT:
+            return value < instruction->operand;
+        case TRIGGER_COMPARE_LE:
+            return value <= instruction->operand;
+        case TRIGGER_COMPARE_EQ:
+            return value == instruction->operand;
+        default:
+            return value != instruction->operand;
+    }
+}
+
+/* the postfix code of a compiled rule runs on a fixed stack without branches into the parser */
+static int run_trigger_rule(struct trigger_rule *rule, struct trigger_metrics *metrics) {
+    unsigned char stack[TRIGGER_MAX_CODE];
+    struct trigger_instruction *instruction;
+    int depth = 0;
+    int i;
+
+    for (i = 0; i < rule->length; ++i) {
+        instruction = &rule->code[i];
+
+        switch (instruction->opcode) {
+            case TRIGGER_OP_COMPARE:
+                stack[depth++] = compare_trigger_metric(instruction, metrics->values[instruction->metric]);
+                break;
+            case TRIGGER_OP_AND:
+                --depth;
+                stack[depth - 1] = stack[depth - 1] && stack[depth];
+                break;
+            case TRIGGER_OP_OR:
+                --depth;
+                stack[depth - 1] = stack[depth - 1] || stack[depth];
+                break;
+        }
+    }
+
+    return depth == 1 && stack[0];
+}
+
+/* returns the index of the first rule which is met, -1 if none, the sections of all met rules are merged */
+int evaluate_trigger_rules(struct trigger_metrics *metrics, unsigned int *sections) {
+    int fired = -1;
+    int i;
+
+    *sections = 0;
+
+    for (i = 0; i < trigger_rule_count; ++i) {
+        if (run_trigger_rule(&trigger_rules[i], metrics)) {
+            if (fired < 0) {
+                fired = i;
+            }
+
+            *sections |= trigger_rules[i].sections;
+        }
+    }
+
+    return fired;
+}
+
+void free_trigger_rules() {
+    trigger_rule_count = 0;
+    trigger_sources = 0;
+    trigger_previous_time = 0;
+    trigger_previous_pid = 0;
+}
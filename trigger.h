@@ -0,0 +1,95 @@
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <sys/types.h>
+#include "process.h"
+
+#define TRIGGER_MAX_RULES 16
+#define TRIGGER_MAX_CODE 64 /* instructions of one compiled rule */
+
+/* values a rule can compare, the rates are derived from the previous evaluation */
+enum trigger_metric {
+    TRIGGER_METRIC_RSS, /* unit: kB */
+    TRIGGER_METRIC_RSS_PCT, /* RSS / system memory * 100, the ratio of -m */
+    TRIGGER_METRIC_PSS, /* unit: kB */
+    TRIGGER_METRIC_USS, /* unit: kB */
+    TRIGGER_METRIC_PAGE_TABLES, /* unit: kB */
+    TRIGGER_METRIC_OOM_SCORE,
+    TRIGGER_METRIC_OOM_SCORE_ADJ,
+    TRIGGER_METRIC_SOCKETS,
+    TRIGGER_METRIC_RSS_RATE, /* unit: kB per second */
+    TRIGGER_METRIC_PSS_RATE,
+    TRIGGER_METRIC_USS_RATE,
+    TRIGGER_METRIC_PAGE_TABLES_RATE,
+    TRIGGER_METRIC_COUNT
+};
+
+/* files read in each cycle for the metrics the rules refer to */
+enum trigger_source {
+    TRIGGER_SOURCE_STATM = 1 << 0,
+    TRIGGER_SOURCE_SMAPS_ROLLUP = 1 << 1,
+    TRIGGER_SOURCE_STATUS = 1 << 2,
+    TRIGGER_SOURCE_OOM_SCORE = 1 << 3,
+    TRIGGER_SOURCE_FD = 1 << 4
+};
+
+/* heavy sections a rule can select, the sections still need their own options, e.g. --threads */
+enum trigger_section {
+    TRIGGER_SECTION_TREE = 1 << 0,
+    TRIGGER_SECTION_THREADS = 1 << 1,
+    TRIGGER_SECTION_MAPPINGS = 1 << 2,
+    TRIGGER_SECTION_GROWING = 1 << 3,
+    TRIGGER_SECTION_PAGEMAP = 1 << 4,
+    TRIGGER_SECTION_NETWORK = 1 << 5,
+    TRIGGER_SECTION_NUMA = 1 << 6,
+    TRIGGER_SECTION_CGROUP = 1 << 7,
+    TRIGGER_SECTION_VMSTAT = 1 << 8,
+    TRIGGER_SECTION_CONSUMERS = 1 << 9
+};
+
+#define TRIGGER_SECTION_ALL ((1U << 10) - 1)
+
+enum trigger_opcode {
+    TRIGGER_OP_COMPARE, /* push metric <compare> operand */
+    TRIGGER_OP_AND, /* pop two, push both */
+    TRIGGER_OP_OR /* pop two, push either */
+};
+
+enum trigger_compare {
+    TRIGGER_COMPARE_GT,
+    TRIGGER_COMPARE_GE,
+    TRIGGER_COMPARE_LT,
+    TRIGGER_COMPARE_LE,
+    TRIGGER_COMPARE_EQ,
+    TRIGGER_COMPARE_NE
+};
+
+/* one instruction of the postfix code, the operand is converted to the unit of the metric at compile time */
+struct trigger_instruction {
+    unsigned char opcode;
+    unsigned char metric;
+    unsigned char compare;
+    double operand;
+};
+
+struct trigger_rule {
+    char *text;
+    struct trigger_instruction code[TRIGGER_MAX_CODE];
+    int length;
+    unsigned int sections;
+};
+
+/* metric values of one cycle, NAN if a value is not available so that every comparison with it is false */
+struct trigger_metrics {
+    double values[TRIGGER_METRIC_COUNT];
+};
+
+extern int add_trigger_rule(char *text);
+extern int get_trigger_rule_count();
+extern char *get_trigger_rule_text(int index);
+extern unsigned int get_trigger_sources();
+extern int load_trigger_metrics(pid_t pid, struct meminfo *memory_data, long int statm_rss, double capture_time, struct trigger_metrics *metrics);
+extern int evaluate_trigger_rules(struct trigger_metrics *metrics, unsigned int *sections);
+extern void free_trigger_rules();
+
+#endif /* TRIGGER_H */
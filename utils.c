@@ -2,15 +2,28 @@
 #include <time.h>
 #include "utils.h"
 
-void print_current_time() {
-    time_t current_time;
-
-    /* acquire current time */
-    current_time = time(NULL);
+FILE *report_output = NULL;
 
+void print_report_time(time_t report_time) {
     /* convert time_t type time data to string */
-    fprintf(stdout, "Report Time: %s", ctime(&current_time));
-    fflush(stdout);
+    fprintf(report_output, "Report Time: %s", ctime(&report_time));
+    fflush(report_output);
 
     return;
 }
+
+long get_elapsed_microseconds(struct timespec *start_time) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start_time->tv_sec) * 1000000L + (now.tv_nsec - start_time->tv_nsec) / 1000L;
+}
+
+double get_monotonic_time() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
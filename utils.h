@@ -1,6 +1,24 @@
 #ifndef UTILS_H
 #define UTILS_H
 
-extern void print_current_time();
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/* stream of the report being rendered, each report is written into its own buffer */
+extern FILE *report_output;
+
+/* record layout of getdents64(), glibc only declares it for _GNU_SOURCE */
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+extern void print_report_time(time_t report_time);
+extern long get_elapsed_microseconds(struct timespec *start_time);
+extern double get_monotonic_time();
 
 #endif /* UTILS_H */
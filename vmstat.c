@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "procfs.h"
+#include "utils.h"
+#include "vmstat.h"
+
+/* name of a /proc/vmstat line and the counter it is added to */
+struct vmstat_key {
+    char *name;
+    size_t length;
+    enum vmstat_counter counter;
+};
+
+#define VMSTAT_KEY(name, counter) {name, sizeof(name) - 1, counter}
+
+static struct vmstat_key vmstat_keys[] = {
+    VMSTAT_KEY("pgscan_kswapd", VMSTAT_PGSCAN_KSWAPD),
+    VMSTAT_KEY("pgscan_direct", VMSTAT_PGSCAN_DIRECT),
+    VMSTAT_KEY("pgsteal_kswapd", VMSTAT_PGSTEAL_KSWAPD),
+    VMSTAT_KEY("pgsteal_direct", VMSTAT_PGSTEAL_DIRECT),
+    VMSTAT_KEY("allocstall", VMSTAT_ALLOCSTALL), /* before Linux 4.10 */
+    VMSTAT_KEY("allocstall_dma", VMSTAT_ALLOCSTALL),
+    VMSTAT_KEY("allocstall_dma32", VMSTAT_ALLOCSTALL),
+    VMSTAT_KEY("allocstall_normal", VMSTAT_ALLOCSTALL),
+    VMSTAT_KEY("allocstall_movable", VMSTAT_ALLOCSTALL),
+    VMSTAT_KEY("allocstall_device", VMSTAT_ALLOCSTALL),
+    VMSTAT_KEY("compact_stall", VMSTAT_COMPACT_STALL),
+    VMSTAT_KEY("pswpin", VMSTAT_PSWPIN),
+    VMSTAT_KEY("pswpout", VMSTAT_PSWPOUT),
+    VMSTAT_KEY("workingset_refault", VMSTAT_WORKINGSET_REFAULT), /* before Linux 5.9 */
+    VMSTAT_KEY("workingset_refault_anon", VMSTAT_WORKINGSET_REFAULT),
+    VMSTAT_KEY("workingset_refault_file", VMSTAT_WORKINGSET_REFAULT),
+    VMSTAT_KEY("oom_kill", VMSTAT_OOM_KILL)
+};
+
+#define VMSTAT_KEY_COUNT (sizeof(vmstat_keys) / sizeof(vmstat_keys[0]))
+
+/*
+ * the lines of /proc/vmstat are in the same order on a running kernel, so the key of each line is looked up
+ * once and the next cycles only verify it. index into vmstat_keys[] of each line, -1 if it is not reported
+ */
+static int vmstat_line_keys[VMSTAT_MAX_LINES];
+static size_t vmstat_line_count = 0;
+static int vmstat_line_keys_loaded = 0;
+
+/* totals of the previous cycle, used by the capture thread only */
+static unsigned long vmstat_previous[VMSTAT_COUNTER_COUNT];
+static double vmstat_previous_time = 0;
+
+static int find_vmstat_key(const char *line, size_t name_length) {
+    size_t i;
+
+    for (i = 0; i < VMSTAT_KEY_COUNT; ++i) {
+        if (vmstat_keys[i].length == name_length && memcmp(line, vmstat_keys[i].name, name_length) == 0) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+/* one pass over the file, the counters are summed up in a fixed array, returns -1 if the line layout has changed */
+static int parse_vmstat(char *buffer, unsigned long *values, int *available) {
+    struct vmstat_key *key;
+    char *line = buffer;
+    char *line_end;
+    char *name_end;
+    size_t line_index = 0;
+    int key_index;
+
+    for (; *line != '\0'; line = *line_end == '\n' ? line_end + 1 : line_end, ++line_index) {
+        line_end = strchr(line, '\n');
+        if (line_end == NULL) {
+            line_end = line + strlen(line);
+        }
+
+        if (line_index >= VMSTAT_MAX_LINES) {
+            break;
+        }
+
+        if (vmstat_line_keys_loaded) {
+            /* the lines which are not reported are skipped without looking at them */
+            key_index = vmstat_line_keys[line_index];
+            if (key_index < 0) {
+                continue;
+            }
+
+            key = &vmstat_keys[key_index];
+            if (line_end - line <= (long)key->length || memcmp(line, key->name, key->length) != 0 || line[key->length] != ' ') {
+                return -1;
+            }
+        } else {
+            name_end = memchr(line, ' ', line_end - line);
+            if (name_end == NULL) {
+                vmstat_line_keys[line_index] = -1;
+                continue;
+            }
+
+            key_index = find_vmstat_key(line, name_end - line);
+            vmstat_line_keys[line_index] = key_index;
+            if (key_index < 0) {
+                continue;
+            }
+
+            key = &vmstat_keys[key_index];
+        }
+
+        values[key->counter] += strtoul(line + key->length + 1, NULL, 10);
+        available[key->counter] = 1;
+    }
+
+    if (vmstat_line_keys_loaded && line_index != vmstat_line_count) {
+        return -1;
+    }
+
+    vmstat_line_count = line_index;
+    vmstat_line_keys_loaded = 1;
+
+    return 0;
+}
+
+int get_vmstat_activity(struct vmstat_activity *activity) {
+    char *vmstat_buffer;
+    unsigned long values[VMSTAT_COUNTER_COUNT];
+    double current_time;
+    int i;
+
+    activity->loaded = 0;
+
+    vmstat_buffer = read_procfs_file(VMSTAT_PATH, NULL);
+    if (vmstat_buffer == NULL) {
+        return -1;
+    }
+
+    current_time = get_monotonic_time();
+
+    memset(values, 0, sizeof(values));
+    memset(activity->available, 0, sizeof(activity->available));
+
+    /* the layout only changes if the key map is wrong, e.g. the file is truncated, then the lines are looked up again */
+    if (parse_vmstat(vmstat_buffer, values, activity->available) < 0) {
+        vmstat_line_keys_loaded = 0;
+
+        memset(values, 0, sizeof(values));
+        memset(activity->available, 0, sizeof(activity->available));
+        parse_vmstat(vmstat_buffer, values, activity->available);
+    }
+
+    if (vmstat_previous_time > 0 && current_time > vmstat_previous_time) {
+        for (i = 0; i < VMSTAT_COUNTER_COUNT; ++i) {
+            activity->delta[i] = values[i] >= vmstat_previous[i] ? values[i] - vmstat_previous[i] : 0;
+        }
+
+        activity->interval = current_time - vmstat_previous_time;
+        activity->loaded = 1;
+    }
+
+    memcpy(vmstat_previous, values, sizeof(values));
+    vmstat_previous_time = current_time;
+
+    return 0;
+}
+
+static void print_vmstat_rate(char *label, struct vmstat_activity *activity, enum vmstat_counter counter) {
+    if (!activity->available[counter]) {
+        fprintf(report_output, "%s n/a", label);
+        return;
+    }
+
+    fprintf(report_output, "%s %.1f/s", label, (double)activity->delta[counter] / activity->interval);
+}
+
+void get_vmstat_activity_report(struct vmstat_activity *activity) {
+    if (!activity->loaded) {
+        fprintf(report_output, "System memory activity is not available until the next cycle\n");
+        fflush(report_output);
+        return;
+    }
+
+    fprintf(report_output, "Interval: %.2f s\n", activity->interval);
+
+    print_vmstat_rate("Page Scan: kswapd", activity, VMSTAT_PGSCAN_KSWAPD);
+    print_vmstat_rate(" - direct", activity, VMSTAT_PGSCAN_DIRECT);
+    fprintf(report_output, "\n");
+
+    print_vmstat_rate("Page Steal: kswapd", activity, VMSTAT_PGSTEAL_KSWAPD);
+    print_vmstat_rate(" - direct", activity, VMSTAT_PGSTEAL_DIRECT);
+    fprintf(report_output, "\n");
+
+    print_vmstat_rate("Stall: allocation", activity, VMSTAT_ALLOCSTALL);
+    print_vmstat_rate(" - compaction", activity, VMSTAT_COMPACT_STALL);
+    fprintf(report_output, "\n");
+
+    print_vmstat_rate("Swap: in", activity, VMSTAT_PSWPIN);
+    print_vmstat_rate(" - out", activity, VMSTAT_PSWPOUT);
+    fprintf(report_output, "\n");
+
+    print_vmstat_rate("Workingset Refault:", activity, VMSTAT_WORKINGSET_REFAULT);
+    fprintf(report_output, "\n");
+
+    if (activity->available[VMSTAT_OOM_KILL]) {
+        fprintf(report_output, "OOM Kill: +%lu\n", activity->delta[VMSTAT_OOM_KILL]);
+    } else {
+        fprintf(report_output, "OOM Kill: n/a\n");
+    }
+
+    fflush(report_output);
+}
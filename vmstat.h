@@ -0,0 +1,33 @@
+#ifndef VMSTAT_H
+#define VMSTAT_H
+
+#define VMSTAT_PATH "/proc/vmstat"
+#define VMSTAT_MAX_LINES 512 /* lines of /proc/vmstat mapped to the counters, recent kernels have less than 200 */
+
+/* reclaim and allocation stall counters, the allocstall and workingset_refault variants of each kernel are summed up */
+enum vmstat_counter {
+    VMSTAT_PGSCAN_KSWAPD,
+    VMSTAT_PGSCAN_DIRECT,
+    VMSTAT_PGSTEAL_KSWAPD,
+    VMSTAT_PGSTEAL_DIRECT,
+    VMSTAT_ALLOCSTALL,
+    VMSTAT_COMPACT_STALL,
+    VMSTAT_PSWPIN,
+    VMSTAT_PSWPOUT,
+    VMSTAT_WORKINGSET_REFAULT,
+    VMSTAT_OOM_KILL,
+    VMSTAT_COUNTER_COUNT
+};
+
+/* system-wide activity since the previous cycle, captured in each cycle */
+struct vmstat_activity {
+    int loaded; /* 1 if the deltas are calculated, the first cycle only has a baseline */
+    double interval; /* unit: second */
+    int available[VMSTAT_COUNTER_COUNT]; /* 0 if the kernel does not have the counter */
+    unsigned long delta[VMSTAT_COUNTER_COUNT];
+};
+
+extern int get_vmstat_activity(struct vmstat_activity *activity);
+extern void get_vmstat_activity_report(struct vmstat_activity *activity);
+
+#endif /* VMSTAT_H */
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "writer.h"
+
+#define WRITER_DETAIL_DROPPED_NOTE "Detail sections are dropped since the output is falling behind\n\n\n"
+
+/*
+ * bounded lock-free queue between the render thread(producer) and the writer thread(consumer)
+ * the producer is the only one to move queue_tail. the head is claimed with a compare-and-swap, by the consumer
+ * to write an entry and by the producer to drop the oldest entry, so the owner of an entry is always unique.
+ * a slot is only reused once the head has passed it, the indices never wrap in practice.
+ */
+static struct writer_entry writer_queue[WRITER_QUEUE_SIZE];
+static uint64_t queue_head = 0;
+static uint64_t queue_tail = 0;
+
+/* counted by the producer, reported and reset by the consumer once the queue is drained */
+static unsigned long dropped_reports = 0;
+static unsigned long trimmed_reports = 0;
+
+static enum writer_policy output_policy = WRITER_BLOCK;
+static sem_t writer_sem; /* posted for each queued report and on stop, the writer sleeps on it */
+static pthread_t writer_thread;
+static int writer_thread_started = 0;
+static int writer_thread_stopping = 0;
+
+int parse_writer_policy(char *name, enum writer_policy *policy) {
+    if (strcmp(name, "block") == 0) {
+        *policy = WRITER_BLOCK;
+    } else if (strcmp(name, "drop-oldest") == 0) {
+        *policy = WRITER_DROP_OLDEST;
+    } else if (strcmp(name, "drop-detail") == 0) {
+        *policy = WRITER_DROP_DETAIL;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void write_output(char *buffer, size_t length) {
+    if (length > 0 && fwrite(buffer, 1, length, stdout) != length) {
+        fprintf(stderr, "WARNING: failed to write report output: %s\n", strerror(errno));
+    }
+
+    fflush(stdout);
+}
+
+/* claim the oldest queued entry, returns 0 if the queue is empty */
+static int claim_queue_entry(struct writer_entry *entry) {
+    uint64_t head = __atomic_load_n(&queue_head, __ATOMIC_ACQUIRE);
+
+    while (head != __atomic_load_n(&queue_tail, __ATOMIC_ACQUIRE)) {
+        /* the slot cannot be refilled while the head still points at it, a torn read is discarded by the failed compare-and-swap */
+        entry->buffer = __atomic_load_n(&writer_queue[head % WRITER_QUEUE_SIZE].buffer, __ATOMIC_RELAXED);
+        entry->length = __atomic_load_n(&writer_queue[head % WRITER_QUEUE_SIZE].length, __ATOMIC_RELAXED);
+
+        if (__atomic_compare_exchange_n(&queue_head, &head, head + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void report_dropped_output() {
+    unsigned long dropped = __atomic_exchange_n(&dropped_reports, 0, __ATOMIC_ACQ_REL);
+    unsigned long trimmed = __atomic_exchange_n(&trimmed_reports, 0, __ATOMIC_ACQ_REL);
+    char message[256];
+    int ret_snprintf;
+
+    if (dropped == 0 && trimmed == 0) {
+        return;
+    }
+
+    ret_snprintf = snprintf(message, sizeof(message), "Output Writer: %lu report(s) dropped and %lu report(s) without detail sections while the output was falling behind\n\n", dropped, trimmed);
+    if (ret_snprintf > 0) {
+        write_output(message, ret_snprintf);
+    }
+}
+
+static void *write_reports(void *arg) {
+    struct writer_entry entry;
+    int stopping;
+
+    /* suppress "unused parameter" warning  */
+    (void)arg;
+
+    while (1) {
+        while (sem_wait(&writer_sem) < 0 && errno == EINTR) {
+            continue;
+        }
+
+        stopping = __atomic_load_n(&writer_thread_stopping, __ATOMIC_ACQUIRE);
+
+        while (claim_queue_entry(&entry)) {
+            write_output(entry.buffer, entry.length);
+            free(entry.buffer);
+        }
+
+        /* the output has caught up with rendering */
+        report_dropped_output();
+
+        if (stopping) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+void start_output_writer(enum writer_policy policy) {
+    sigset_t block_set;
+    sigset_t old_set;
+    int ret_pthread_create;
+
+    output_policy = policy;
+
+    if (sem_init(&writer_sem, 0, 0) < 0) {
+        fprintf(stderr, "WARNING: failed to start the output writer, reports are written by the render thread: %s\n", strerror(errno));
+        return;
+    }
+
+    /* SIGINT is left to the capture thread */
+    sigemptyset(&block_set);
+    sigaddset(&block_set, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &block_set, &old_set);
+
+    ret_pthread_create = pthread_create(&writer_thread, NULL, write_reports, NULL);
+
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+
+    if (ret_pthread_create != 0) {
+        fprintf(stderr, "WARNING: failed to start the output writer, reports are written by the render thread: %s\n", strerror(ret_pthread_create));
+        sem_destroy(&writer_sem);
+        return;
+    }
+
+    writer_thread_started = 1;
+}
+
+/* drop the oldest queued report, returns 0 if the writer took it first */
+static int drop_oldest_entry() {
+    struct writer_entry entry;
+
+    if (!claim_queue_entry(&entry)) {
+        return 0;
+    }
+
+    free(entry.buffer);
+    __atomic_add_fetch(&dropped_reports, 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+void write_report_output(char *buffer, size_t length, size_t summary_length) {
+    struct timespec block_wait = {0, WRITER_BLOCK_WAIT_NS};
+    uint64_t tail;
+    uint64_t queued;
+
+    if (!writer_thread_started) {
+        write_output(buffer, length);
+        free(buffer);
+        return;
+    }
+
+    tail = __atomic_load_n(&queue_tail, __ATOMIC_RELAXED);
+    queued = tail - __atomic_load_n(&queue_head, __ATOMIC_ACQUIRE);
+
+    /* keep the summary of the report and replace the rest with a note, the buffer is large enough for it */
+    if (output_policy == WRITER_DROP_DETAIL && queued >= WRITER_DETAIL_WATERMARK && summary_length + sizeof(WRITER_DETAIL_DROPPED_NOTE) <= length + 1) {
+        memcpy(buffer + summary_length, WRITER_DETAIL_DROPPED_NOTE, sizeof(WRITER_DETAIL_DROPPED_NOTE));
+        length = summary_length + sizeof(WRITER_DETAIL_DROPPED_NOTE) - 1;
+        __atomic_add_fetch(&trimmed_reports, 1, __ATOMIC_RELEASE);
+    }
+
+    while (tail - __atomic_load_n(&queue_head, __ATOMIC_ACQUIRE) == WRITER_QUEUE_SIZE) {
+        if (output_policy == WRITER_BLOCK) {
+            nanosleep(&block_wait, NULL);
+        } else {
+            drop_oldest_entry();
+        }
+    }
+
+    __atomic_store_n(&writer_queue[tail % WRITER_QUEUE_SIZE].buffer, buffer, __ATOMIC_RELAXED);
+    __atomic_store_n(&writer_queue[tail % WRITER_QUEUE_SIZE].length, length, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&queue_tail, tail + 1, __ATOMIC_RELEASE);
+
+    sem_post(&writer_sem);
+}
+
+void stop_output_writer() {
+    if (!writer_thread_started) {
+        return;
+    }
+
+    /* the writer drains the queue before it exits */
+    __atomic_store_n(&writer_thread_stopping, 1, __ATOMIC_RELEASE);
+    sem_post(&writer_sem);
+
+    pthread_join(writer_thread, NULL);
+    sem_destroy(&writer_sem);
+
+    writer_thread_started = 0;
+}
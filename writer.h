@@ -0,0 +1,27 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stddef.h>
+
+#define WRITER_QUEUE_SIZE 16 /* rendered reports waiting for the output, must be a power of 2 */
+#define WRITER_DETAIL_WATERMARK (WRITER_QUEUE_SIZE / 2) /* drop-detail policy: queued reports before only summaries are queued */
+#define WRITER_BLOCK_WAIT_NS 1000000 /* block policy: wait between checks of a full queue */
+
+enum writer_policy {
+    WRITER_BLOCK, /* rendering waits until the output takes the next report, nothing is lost */
+    WRITER_DROP_OLDEST, /* the oldest queued report is dropped to make room */
+    WRITER_DROP_DETAIL /* only the basic and memory sections are queued once the queue fills up, then the oldest report is dropped */
+};
+
+/* one rendered report, the buffer is allocated by open_memstream() and freed by the writer */
+struct writer_entry {
+    char *buffer;
+    size_t length;
+};
+
+extern int parse_writer_policy(char *name, enum writer_policy *policy);
+extern void start_output_writer(enum writer_policy policy);
+extern void write_report_output(char *buffer, size_t length, size_t summary_length);
+extern void stop_output_writer();
+
+#endif /* WRITER_H */